@@ -1,8 +1,188 @@
+#pragma once
+
+#include <cstring>
+
+// PE datapath: 一個 32-bit word 裡 packed lane 的格式 (per layer)
+// DP_U8 是原本的 4 x uint8，bf16 的 psum 以 fp32 bit pattern 存在 int32 裡
+enum DatapathMode
+{
+    DP_U8 = 0,
+    DP_INT4,
+    DP_INT8,
+    DP_INT16,
+    DP_BF16,
+    DP_COUNT
+};
+
+constexpr int dp_lane_bits(int dp)
+{
+    return dp == DP_INT4 ? 4 : (dp == DP_INT16 || dp == DP_BF16) ? 16 : 8;
+}
+
+constexpr int dp_lanes(int dp)
+{
+    return 32 / dp_lane_bits(dp);
+}
+
+constexpr bool dp_is_signed(int dp)
+{
+    return dp == DP_INT4 || dp == DP_INT8 || dp == DP_INT16;
+}
+
+constexpr bool dp_is_float(int dp)
+{
+    return dp == DP_BF16;
+}
+
+inline const char* dp_name(int dp)
+{
+    switch (dp)
+    {
+        case DP_U8:    return "u8";
+        case DP_INT4:  return "int4";
+        case DP_INT8:  return "int8";
+        case DP_INT16: return "int16";
+        case DP_BF16:  return "bf16";
+        default:       return "unknown";
+    }
+}
+
+// 名稱轉 mode，找不到回傳 -1
+inline int dp_from_name(const char* name)
+{
+    for (int dp = 0; dp < DP_COUNT; dp++)
+    {
+        if (strcmp(dp_name(dp), name) == 0)
+            return dp;
+    }
+    return -1;
+}
+
+// 每個 MAC 的能量 (相對 8-bit)，整數乘法器約與位元數平方成正比，bf16 是 8-bit mantissa 乘法加 fp32 累加
+constexpr double dp_mac_energy_scale(int dp)
+{
+    return dp == DP_INT4 ? 0.25 : dp == DP_INT16 ? 4.0 : dp == DP_BF16 ? 2.0 : 1.0;
+}
+
+// PE 的 zero gating: ifmap lane 為 0 時不做 MAC
+// GATE_CLOCK 只關掉乘法器 (省能量, cycle 不變)，GATE_SKIP 直接跳過該 lane (也省 cycle)
+enum ZeroGating
+{
+    GATE_NONE = 0,
+    GATE_CLOCK,
+    GATE_SKIP,
+    GATE_COUNT
+};
+
+inline const char* gating_name(int g)
+{
+    switch (g)
+    {
+        case GATE_NONE:  return "none";
+        case GATE_CLOCK: return "clock";
+        case GATE_SKIP:  return "skip";
+        default:         return "unknown";
+    }
+}
+
+// 名稱轉 mode，找不到回傳 -1
+inline int gating_from_name(const char* name)
+{
+    for (int g = 0; g < GATE_COUNT; g++)
+    {
+        if (strcmp(gating_name(g), name) == 0)
+            return g;
+    }
+    return -1;
+}
+
+// PE array 裡同一組 row 的 psum 怎麼累加到最後一個 row
+// REDUCE_CHAIN: 一個 row 傳一個 row (rows - 1 個 stage)，REDUCE_TREE: 兩兩相加 (ceil(log2(rows)) 個 stage)
+enum PsumReduction
+{
+    REDUCE_CHAIN = 0,
+    REDUCE_TREE,
+    REDUCE_COUNT
+};
+
+inline const char* reduction_name(int r)
+{
+    switch (r)
+    {
+        case REDUCE_CHAIN: return "chain";
+        case REDUCE_TREE:  return "tree";
+        default:           return "unknown";
+    }
+}
+
+// 名稱轉 mode，找不到回傳 -1
+inline int reduction_from_name(const char* name)
+{
+    for (int r = 0; r < REDUCE_COUNT; r++)
+    {
+        if (strcmp(reduction_name(r), name) == 0)
+            return r;
+    }
+    return -1;
+}
+
+// GLB 的 word address 怎麼分到 bank
+// WORD: 連續 word 輪流放 (addr % banks)，BLOCK: 每 block 個 word 換一個 bank，XOR: row bit 和 bank bit 做 xor
+enum GLBInterleave
+{
+    GLB_INTERLEAVE_WORD = 0,
+    GLB_INTERLEAVE_BLOCK,
+    GLB_INTERLEAVE_XOR,
+    GLB_INTERLEAVE_COUNT
+};
+
+inline const char* glb_interleave_name(int i)
+{
+    switch (i)
+    {
+        case GLB_INTERLEAVE_WORD:  return "word";
+        case GLB_INTERLEAVE_BLOCK: return "block";
+        case GLB_INTERLEAVE_XOR:   return "xor";
+        default:                   return "unknown";
+    }
+}
+
+// 名稱轉 mode，找不到回傳 -1
+inline int glb_interleave_from_name(const char* name)
+{
+    for (int i = 0; i < GLB_INTERLEAVE_COUNT; i++)
+    {
+        if (strcmp(glb_interleave_name(i), name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// DRAM timing (單位: accelerator cycle)，tRCD / tCAS / tRP / refresh 約是 DDR4 換算到 200 MHz
+// data bus 和 bus_bw 一樣是 4 B/cycle
+// address 以 32-bit word 計，mapping 是 row : bank : channel : column (同一個 row 的 word 連續)
+struct DRAMTimingParam
+{
+    int channels = 1;
+    int banks = 8;          // 每個 channel
+    int row_words = 512;    // row buffer 大小 (2 KB)
+    int burst_words = 8;    // 一個 burst 搬幾個 word (32 B)
+    int tRCD = 3;           // activate -> column command
+    int tCAS = 3;           // column command -> data
+    int tRP = 3;            // precharge
+    int tBURST = 8;         // 一個 burst 佔 data bus 的 cycle (32 B / 4 B per cycle)
+    int tREFI = 1560;       // refresh 間隔
+    int tRFC = 70;          // refresh 時所有 bank 不能用
+    bool open_page = true;  // false: 每次 access 完 auto-precharge (closed page)
+};
+
 struct LinearShapeParam
 {
     int B;  // batch size
     int in_features;
     int out_features;
+    int datapath = DP_U8;  // DatapathMode of this layer
+    double ifmap_density = 1.0;  // 非零 activation 的比例 (ReLU 後約 0.3 ~ 0.6)
 };
 
 struct EyerissHardwareParam
@@ -15,13 +195,24 @@ struct EyerissHardwareParam
     int glb_size;
     int bus_bw;
     int noc_bw;
+    int zero_gating = GATE_NONE;  // ZeroGating
+    int psum_reduction = REDUCE_CHAIN;  // PsumReduction
+    bool double_buffer = false;  // ping-pong ifmap / weight spad (spad 面積兩倍)
+    int glb_banks = 1;
+    int glb_ports = 1;  // 每個 bank 的 port 數
+    int glb_interleave = GLB_INTERLEAVE_WORD;  // GLBInterleave
+    int glb_outstanding = 1;  // 每個 GLB port 最多幾個 request 在路上 (1 = 不 pipeline)
+    bool dram_model = false;  // true: DRAM latency 用 DRAMTimingParam 的 timing model，false: 每個 word 固定 cycle
+    bool dma = false;  // true: DRAM <-> GLB 由 DMA engine 搬，下一個 tile 在 compute 時 prefetch
+    bool pipeline = false;  // true: tile schedule 由 scoreboard 排，load / compute / store 照 dependency 重疊
+    DRAMTimingParam dram;
 };
 
 struct EyerissMappingParam
 {
     int tk; //1~6
     int tn; //1~8
-    int mode;
+    int mode; // 組數，每組 tk 個 row，tk * mode <= PE array 的 row 數 (多的 row 不用)
     //1: 6個PE累加，共一組
     //2: 3個PE累加，共兩組
     //3: 2個PE累加，共三組
@@ -46,17 +237,28 @@ struct AnalysisResult
     long long int glb_read;
     long long int glb_write;   
     long long int glb_access;
+    long long int glb_conflicts;     // simulator 量到的 bank conflict (stall 的 request 數)
+    long long int glb_stall_cycles;
 
     long long int dram_read;
     long long int dram_write;    
     long long int dram_access;
+    long long int dram_cycles;       // dram_model 時 DRAM 花的 cycle
+    double dram_bandwidth;           // 實際達到的 bytes / cycle
+    double dram_row_hit_rate;
+    long long int dma_hidden_cycles; // dma 時藏在 compute 後面的 DRAM latency
 
     long long int macs;
+    long long int macs_executed;  // zero gating 後真正做的 MAC
+    long long int macs_gated;     // ifmap 為 0 被 gate 掉的 MAC
+    long long int compute_cycles; // PE array 的 compute cycle (GATE_SKIP 時只算 executed)
+    long long int compute_cycles_saved;
     double latency;
     long long int cycles;
 
 
     double energy_total;
+    double energy_saved;  // zero gating 省下的 compute energy
     double power_total;
 
     double intensity;
@@ -2,8 +2,10 @@
 #include <vector>
 #include <string>
 #include <cmath>
+#include <algorithm>
 
 #include "data_type.h"
+#include "../src/MEM/dram.cpp"
 using namespace std;
 
 #define DATA_SIZE 4
@@ -20,6 +22,7 @@ using namespace std;
 // Energy
 #define ENERGY_UNIT 1e-6  // 1 pJ = 10^6 uJ
 #define ENERGY_PER_MAC 2 * ENERGY_UNIT
+#define ENERGY_PER_GATED_MAC 0.2 * ENERGY_UNIT  // zero 偵測 + ifmap spad 讀取
 #define ENERGY_PER_GLB_ACCESS 10 * ENERGY_UNIT
 #define ENERGY_PER_DRAM_ACCESS 200 * ENERGY_UNIT
 #define POWER_UNIT 1e-6  // 1 uW
@@ -49,28 +52,51 @@ class EyerissAnalyzer
             hardware_param = param;
         }
 
+        // spad 裡的 word 數，跟著 hardware_param 的 spad 大小 (預設 3 / 12 / 4)
+        int ifmap_words()
+        {
+            return hardware_param.ifmap_spad_size / DATA_SIZE;
+        }
+
+        int weight_words()
+        {
+            return hardware_param.filter_spad_size / DATA_SIZE;
+        }
+
+        int psum_words()
+        {
+            return hardware_param.psum_spad_size / PSUM_DATA_SIZE;
+        }
+
+        // datapath 換算後的 in_features (以 8-bit 為單位)，int16 / bf16 搬兩倍的量，int4 一半
+        // u8 時就是 in_features
+        long long int in_features_packed()
+        {
+            return (long long int)linear_shape.in_features * dp_lane_bits(linear_shape.datapath) / 8;
+        }
+
         int in_features_used()
         {
-            return mapping.tk * 3 * DATA_SIZE;
+            return mapping.tk * ifmap_words() * DATA_SIZE;
         }
 
         int weight_used()
         {
-            return mapping.tn * mapping.tk * 12 * DATA_SIZE;
+            return mapping.tn * mapping.tk * weight_words() * DATA_SIZE;
         }
 
         int psum_used()
         {
-            return mapping.tn * 4 * PSUM_DATA_SIZE;
+            return mapping.tn * psum_words() * PSUM_DATA_SIZE;
         }
 
         vector<pair<string, int>> glb_usage_per_pass()
         {
             vector<pair<string, int>> usage;
 
-            usage.push_back({"in_feature", mapping.M * mapping.K * 3 * DATA_SIZE});
-            usage.push_back({"weight", mapping.K * mapping.N * 12 * DATA_SIZE});
-            usage.push_back({"psum", linear_shape.B * mapping.N * 4 * PSUM_DATA_SIZE});
+            usage.push_back({"in_feature", mapping.M * mapping.K * ifmap_words() * DATA_SIZE});
+            usage.push_back({"weight", mapping.K * mapping.N * weight_words() * DATA_SIZE});
+            usage.push_back({"psum", linear_shape.B * mapping.N * psum_words() * PSUM_DATA_SIZE});
             usage.push_back({"total", usage[0].second + usage[1].second + usage[2].second});//3
             return usage;
         }
@@ -86,14 +112,14 @@ class EyerissAnalyzer
             //cout << "in_features" << linear_shape.in_features << endl;
             //cout << "mapping.K" << mapping.K << endl;
             long long int B_div_M = ceil(double(linear_shape.B) / double(mapping.M));
-            long long int in_f_div_K = ceil(double(linear_shape.in_features) / double(mapping.K * 3));
-            long long int out_f_div_N = ceil(double(linear_shape.out_features) / double(mapping.N * 4));
-            long long int num_weight_linear = in_f_div_K * ceil(double(linear_shape.out_features) / double(mapping.N * 4));
+            long long int in_f_div_K = ceil(double(in_features_packed()) / double(mapping.K * ifmap_words()));
+            long long int out_f_div_N = ceil(double(linear_shape.out_features) / double(mapping.N * psum_words()));
+            long long int num_weight_linear = in_f_div_K * ceil(double(linear_shape.out_features) / double(mapping.N * psum_words()));
 
-            res.push_back({"i_linear_read",  out_f_div_N * in_f_div_K * B_div_M * mapping.M * mapping.K * 3 * DATA_SIZE});
-            res.push_back({"weight_linear_read", out_f_div_N * in_f_div_K * mapping.K * mapping.N * 12 * DATA_SIZE});
+            res.push_back({"i_linear_read",  out_f_div_N * in_f_div_K * B_div_M * mapping.M * mapping.K * ifmap_words() * DATA_SIZE});
+            res.push_back({"weight_linear_read", out_f_div_N * in_f_div_K * mapping.K * mapping.N * weight_words() * DATA_SIZE});
             res.push_back({"o_linear_read", 0}); // No read for output
-            res.push_back({"o_linear_write", out_f_div_N * linear_shape.B * mapping.N * 4 * PSUM_DATA_SIZE});
+            res.push_back({"o_linear_write", out_f_div_N * linear_shape.B * mapping.N * psum_words() * PSUM_DATA_SIZE});
             res.push_back({"read", res[0].second + res[1].second + res[2].second});
             res.push_back({"write", res[3].second});
             res.push_back({"total", res[4].second + res[5].second});//6
@@ -106,27 +132,103 @@ class EyerissAnalyzer
 
             long long int M_div_mode = ceil(double(mapping.M) / double(mapping.mode));
             long long int B_div_M = ceil(double(linear_shape.B) / double(mapping.M));
-            long long int in_f_div_K = ceil(double(linear_shape.in_features) / double(mapping.K * 3));
-            long long int out_f_div_N = ceil(double(linear_shape.out_features) / double(mapping.N * 4));
+            long long int in_f_div_K = ceil(double(in_features_packed()) / double(mapping.K * ifmap_words()));
+            long long int out_f_div_N = ceil(double(linear_shape.out_features) / double(mapping.N * psum_words()));
             long long int K_div_tk = ceil(double(mapping.K) / double(mapping.tk));
             long long int N_div_tn = ceil(double(mapping.N) / double(mapping.tn));
 
-            long long int num_o_linear_read= ceil(double(linear_shape.in_features) / double(mapping.K * 3) - 1);
+            long long int num_o_linear_read= ceil(double(in_features_packed()) / double(mapping.K * ifmap_words()) - 1);
+
+            // 每個 PE 一次搬整個 spad (bytes)
+            int ifmap_bytes = hardware_param.ifmap_spad_size;
+            int weight_bytes = hardware_param.filter_spad_size;
+            int psum_bytes = hardware_param.psum_spad_size;
 
-            res.push_back({"i_linear_read", out_f_div_N * in_f_div_K * B_div_M * M_div_mode * K_div_tk * N_div_tn * mapping.mode * mapping.tk * 12});
-            res.push_back({"weight_linear_read", out_f_div_N * in_f_div_K * M_div_mode * K_div_tk * N_div_tn * mapping.tk * mapping.tn * 48});
-            res.push_back({"o_linear_read", num_o_linear_read * out_f_div_N * M_div_mode * N_div_tn * mapping.mode * mapping.tn * 16}); 
-            res.push_back({"o_linear_write", in_f_div_K * out_f_div_N * M_div_mode * N_div_tn * mapping.mode * mapping.tn * 16});
+            res.push_back({"i_linear_read", out_f_div_N * in_f_div_K * B_div_M * M_div_mode * K_div_tk * N_div_tn * mapping.mode * mapping.tk * ifmap_bytes});
+            res.push_back({"weight_linear_read", out_f_div_N * in_f_div_K * M_div_mode * K_div_tk * N_div_tn * mapping.tk * mapping.tn * weight_bytes});
+            res.push_back({"o_linear_read", num_o_linear_read * out_f_div_N * M_div_mode * N_div_tn * mapping.mode * mapping.tn * psum_bytes}); 
+            res.push_back({"o_linear_write", in_f_div_K * out_f_div_N * M_div_mode * N_div_tn * mapping.mode * mapping.tn * psum_bytes});
             res.push_back({"read", res[0].second + res[1].second+ res[2].second});
             res.push_back({"write", res[3].second});
             res.push_back({"total", res[4].second + res[5].second});//6
             return res;
         }
 
+        // DRAM 搬運的 cycle
+        // dram_model 時每種 tile 在一個新的 DRAM 上跑一次 (和 simulator 一樣的 row-major layout)，
+        // 乘上 tile 數，再加上 refresh 佔掉的比例 (tRFC / tREFI)
+        // row_hit_rate 不是 nullptr 時順便回傳 row hit rate
+        double dram_cycles_per_layer(double* row_hit_rate = nullptr)
+        {
+            if (!hardware_param.dram_model)
+            {
+                if (row_hit_rate)
+                    *row_hit_rate = 0.0;
+                return double(dram_access_per_layer()[6].second) * DRAM_ACCESS_TIME / hardware_param.bus_bw / (TIME_UNIT);
+            }
+            long long int B_div_M = ceil(double(linear_shape.B) / double(mapping.M));
+            long long int in_f_div_K = ceil(double(in_features_packed()) / double(mapping.K * ifmap_words()));
+            long long int out_f_div_N = ceil(double(linear_shape.out_features) / double(mapping.N * psum_words()));
+            long long int in_words = ceil(double(in_features_packed()) / double(DATA_SIZE));
+            int k_words = mapping.K * ifmap_words();
+            int n_words = mapping.N * psum_words();
+
+            DRAMTimingParam timing = hardware_param.dram;
+            timing.tREFI = 0;  // refresh 最後用比例算
+            DRAM ifmap_dram(timing), weight_dram(timing), psum_dram(timing);
+            double ifmap_cycles = ifmap_dram.access_block(0, 0, k_words, mapping.M, in_words);
+            double weight_cycles = weight_dram.access_block(0, 0, n_words, k_words, linear_shape.out_features);
+            double psum_cycles = psum_dram.access_block(0, 0, n_words, linear_shape.B, linear_shape.out_features, true);
+
+            double ifmap_tiles = double(out_f_div_N * in_f_div_K * B_div_M);
+            double weight_tiles = double(out_f_div_N * in_f_div_K);
+            double psum_tiles = double(out_f_div_N);
+            if (row_hit_rate)
+            {
+                double bursts = ifmap_tiles * ifmap_dram.bursts + weight_tiles * weight_dram.bursts + psum_tiles * psum_dram.bursts;
+                double hits = ifmap_tiles * ifmap_dram.row_hits + weight_tiles * weight_dram.row_hits + psum_tiles * psum_dram.row_hits;
+                *row_hit_rate = bursts > 0 ? hits / bursts : 0.0;
+            }
+            double cycles = ifmap_tiles * ifmap_cycles + weight_tiles * weight_cycles + psum_tiles * psum_cycles;
+            if (hardware_param.dram.tREFI > 0)
+                cycles *= 1.0 + double(hardware_param.dram.tRFC) / double(hardware_param.dram.tREFI);
+            return cycles;
+        }
+
+        // 記憶體搬運 + PE compute + psum reduction (和 simulator 一樣不 overlap)
         double latency_per_layer()
         {
             return (double(glb_access_per_layer()[6].second) * GLB_ACCESS_TIME / hardware_param.noc_bw
-                    + double(dram_access_per_layer()[6].second) * DRAM_ACCESS_TIME / hardware_param.bus_bw);
+                    + dram_cycles_per_layer() * TIME_UNIT
+                    + double(compute_cycles_per_layer() + reduction_cycles_per_layer()) * TIME_UNIT);
+        }
+
+        // mapping 實際用到的 PE (tk * mode 個 row 可以少於 pe_array_h)
+        int active_pes()
+        {
+            return max(1, min(peak_performance(), mapping.tk * mapping.mode * mapping.tn));
+        }
+
+        // 一組 tk 個 row 累加到最後一個 row 的 stage 數
+        int reduction_stages()
+        {
+            if (hardware_param.psum_reduction == REDUCE_CHAIN)
+                return mapping.tk - 1;
+            int stages = 0;
+            while ((1 << stages) < mapping.tk)
+                stages++;
+            return stages;
+        }
+
+        // 每次把 psum 寫回 GLB 前做一次 reduction (每 stage 1 cycle + 1 cycle 輸出)
+        long long int reduction_cycles_per_layer()
+        {
+            long long int M_div_mode = ceil(double(mapping.M) / double(mapping.mode));
+            long long int B_div_M = ceil(double(linear_shape.B) / double(mapping.M));
+            long long int in_f_div_K = ceil(double(in_features_packed()) / double(mapping.K * ifmap_words()));
+            long long int out_f_div_N = ceil(double(linear_shape.out_features) / double(mapping.N * psum_words()));
+            long long int N_div_tn = ceil(double(mapping.N) / double(mapping.tn));
+            return out_f_div_N * in_f_div_K * B_div_M * M_div_mode * N_div_tn * (reduction_stages() + 1);
         }
 
         int macs_per_layer()
@@ -134,10 +236,37 @@ class EyerissAnalyzer
             return linear_shape.B * linear_shape.in_features * linear_shape.out_features;
         }
 
+        // density-aware: 沒開 zero gating 時每個 MAC 都要做
+        long long int macs_gated_per_layer()
+        {
+            if (hardware_param.zero_gating == GATE_NONE)
+                return 0;
+            double density = min(max(linear_shape.ifmap_density, 0.0), 1.0);
+            return llround(double(macs_per_layer()) * (1.0 - density));
+        }
+
+        long long int macs_executed_per_layer()
+        {
+            return macs_per_layer() - macs_gated_per_layer();
+        }
+
+        // PE array 每個 cycle 每個 PE 做一個 MAC，GATE_SKIP 跳過的 lane 不佔 cycle
+        long long int compute_cycles_per_layer()
+        {
+            long long int issued = hardware_param.zero_gating == GATE_SKIP ? macs_executed_per_layer() : macs_per_layer();
+            return (issued + active_pes() - 1) / active_pes();
+        }
+
+        double compute_energy_per_layer()
+        {
+            return double(macs_executed_per_layer()) * ENERGY_PER_MAC * dp_mac_energy_scale(linear_shape.datapath)
+                   + double(macs_gated_per_layer()) * ENERGY_PER_GATED_MAC;
+        }
+
         vector<pair<string, double>> energy_per_layer()
         {
             vector<pair<string, double>> res;
-            double compute_energy = double(macs_per_layer()) * ENERGY_PER_MAC;
+            double compute_energy = compute_energy_per_layer();
             double memory_energy = (
                 glb_access_per_layer()[6].second * ENERGY_PER_GLB_ACCESS
                 + dram_access_per_layer()[6].second * ENERGY_PER_DRAM_ACCESS
@@ -176,7 +305,7 @@ class EyerissAnalyzer
 
         int peak_performance()
         {
-            return 48;
+            return hardware_param.pe_array_h * hardware_param.pe_array_w;
         }
 
         int peak_bandwidth()
@@ -227,17 +356,28 @@ class EyerissAnalyzer
             result.glb_access = glb_access_per_layer()[6].second;
 
             result.dram_access = dram_access_per_layer()[6].second;
+            result.dram_cycles = (long long int)dram_cycles_per_layer(&result.dram_row_hit_rate);
+            result.dram_bandwidth = result.dram_cycles > 0 ? double(result.dram_access) / double(result.dram_cycles) : 0.0;
 
             result.macs = macs_per_layer();
+            result.macs_executed = macs_executed_per_layer();
+            result.macs_gated = macs_gated_per_layer();
+            result.compute_cycles = compute_cycles_per_layer();
+            result.compute_cycles_saved = (macs_per_layer() + active_pes() - 1) / active_pes() - result.compute_cycles;
             result.latency = latency_per_layer();
 
             result.glb_read = glb_access_per_layer()[4].second;
             result.glb_write = glb_access_per_layer()[5].second;
+            result.glb_conflicts = 0;  // bank conflict 只有 simulator 量得到
+            result.glb_stall_cycles = 0;
+            result.dma_hidden_cycles = 0;
 
             result.dram_read = dram_access_per_layer()[4].second;
             result.dram_write = dram_access_per_layer()[5].second;
 
             result.energy_total = energy_per_layer()[3].second;
+            result.energy_saved = double(macs_per_layer()) * ENERGY_PER_MAC * dp_mac_energy_scale(linear_shape.datapath)
+                                  - compute_energy_per_layer();
             result.power_total = power_per_layer()[3].second;
             result.intensity = operational_intensity();
             result.peak_performance = peak_performance();
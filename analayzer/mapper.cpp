@@ -18,7 +18,7 @@ class EyerissMapper
         EyerissMappingParam best_mapping;
         EyerissMapper()
         {
-
+            generate_hardware();
         }
 
         void run(LinearShapeParam linear, int top_k)
@@ -27,7 +27,6 @@ class EyerissMapper
 
             vector<AnalysisResult> results;
 
-            generate_hardware();
             cout << "Starting design space exploration..." << endl;
             auto mappings = generate_mappings();
             cout << "Total configurations to evaluate: " << mappings.size() << endl;
@@ -126,33 +125,36 @@ class EyerissMapper
         vector<EyerissMappingParam> generate_mappings()
         {
             const int GLB_LIMIT = 64 * 1024; // 64 KB = 65536 bytes
-            const int IFMAP_PER_PE = 3;
-            const int WEIGHT_PER_PE = 4;
+            const int IFMAP_PER_PE = analyzer.ifmap_words();
+            const int WEIGHT_PER_PE = analyzer.psum_words();
 
             vector<EyerissMappingParam> results;
 
-            int tk[4] = {6, 3, 2, 1}; //for GEMM now
-            int tn = 8; //for GEMM and GEMV
-            int mode[4] = {1, 2, 3, 6};
-            for (int i = 0; i < 4; i++)
+            // mode = 累加組數，tk = 每組的 row 數，tk * mode 不超過 PE array 的 row 數
+            // (不用整除，多的 row 閒置，psum reduction network 照組數設定)
+            int pe_rows = analyzer.hardware_param.pe_array_h;
+            int tn = analyzer.hardware_param.pe_array_w; //for GEMM and GEMV
+            for (int mode = 1; mode <= pe_rows; mode++)
+            for (int tk = pe_rows / mode; tk >= 1; tk--)
             {
-                cout << "   trying mode= " << mode[i]<<endl;
-                for(int M = mode[i]; M <= 512; M++)
+                cout << "   trying mode= " << mode << ", tk= " << tk << endl;
+                for(int M = mode; M <= 512; M++)
                 {
                     if(M > analyzer.linear_shape.B)
                         break;// M 不應該大於 batch size
-                    for (int K = tk[i]; K <= 512; K++) 
+                    for (int K = tk; K <= 512; K++) 
                     { 
                         for (int N = tn; N <= 512; N++) 
                         {
                             int used_bytes =  M * K * IFMAP_PER_PE * 4 
                                             + K * IFMAP_PER_PE * N * WEIGHT_PER_PE * 4
-                                            + analyzer.linear_shape.B * N * 4 * 4;
+                                            + analyzer.linear_shape.B * N * WEIGHT_PER_PE * 4;
 
-                            if (used_bytes < GLB_LIMIT) 
-                                results.push_back({tk[i], tn, mode[i], M, K, N});
-                            else 
+                            if (used_bytes >= GLB_LIMIT) 
                                 break; // N 再增大只會超出限制，可提早中斷
+                            // tile loop 以 mode/tk/tn 為步長，M/K/N 要是整數倍才不會跨到下一個 tile
+                            if (M % mode == 0 && K % tk == 0 && N % tn == 0)
+                                results.push_back({tk, tn, mode, M, K, N});
                         }
                     }
                 }
@@ -162,19 +164,31 @@ class EyerissMapper
             return results;
         }
 
-        void generate_hardware()
+        // Eyeriss 硬體參數，PE array 大小可調 (6x8, 12x14, 16x16, 32x32 ...)
+        // spad 大小以 word 數給 (預設 3 個 in_feature, 3 x 4 個 weight, 4 個 psum)
+        static EyerissHardwareParam default_hardware(int pe_array_h = 6, int pe_array_w = 8,
+                                                     int ifmap_words = 3, int psum_words = 4)
         {
             EyerissHardwareParam hardware;
-            hardware.pe_array_h = 6;
-            hardware.pe_array_w = 8;
-            hardware.ifmap_spad_size = 12;
-            hardware.filter_spad_size = 48;
-            hardware.psum_spad_size = 16;
+            hardware.pe_array_h = pe_array_h;
+            hardware.pe_array_w = pe_array_w;
+            hardware.ifmap_spad_size = ifmap_words * DATA_SIZE;
+            hardware.filter_spad_size = ifmap_words * psum_words * DATA_SIZE;
+            hardware.psum_spad_size = psum_words * PSUM_DATA_SIZE;
             hardware.glb_size = 64 * 1024;
             hardware.bus_bw = 4;
             hardware.noc_bw = 4;
+            return hardware;
+        }
 
-            analyzer.hardware_param = hardware;
+        void generate_hardware()
+        {
+            analyzer.hardware_param = default_hardware();
+        }
+
+        void set_hardware(const EyerissHardwareParam& hardware)
+        {
+            analyzer.set_hardware(hardware);
         }
 
         void mapping_to_csv_no_cycle(const AnalysisResult& results, const EyerissMappingParam mappings, const string& filename)
@@ -232,7 +246,10 @@ class EyerissMapper
                     csv << "layer,glb_usage,glb_read,glb_write,glb_access,dram_read,"
                         "dram_write,dram_access,"
                         "macs,intensity,peak_performance,peak_bandwidth,cycles,latency,energy_total,power_total,"
-                        "tk,tn,mode,M,K,N\n";
+                        "tk,tn,mode,M,K,N,"
+                        "zero_gating,macs_executed,macs_gated,compute_cycles_saved,energy_saved,"
+                        "glb_banks,glb_ports,glb_interleave,glb_outstanding,glb_conflicts,glb_stall_cycles,"
+                        "dram_model,dram_cycles,dram_bandwidth,dram_row_hit_rate,dma,dma_hidden_cycles,pipeline\n";
 
                     // 寫入資料
                     csv << "linear,"
@@ -256,7 +273,25 @@ class EyerissMapper
                         << best_mapping.mode << ","
                         << best_mapping.M << ","
                         << best_mapping.N << ","
-                        << best_mapping.K
+                        << best_mapping.K << ","
+                        << gating_name(analyzer.hardware_param.zero_gating) << ","
+                        << best_result.macs_executed << ","
+                        << best_result.macs_gated << ","
+                        << best_result.compute_cycles_saved << ","
+                        << best_result.energy_saved << ","
+                        << analyzer.hardware_param.glb_banks << ","
+                        << analyzer.hardware_param.glb_ports << ","
+                        << glb_interleave_name(analyzer.hardware_param.glb_interleave) << ","
+                        << analyzer.hardware_param.glb_outstanding << ","
+                        << best_result.glb_conflicts << ","
+                        << best_result.glb_stall_cycles << ","
+                        << analyzer.hardware_param.dram_model << ","
+                        << best_result.dram_cycles << ","
+                        << best_result.dram_bandwidth << ","
+                        << best_result.dram_row_hit_rate << ","
+                        << analyzer.hardware_param.dma << ","
+                        << best_result.dma_hidden_cycles << ","
+                        << analyzer.hardware_param.pipeline
                         << "\n";
 
                     csv.close();
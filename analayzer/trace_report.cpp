@@ -0,0 +1,243 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../src/MEM/trace.cpp"
+
+using namespace std;
+
+// tb_pe_array 記下來的 memory trace (src/MEM/trace.cpp) 的離線分析
+// usage: trace_report <trace_file> [window_cycles [block_words [region_words [bandwidth_csv]]]]
+//        (預設 10000 / 8 / 1024，不給 csv 就不寫)
+// 1. 每個 window 的 GLB / DRAM bandwidth (bytes / cycle)
+// 2. reuse distance: 同一個 block 兩次 access 之間碰過幾個不同的 block (每個 level 分開算)
+// 3. hot address range: 以 region_words 為單位 access 最多的 range
+
+// reuse distance 用的 Fenwick tree: 位置 i 是 1 代表那個時間點是某個 block 最近一次 access
+struct Fenwick
+{
+    vector<int> tree;
+
+    Fenwick(size_t n) : tree(n + 1, 0) {}
+
+    void add(size_t i, int v)
+    {
+        for (i++; i < tree.size(); i += i & (~i + 1))
+            tree[i] += v;
+    }
+
+    long long prefix(size_t i) const  // [0, i)
+    {
+        long long s = 0;
+        for (; i > 0; i -= i & (~i + 1))
+            s += tree[i];
+        return s;
+    }
+};
+
+struct RegionStat
+{
+    long long reads = 0;
+    long long writes = 0;
+    long long bytes = 0;
+    long long by_requester[TRACE_REQ_COUNT] = {0};
+};
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        cerr << "usage: trace_report <trace_file> [window_cycles [block_words [region_words [bandwidth_csv]]]]\n";
+        return 1;
+    }
+    long long window = argc >= 3 ? max(1LL, atoll(argv[2])) : 10000;
+    long long block_words = argc >= 4 ? max(1LL, atoll(argv[3])) : 8;
+    long long region_words = argc >= 5 ? max(1LL, atoll(argv[4])) : 1024;
+    string csv_path = argc >= 6 ? argv[5] : "";
+
+    int fd = open(argv[1], O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(TraceFileHeader))
+    {
+        cerr << "Trace Error: cannot read " << argv[1] << endl;
+        return 1;
+    }
+    void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        cerr << "Trace Error: cannot mmap " << argv[1] << endl;
+        return 1;
+    }
+    madvise(base, st.st_size, MADV_SEQUENTIAL);
+    TraceFileHeader header;
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, TRACE_MAGIC, 4) != 0 || header.version != TRACE_VERSION || header.record_size != sizeof(TraceRecord))
+    {
+        cerr << "Trace Error: " << argv[1] << " is not a version " << TRACE_VERSION << " trace" << endl;
+        return 1;
+    }
+    const TraceRecord* records = reinterpret_cast<const TraceRecord*>(static_cast<const char*>(base) + sizeof(TraceFileHeader));
+    size_t n = (st.st_size - sizeof(TraceFileHeader)) / sizeof(TraceRecord);
+    if (n == 0)
+    {
+        cout << "empty trace" << endl;
+        return 0;
+    }
+
+    // 總量 / 每個 requester 的 bytes / 時間範圍
+    long long first_cycle = records[0].cycle, last_cycle = records[0].cycle;
+    long long accesses[TRACE_LEVEL_COUNT][2] = {{0}};
+    long long bytes[TRACE_LEVEL_COUNT][TRACE_REQ_COUNT] = {{0}};
+    for (size_t i = 0; i < n; i++)
+    {
+        const TraceRecord& r = records[i];
+        first_cycle = min(first_cycle, (long long)r.cycle);
+        last_cycle = max(last_cycle, (long long)r.cycle);
+        int level = min(r.level(), TRACE_LEVEL_COUNT - 1);
+        accesses[level][r.is_write()]++;
+        bytes[level][min<int>(r.requester, TRACE_REQ_COUNT - 1)] += r.bytes;
+    }
+    long long span = last_cycle - first_cycle + 1;
+    cout << "records " << n << ", cycles " << first_cycle << " ~ " << last_cycle << endl << endl;
+    cout << left << setw(6) << "level" << right << setw(12) << "reads" << setw(12) << "writes" << setw(14) << "bytes"
+         << setw(10) << "B/cycle";
+    for (int q = 0; q < TRACE_REQ_COUNT; q++)
+        cout << setw(12) << trace_requester_name(q);
+    cout << endl;
+    for (int level = 0; level < TRACE_LEVEL_COUNT; level++)
+    {
+        long long total = 0;
+        for (int q = 0; q < TRACE_REQ_COUNT; q++)
+            total += bytes[level][q];
+        cout << left << setw(6) << trace_level_name(level) << right << setw(12) << accesses[level][0] << setw(12) << accesses[level][1]
+             << setw(14) << total << setw(10) << fixed << setprecision(3) << double(total) / span;
+        for (int q = 0; q < TRACE_REQ_COUNT; q++)
+            cout << setw(12) << bytes[level][q];
+        cout << endl;
+    }
+
+    // 1. bandwidth over time
+    size_t windows = size_t(span / window) + 1;
+    vector<long long> window_bytes[TRACE_LEVEL_COUNT];
+    for (int level = 0; level < TRACE_LEVEL_COUNT; level++)
+        window_bytes[level].assign(windows, 0);
+    for (size_t i = 0; i < n; i++)
+        window_bytes[min(records[i].level(), TRACE_LEVEL_COUNT - 1)][(records[i].cycle - first_cycle) / window] += records[i].bytes;
+    cout << endl << "bandwidth per " << window << "-cycle window (B/cycle):" << endl;
+    for (int level = 0; level < TRACE_LEVEL_COUNT; level++)
+    {
+        const vector<long long>& w = window_bytes[level];
+        size_t peak = max_element(w.begin(), w.end()) - w.begin();
+        long long idle = count(w.begin(), w.end(), 0LL);
+        cout << "   " << left << setw(6) << trace_level_name(level) << right << "peak " << double(w[peak]) / window
+             << " at cycle " << first_cycle + (long long)peak * window << ", idle windows " << idle << " / " << windows << endl;
+    }
+    if (!csv_path.empty())
+    {
+        ofstream csv(csv_path);
+        csv << "cycle";
+        for (int level = 0; level < TRACE_LEVEL_COUNT; level++)
+            csv << "," << trace_level_name(level) << "_bytes_per_cycle";
+        csv << "\n";
+        for (size_t i = 0; i < windows; i++)
+        {
+            csv << first_cycle + (long long)i * window;
+            for (int level = 0; level < TRACE_LEVEL_COUNT; level++)
+                csv << "," << double(window_bytes[level][i]) / window;
+            csv << "\n";
+        }
+        cout << "   written to " << csv_path << endl;
+    }
+
+    // 2. reuse distance (block 為單位，依 trace 順序)
+    cout << endl << "reuse distance (" << block_words << "-word blocks, distinct blocks in between):" << endl;
+    for (int level = 0; level < TRACE_LEVEL_COUNT; level++)
+    {
+        vector<uint32_t> blocks;
+        for (size_t i = 0; i < n; i++)
+        {
+            if (records[i].level() == level)
+                blocks.push_back(records[i].address / block_words);
+        }
+        if (blocks.empty())
+            continue;
+        Fenwick live(blocks.size());
+        unordered_map<uint32_t, size_t> last;
+        last.reserve(min<size_t>(blocks.size(), 1 << 20));
+        vector<long long> histogram(34, 0);  // [0] cold，[1] 距離 0，[k] 距離 [2^(k-2), 2^(k-1))
+        for (size_t i = 0; i < blocks.size(); i++)
+        {
+            auto it = last.find(blocks[i]);
+            if (it == last.end())
+            {
+                histogram[0]++;
+                last.emplace(blocks[i], i);
+            }
+            else
+            {
+                long long distance = live.prefix(i) - live.prefix(it->second + 1);
+                int bucket = 1;
+                while (bucket < 33 && distance >= (1LL << (bucket - 1)))
+                    bucket++;
+                histogram[bucket]++;
+                live.add(it->second, -1);
+                it->second = i;
+            }
+            live.add(i, 1);
+        }
+        cout << "   " << trace_level_name(level) << ": " << blocks.size() << " accesses, " << last.size() << " blocks, cold "
+             << histogram[0] << endl;
+        for (int k = 1; k < 34; k++)
+        {
+            if (histogram[k] == 0)
+                continue;
+            string range = k == 1 ? "0" : to_string(1LL << (k - 2)) + " ~ " + to_string((1LL << (k - 1)) - 1);
+            cout << "      " << left << setw(20) << range << right << setw(12) << histogram[k] << setw(8)
+                 << setprecision(1) << 100.0 * histogram[k] / blocks.size() << "%" << endl;
+        }
+        cout << setprecision(3);
+    }
+
+    // 3. hot address range
+    cout << endl << "hot address ranges (" << region_words << " words):" << endl;
+    for (int level = 0; level < TRACE_LEVEL_COUNT; level++)
+    {
+        unordered_map<uint32_t, RegionStat> regions;
+        for (size_t i = 0; i < n; i++)
+        {
+            const TraceRecord& r = records[i];
+            if (r.level() != level)
+                continue;
+            RegionStat& s = regions[r.address / region_words];
+            (r.is_write() ? s.writes : s.reads)++;
+            s.bytes += r.bytes;
+            s.by_requester[min<int>(r.requester, TRACE_REQ_COUNT - 1)]++;
+        }
+        vector<pair<uint32_t, RegionStat>> sorted(regions.begin(), regions.end());
+        sort(sorted.begin(), sorted.end(), [](const pair<uint32_t, RegionStat>& a, const pair<uint32_t, RegionStat>& b)
+             { return a.second.reads + a.second.writes > b.second.reads + b.second.writes; });
+        for (size_t i = 0; i < min<size_t>(10, sorted.size()); i++)
+        {
+            const RegionStat& s = sorted[i].second;
+            int top = max_element(s.by_requester, s.by_requester + TRACE_REQ_COUNT) - s.by_requester;
+            cout << "   " << left << setw(6) << trace_level_name(level) << right << "[" << setw(9)
+                 << (long long)sorted[i].first * region_words << ", " << setw(9) << (long long)(sorted[i].first + 1) * region_words
+                 << ")  reads " << setw(10) << s.reads << "  writes " << setw(10) << s.writes
+                 << "  mostly " << trace_requester_name(top) << endl;
+        }
+    }
+
+    munmap(base, st.st_size);
+    return 0;
+}
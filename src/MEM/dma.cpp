@@ -0,0 +1,136 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include "dram.cpp"
+
+using namespace std;
+
+// DRAM <-> GLB 的 DMA transfer descriptor，最多 3 維
+// 最內層 size[0] 個連續 word，size[1] 個 row (差 stride[0])，size[2] 個 plane (差 stride[1])
+struct DMADescriptor
+{
+    long long dram_address = 0;
+    long long glb_address = 0;
+    int size[3] = {0, 1, 1};
+    long long dram_stride[2] = {0, 0};
+    long long glb_stride[2] = {0, 0};
+    bool to_dram = false;  // false: DRAM -> GLB (load)，true: GLB -> DRAM (write back)
+    int requester = TRACE_REQ_OTHER;  // TraceRequester
+
+    long long words() const
+    {
+        return (long long)size[0] * size[1] * size[2];
+    }
+};
+
+// 一個 channel 的 DMA engine: descriptor 依序處理 (FIFO)，和 PE array 同時跑
+// submit() 馬上回傳 id，完成時間由 DRAM model 決定 (dram 是 nullptr 時每個 word 固定 cycles_per_word)
+// tile loop 用 wait() 等資料，回傳要 stall 的 cycle 數
+// GLB 那一側假設跟得上 DRAM (DRAM 是瓶頸)，glb_address 只是記錄放在哪裡
+class DMAEngine
+{
+    public:
+        DRAM* dram;
+        int cycles_per_word;
+
+        // counter
+        long long transfers = 0;
+        long long words = 0;
+        long long busy_cycles = 0;     // engine 在搬資料的 cycle
+        long long exposed_cycles = 0;  // wait() 真的 stall 的 cycle
+        long long waited_cycles = 0;   // 被 wait() 的 transfer 的總搬運時間
+        long long drain_cycles = 0;    // wait_all() stall 的 cycle (不是某一個被 wait() 的 transfer，不算進 hidden)
+
+        DMAEngine(DRAM* dram = nullptr, int cycles_per_word = 5) : dram(dram), cycles_per_word(cycles_per_word)
+        {
+        }
+
+        void reset()
+        {
+            free_at = 0;
+            start_at.clear();
+            done_at.clear();
+            transfers = words = busy_cycles = exposed_cycles = waited_cycles = drain_cycles = 0;
+        }
+
+        // checkpoint: 發過的 transfer 都要留著 (wait() 用 id 查)
+        template <typename Archive>
+        void checkpoint(Archive& ar)
+        {
+            ar.io(transfers);
+            ar.io(words);
+            ar.io(busy_cycles);
+            ar.io(exposed_cycles);
+            ar.io(waited_cycles);
+            ar.io(drain_cycles);
+            ar.io(free_at);
+            ar.io(start_at);
+            ar.io(done_at);
+        }
+
+        // now 之後 engine 空下來就開始搬，回傳 transfer id
+        int submit(const DMADescriptor& d, long long now)
+        {
+            long long start = max(now, free_at);
+            long long duration = 0;
+            if (dram == nullptr)
+            {
+                duration = d.words() * cycles_per_word;
+            }
+            else
+            {
+                for (int plane = 0; plane < d.size[2]; plane++)
+                    duration += dram->access_block(start + duration, d.dram_address + plane * d.dram_stride[1],
+                                                   d.size[0], d.size[1], d.dram_stride[0], d.to_dram, d.requester);
+            }
+            free_at = start + duration;
+            start_at.push_back(start);
+            done_at.push_back(free_at);
+            transfers++;
+            words += d.words();
+            busy_cycles += duration;
+            return int(done_at.size()) - 1;
+        }
+
+        bool done(int id, long long now) const
+        {
+            return done_at[id] <= now;
+        }
+
+        // 在 now 等 id 完成，回傳 stall 的 cycle (0 = 已經搬完，latency 全部藏在 compute 後面)
+        long long wait(int id, long long now)
+        {
+            long long stall = max(0LL, done_at[id] - now);
+            exposed_cycles += stall;
+            waited_cycles += done_at[id] - start_at[id];
+            return stall;
+        }
+
+        // 全部 transfer 做完 (例如最後的 write back)
+        long long wait_all(long long now)
+        {
+            long long stall = max(0LL, free_at - now);
+            drain_cycles += stall;
+            return stall;
+        }
+
+        // 被 wait() 的 transfer 有多少搬運時間藏在 compute 後面
+        long long hidden_cycles() const
+        {
+            return max(0LL, waited_cycles - exposed_cycles);
+        }
+
+        void print_stats(ostream& os) const
+        {
+            os << "DMA: transfers " << transfers << ", words " << words << ", busy " << busy_cycles
+               << " cycles, exposed " << exposed_cycles << " cycles, hidden " << hidden_cycles() << " cycles, drain "
+               << drain_cycles << " cycles" << endl;
+        }
+
+    private:
+        long long free_at = 0;
+        vector<long long> start_at;
+        vector<long long> done_at;
+};
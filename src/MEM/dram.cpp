@@ -0,0 +1,195 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "../../analayzer/data_type.h"
+#include "trace.cpp"
+
+using namespace std;
+
+// DRAM timing model: channel / bank / row buffer / burst / refresh
+// request 以 burst 為單位依序發 (FCFS controller)，不同 bank 的 activate 可以重疊，
+// 同一個 channel 的 data bus 一次只給一個 burst
+// 時間是絕對的 cycle (和 simulator 的 total_cycles 同一個時間軸)，refresh 照 tREFI 發生
+class DRAM
+{
+    public:
+        DRAMTimingParam timing;
+
+        // counter
+        long long bursts = 0;
+        long long write_bursts = 0;
+        long long row_hits = 0;
+        long long row_misses = 0;      // bank 沒有開 row
+        long long row_conflicts = 0;   // bank 開著別的 row，要先 precharge
+        long long refreshes = 0;
+        long long words = 0;           // 實際要的 word 數 (不含 burst 裡多搬的)
+        long long busy_cycles = 0;     // access() 花掉的 cycle 總和
+
+        TraceRecorder* trace = nullptr;  // 不是 nullptr 時每個 burst 記一筆
+
+        DRAM(const DRAMTimingParam& timing = DRAMTimingParam()) : timing(timing)
+        {
+            this->timing.channels = max(1, timing.channels);
+            this->timing.banks = max(1, timing.banks);
+            this->timing.row_words = max(1, timing.row_words);
+            this->timing.burst_words = max(1, min(timing.burst_words, this->timing.row_words));
+            reset();
+        }
+
+        void reset()
+        {
+            int n = timing.channels * timing.banks;
+            open_row.assign(n, -1);
+            bank_ready.assign(n, 0);
+            bus_free.assign(timing.channels, 0);
+            last_command = 0;
+            next_refresh = timing.tREFI;
+            bursts = write_bursts = row_hits = row_misses = row_conflicts = refreshes = words = busy_cycles = 0;
+        }
+
+        // checkpoint: counter 和 bank / bus 的 timing state
+        template <typename Archive>
+        void checkpoint(Archive& ar)
+        {
+            ar.io(bursts);
+            ar.io(write_bursts);
+            ar.io(row_hits);
+            ar.io(row_misses);
+            ar.io(row_conflicts);
+            ar.io(refreshes);
+            ar.io(words);
+            ar.io(busy_cycles);
+            ar.io(open_row);
+            ar.io(bank_ready);
+            ar.io(bus_free);
+            ar.io(last_command);
+            ar.io(next_refresh);
+        }
+
+        // 一塊 2D 的 tile: rows 段，每段 cols 個連續 word，段和段之間差 stride 個 word
+        // start 是發出的 cycle，回傳從 start 到最後一個 burst 的資料傳完的 cycle 數
+        // requester (TraceRequester) 只給 trace 用
+        long long access_block(long long start, long long base, int cols, int rows, long long stride, bool is_write = false,
+                               int requester = TRACE_REQ_OTHER)
+        {
+            long long t = max(start, last_command);
+            long long finish = start;
+            for (int r = 0; r < rows; r++)
+            {
+                long long first = base + r * stride;
+                long long last = first + cols - 1;
+                words += cols;
+                // 一段跨過的每個 burst 都要搬 (頭尾沒對齊的部分也要整個 burst)
+                for (long long b = first / timing.burst_words; b <= last / timing.burst_words; b++)
+                {
+                    long long done = burst(t, b * timing.burst_words, is_write);
+                    if (trace)
+                        trace->record(done - timing.tBURST, TRACE_DRAM, is_write, b * timing.burst_words, timing.burst_words * 4, requester);
+                    finish = max(finish, done);
+                }
+            }
+            busy_cycles += finish - start;
+            return finish - start;
+        }
+
+        long long access(long long start, long long address, int count, bool is_write = false, int requester = TRACE_REQ_OTHER)
+        {
+            return access_block(start, address, count, 1, count, is_write, requester);
+        }
+
+        double row_hit_rate() const
+        {
+            return bursts > 0 ? double(row_hits) / double(bursts) : 0.0;
+        }
+
+        // bytes / cycle
+        double bandwidth() const
+        {
+            return busy_cycles > 0 ? double(words) * 4.0 / double(busy_cycles) : 0.0;
+        }
+
+        void print_stats(ostream& os) const
+        {
+            os << "DRAM: " << timing.channels << " channels x " << timing.banks << " banks, "
+               << (timing.open_page ? "open" : "closed") << " page, bursts " << bursts
+               << ", row hit " << row_hit_rate() * 100 << "% (miss " << row_misses << ", conflict " << row_conflicts << ")"
+               << ", refreshes " << refreshes << ", bandwidth " << bandwidth() << " B/cycle" << endl;
+        }
+
+    private:
+        vector<long long> open_row;    // [channel * banks + bank]，-1 = 沒開
+        vector<long long> bank_ready;  // bank 下一個 command 最早的 cycle
+        vector<long long> bus_free;    // channel 的 data bus 空下來的 cycle
+        long long last_command;        // FCFS: command 不能比前一個早
+        long long next_refresh;
+
+        // 到 t 為止該做的 refresh: 所有 row 關掉，bank 在 tRFC 內不能用
+        void refresh_until(long long t)
+        {
+            if (timing.tREFI <= 0)
+                return;
+            while (next_refresh <= t)
+            {
+                for (size_t i = 0; i < bank_ready.size(); i++)
+                {
+                    bank_ready[i] = max(bank_ready[i], next_refresh + timing.tRFC);
+                    open_row[i] = -1;
+                }
+                refreshes++;
+                next_refresh += timing.tREFI;
+            }
+        }
+
+        // 回傳這個 burst 資料傳完的 cycle
+        long long burst(long long& t, long long address, bool is_write)
+        {
+            long long rest = address / timing.row_words;
+            int channel = rest % timing.channels;
+            int bank = (rest / timing.channels) % timing.banks;
+            long long row = rest / timing.channels / timing.banks;
+            int id = channel * timing.banks + bank;
+
+            // command 最多只比 data bus 提早 precharge + activate + CAS 發 (controller queue 不是無限大)
+            long long command = max(max(t, bank_ready[id]), bus_free[channel] - timing.tRP - timing.tRCD - timing.tCAS);
+            refresh_until(command);
+            command = max(command, bank_ready[id]);
+
+            long long column;
+            if (open_row[id] == row)
+            {
+                row_hits++;
+                column = command;
+            }
+            else if (open_row[id] < 0)
+            {
+                row_misses++;
+                column = command + timing.tRCD;
+            }
+            else
+            {
+                row_conflicts++;
+                column = command + timing.tRP + timing.tRCD;
+            }
+            long long data = max(column + timing.tCAS, bus_free[channel]);
+            bus_free[channel] = data + timing.tBURST;
+            if (timing.open_page)
+            {
+                open_row[id] = row;
+                bank_ready[id] = column + timing.tBURST;
+            }
+            else
+            {
+                open_row[id] = -1;
+                bank_ready[id] = data + timing.tBURST + timing.tRP;
+            }
+            bursts++;
+            if (is_write)
+                write_bursts++;
+            last_command = command;
+            t = command;
+            return bus_free[channel];
+        }
+};
@@ -0,0 +1,394 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <iomanip>
+#include "../../analayzer/data_type.h"
+#include "trace.cpp"
+
+using namespace std;
+
+// 一次 access() 的 latency 和它加到 per-bank counter 的量 (fast mode 同樣的 bank pattern 直接套用)
+// cost 還要看開始時 port 的狀態 (pipeline 時前一個 stage 可能還佔著)，after 是做完的 relative_state()
+struct GLBAccessCost
+{
+    bool valid = false;
+    long long latency = 0;
+    vector<long long> reads;
+    vector<long long> writes;
+    vector<long long> busy_cycles;
+    vector<long long> conflicts;
+    vector<long long> stall_cycles;
+    vector<long long> after;
+};
+
+// relative_state() 當 key 用
+struct GLBStateHash
+{
+    size_t operator()(const vector<long long>& state) const
+    {
+        size_t h = state.size();
+        for (long long v : state)
+            h = h * 1000003u ^ size_t(v);
+        return h;
+    }
+};
+
+// Banked global buffer
+// word address -> (bank, row) 由 interleave 決定，每個 bank 有 ports 個 port
+// 每個 port 每個 cycle 收一個 request，最多 max_outstanding 個在路上 (和 memory 一樣)
+// max_outstanding = 1 就是不 pipeline: 一次 access 佔住 port access_cycles 個 cycle
+// request 依序 issue，bank 的 port 都忙時後面的 request 一起 stall (in-order NoC)
+// port 的狀態在 simulator 的時間軸上 (access() 的 start)，pipeline 時同時在跑的 stage 搶同一批 bank / port
+class GLB
+{
+    public:
+        int num_banks;
+        int ports;
+        int access_cycles;
+        int interleave;
+        int block_words;   // GLB_INTERLEAVE_BLOCK 時連續幾個 word 放同一個 bank
+        int max_outstanding;  // 每個 port
+        int size;          // word 數
+
+        vector<int32_t> mem;
+
+        // per-bank counter
+        vector<long long> reads;
+        vector<long long> writes;
+        vector<long long> busy_cycles;    // 所有 port 被佔用的 cycle 總和
+        vector<long long> conflicts;      // bank 忙 (但別的 bank 有空) 而 stall 的 request 數
+        vector<long long> stall_cycles;   // 上面那些 request 等了多少 cycle
+        long long total_cycles = 0;       // access() 花掉的 cycle 總和
+
+        TraceRecorder* trace = nullptr;   // 不是 nullptr 時每個 request 記一筆
+
+        GLB(int size_words = 16 * 1024, int num_banks = 1, int ports = 1, int access_cycles = 2,
+            int interleave = GLB_INTERLEAVE_WORD, int max_outstanding = 1, int block_words = 8)
+            : num_banks(max(1, num_banks)), ports(max(1, ports)), access_cycles(max(1, access_cycles)),
+              interleave(interleave), block_words(max(1, block_words)), max_outstanding(max(1, max_outstanding)),
+              size(size_words)
+        {
+            mem.assign(size, 0);
+            port_free.assign(this->num_banks * this->ports, 0);
+            in_flight.assign(this->num_banks * this->ports * this->max_outstanding, 0);
+            in_flight_head.assign(this->num_banks * this->ports, 0);
+            reset_stats();
+        }
+
+        void reset_stats()
+        {
+            reads.assign(num_banks, 0);
+            writes.assign(num_banks, 0);
+            busy_cycles.assign(num_banks, 0);
+            conflicts.assign(num_banks, 0);
+            stall_cycles.assign(num_banks, 0);
+            total_cycles = 0;
+        }
+
+        // counter 和 port 都重新開始 (複製來的 GLB 從 cycle 0 再跑)
+        void reset()
+        {
+            fill(port_free.begin(), port_free.end(), 0);
+            fill(in_flight.begin(), in_flight.end(), 0);
+            fill(in_flight_head.begin(), in_flight_head.end(), 0);
+            busy_until = 0;
+            reset_stats();
+        }
+
+        template <typename Archive>
+        void checkpoint(Archive& ar)
+        {
+            ar.io(reads);
+            ar.io(writes);
+            ar.io(busy_cycles);
+            ar.io(conflicts);
+            ar.io(stall_cycles);
+            ar.io(total_cycles);
+            ar.io(port_free);
+            ar.io(in_flight);
+            ar.io(in_flight_head);
+            ar.io(busy_until);
+        }
+
+        // 另一個同樣大小的 GLB (平行模擬的 worker) 的 counter 加進來
+        void merge_stats(const GLB& other)
+        {
+            for (int b = 0; b < num_banks; b++)
+            {
+                reads[b] += other.reads[b];
+                writes[b] += other.writes[b];
+                busy_cycles[b] += other.busy_cycles[b];
+                conflicts[b] += other.conflicts[b];
+                stall_cycles[b] += other.stall_cycles[b];
+            }
+            total_cycles += other.total_cycles;
+        }
+
+        int bank_of(int address) const
+        {
+            uint32_t a = uint32_t(address);
+            switch (interleave)
+            {
+                case GLB_INTERLEAVE_BLOCK:
+                    return (a / block_words) % num_banks;
+                case GLB_INTERLEAVE_XOR:
+                {
+                    // row bit 折回 bank bit，stride 是 bank 數倍數的 access 也會散開
+                    uint32_t row = a / num_banks;
+                    return (a ^ row ^ (row / num_banks)) % num_banks;
+                }
+                default:
+                    return a % num_banks;
+            }
+        }
+
+        // address 加上這個數的倍數 bank 不變 (access() 的結果一樣)，0 = 沒有小的週期
+        int bank_period() const
+        {
+            bool pow2 = (num_banks & (num_banks - 1)) == 0;
+            switch (interleave)
+            {
+                case GLB_INTERLEAVE_BLOCK:
+                    return block_words * num_banks;
+                case GLB_INTERLEAVE_XOR:
+                    // bank 數是 2 的次方時只看 address 的低 3 * log2(num_banks) 個 bit
+                    return pow2 && num_banks <= 32 ? num_banks * num_banks * num_banks : 0;
+                default:
+                    return num_banks;
+            }
+        }
+
+        int32_t read(int address) const
+        {
+            if (address < 0 || address >= size)
+            {
+                cerr << "GLB Read Error: Address out of bounds" << endl;
+                return 0;
+            }
+            return mem[address];
+        }
+
+        void write(int address, int32_t data)
+        {
+            if (address < 0 || address >= size)
+            {
+                cerr << "GLB Write Error: Address out of bounds" << endl;
+                return;
+            }
+            mem[address] = data;
+        }
+
+        // 一批一起發出的 request (例如一個 tile 的 spad fill)，回傳從 start 到最後一個完成的 cycle 數
+        // 每個 cycle 最多 issue num_banks * ports 個 request
+        // start: 這一批在 simulator 時間軸上開始的 cycle，之前的 access 還佔著的 port 要等 (requester 只給 trace 用)
+        long long access(const vector<int>& addresses, bool is_write = false, long long start = 0, int requester = TRACE_REQ_OTHER)
+        {
+            if (addresses.empty())
+                return 0;
+            long long t = start;       // 目前 issue 的 cycle
+            int issued = 0;            // 這個 cycle 已經 issue 幾個
+            long long finish = start;
+            int issue_width = num_banks * ports;
+            int occupancy = (access_cycles + max_outstanding - 1) / max_outstanding;  // 平均一個 request 佔 port 幾個 cycle
+            for (int address : addresses)
+            {
+                int b = bank_of(address);
+                int q = b * ports;
+                for (int k = b * ports + 1; k < (b + 1) * ports; k++)
+                {
+                    if (port_ready(k) < port_ready(q))
+                        q = k;
+                }
+                long long ready = port_ready(q);
+                if (ready > t)
+                {
+                    // 別的 bank 還有空的 port 才算 conflict，全部都忙是 GLB 頻寬不夠
+                    bool other_free = false;
+                    for (int k = 0; k < num_banks * ports && !other_free; k++)
+                        other_free = port_ready(k) <= t;
+                    if (other_free)
+                    {
+                        conflicts[b]++;
+                        stall_cycles[b] += ready - t;
+                    }
+                    t = ready;
+                    issued = 0;
+                }
+                else if (issued == issue_width)
+                {
+                    t++;
+                    issued = 0;
+                }
+                port_free[q] = t + 1;
+                in_flight[q * max_outstanding + in_flight_head[q]] = t + access_cycles;
+                in_flight_head[q] = (in_flight_head[q] + 1) % max_outstanding;
+                finish = max(finish, t + access_cycles);
+                issued++;
+                if (trace)
+                    trace->record(t, TRACE_GLB, is_write, address, 4, requester);
+                busy_cycles[b] += occupancy;
+                if (is_write)
+                    writes[b]++;
+                else
+                    reads[b]++;
+            }
+            busy_until = max(busy_until, finish);
+            total_cycles += finish - start;
+            return finish - start;
+        }
+
+        // start 時沒有還沒做完的 request (relative_state() 全部是 0)
+        bool idle_at(long long start) const
+        {
+            return busy_until <= start;
+        }
+
+        // port 的狀態相對於 start: 已經空下來的都是 0，outstanding 的 ring 從最舊的排起 (之後的 access 只看這些)
+        // port_free 全部排完再排 in_flight
+        void relative_state(long long start, vector<long long>& state) const
+        {
+            state.clear();
+            for (long long f : port_free)
+                state.push_back(max(0LL, f - start));
+            for (int q = 0; q < num_banks * ports; q++)
+            {
+                for (int k = 0; k < max_outstanding; k++)
+                    state.push_back(max(0LL, in_flight[q * max_outstanding + (in_flight_head[q] + k) % max_outstanding] - start));
+            }
+        }
+
+        // access() 一次並記下它的 cost (counter 照常累加)
+        GLBAccessCost measure(const vector<int>& addresses, bool is_write = false, long long start = 0)
+        {
+            GLBAccessCost before;
+            before.reads = reads;
+            before.writes = writes;
+            before.busy_cycles = busy_cycles;
+            before.conflicts = conflicts;
+            before.stall_cycles = stall_cycles;
+            GLBAccessCost c;
+            c.valid = true;
+            c.latency = access(addresses, is_write, start);
+            c.reads = reads;
+            c.writes = writes;
+            c.busy_cycles = busy_cycles;
+            c.conflicts = conflicts;
+            c.stall_cycles = stall_cycles;
+            for (int b = 0; b < num_banks; b++)
+            {
+                c.reads[b] -= before.reads[b];
+                c.writes[b] -= before.writes[b];
+                c.busy_cycles[b] -= before.busy_cycles[b];
+                c.conflicts[b] -= before.conflicts[b];
+                c.stall_cycles[b] -= before.stall_cycles[b];
+            }
+            relative_state(start, c.after);
+            return c;
+        }
+
+        // measure() 過的 access 在 start 再做一次 (不 trace)，start 的 relative_state() 要和 measure 時一樣
+        long long apply(const GLBAccessCost& c, long long start = 0)
+        {
+            const long long* after = c.after.data();
+            long long* free = port_free.data();
+            for (size_t q = 0; q < port_free.size(); q++)
+                free[q] = start + after[q];
+            after += port_free.size();
+            long long* flight = in_flight.data();
+            for (size_t k = 0; k < in_flight.size(); k++)
+                flight[k] = start + after[k];
+            fill(in_flight_head.begin(), in_flight_head.end(), 0);
+            busy_until = max(busy_until, start + c.latency);
+            for (int b = 0; b < num_banks; b++)
+            {
+                reads[b] += c.reads[b];
+                writes[b] += c.writes[b];
+                busy_cycles[b] += c.busy_cycles[b];
+                conflicts[b] += c.conflicts[b];
+                stall_cycles[b] += c.stall_cycles[b];
+            }
+            total_cycles += c.latency;
+            return c.latency;
+        }
+
+        long long total_reads() const
+        {
+            long long sum = 0;
+            for (long long r : reads)
+                sum += r;
+            return sum;
+        }
+
+        long long total_writes() const
+        {
+            long long sum = 0;
+            for (long long w : writes)
+                sum += w;
+            return sum;
+        }
+
+        long long total_conflicts() const
+        {
+            long long sum = 0;
+            for (long long c : conflicts)
+                sum += c;
+            return sum;
+        }
+
+        long long total_busy_cycles() const
+        {
+            long long sum = 0;
+            for (long long c : busy_cycles)
+                sum += c;
+            return sum;
+        }
+
+        long long total_stall_cycles() const
+        {
+            long long sum = 0;
+            for (long long c : stall_cycles)
+                sum += c;
+            return sum;
+        }
+
+        // bank 的 port 使用率，以 cycles (預設是 GLB 自己的 access cycle) 為分母
+        double utilization(int bank, long long cycles = 0) const
+        {
+            if (cycles <= 0)
+                cycles = total_cycles;
+            return cycles > 0 ? double(busy_cycles[bank]) / double(cycles * ports) : 0.0;
+        }
+
+        void print_stats(ostream& os, long long cycles = 0) const
+        {
+            os << "GLB: " << num_banks << " banks x " << ports << " ports (" << max_outstanding << " outstanding), interleave " << glb_interleave_name(interleave)
+               << ", conflicts " << total_conflicts() << " (" << total_stall_cycles() << " stall cycles)" << endl;
+            for (int b = 0; b < num_banks; b++)
+                os << "  bank " << setw(2) << b << ": reads " << reads[b] << ", writes " << writes[b]
+                   << ", conflicts " << conflicts[b] << ", utilization " << fixed << setprecision(2)
+                   << utilization(b, cycles) * 100 << "%" << defaultfloat << endl;
+        }
+
+        void stats_to_csv(ostream& csv, long long cycles = 0) const
+        {
+            csv << "bank,reads,writes,busy_cycles,conflicts,stall_cycles,utilization\n";
+            for (int b = 0; b < num_banks; b++)
+                csv << b << "," << reads[b] << "," << writes[b] << "," << busy_cycles[b] << ","
+                    << conflicts[b] << "," << stall_cycles[b] << "," << utilization(b, cycles) << "\n";
+        }
+
+    private:
+        vector<long long> port_free;       // 每個 port 下一次可以收 request 的 cycle
+        vector<long long> in_flight;       // 每個 port 最近 max_outstanding 個 request 的完成 cycle (ring)
+        vector<int> in_flight_head;        // ring 裡最舊的那一個
+        long long busy_until = 0;          // 最後一個 request 做完的 cycle (port_free / in_flight 都不會超過)
+
+        // port 可以收下一個 request 的 cycle: 這個 cycle 還沒收過，而且 outstanding 還沒滿
+        long long port_ready(int q) const
+        {
+            return max(port_free[q], in_flight[q * max_outstanding + in_flight_head[q]]);
+        }
+};
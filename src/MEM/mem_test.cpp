@@ -1,11 +1,14 @@
 #include <iostream>
 #include <vector>
-#include <sstream>
 #include <string>
 #include <fstream>
 
 #include "memory.cpp"
+#include "glb.cpp"
+#include "dma.cpp"
 #include "../PE/pe_array.cpp"
+#include "../../testbench/Pattern/tensor_file.cpp"
+#include "../../testbench/Pattern/hex_loader.cpp"
 
 using namespace std;
 
@@ -13,6 +16,10 @@ long long int cycle = 0;
 void load_data(memory &mem, const string &filename);//directly load data into memory
 void read_data(memory &mem, int address);//read data from memory, need to wait until read_done is true
 void write_data(memory &mem, int address, int data);//write data to memory, need to wait until write_done is true
+long long stream_data(memory &mem, const vector<int> &addresses, bool mixed);//pipelined: issue one request per cycle, return cycles until all responses
+void check(const string &name, long long got, long long expected);//不一樣時印 MISMATCH 並計入 errors
+
+int errors = 0;
 
 PE_Array pe_array;
 
@@ -53,42 +60,235 @@ int main()
     cout << "Cycle after write now: " << cycle << endl;
     cout << "=== Memory Write Test Done ===" << endl;
 
+    // 舊介面: 同一個 cycle 發一個 read 和一個 write，兩個都要完成 (各自的 slot，不佔 pipelined queue)
+    cout << endl << "=== Read + Write Same Cycle Test Start ===" << endl;
+    memory slot_mem(3);
+    slot_mem.mem.assign(16, 0);
+    slot_mem.mem[1] = 11;
+    slot_mem.read(1);
+    slot_mem.write(2, 22);
+    check("same-cycle write busy", slot_mem.write_busy, 1);
+    check("queue slot still free", slot_mem.can_issue(), 1);
+    for (int c = 0; c < 2; c++)
+        slot_mem.step_cycle();
+    check("read done before latency", slot_mem.read_done, 0);
+    check("write done before latency", slot_mem.write_done, 0);
+    slot_mem.step_cycle();
+    check("read done", slot_mem.read_done, 1);
+    check("write done", slot_mem.write_done, 1);
+    check("read value", slot_mem.read_value, 11);
+    check("written value", slot_mem.mem[2], 22);
+    check("busy after done", slot_mem.read_busy || slot_mem.write_busy, 0);
+    check("legacy requests in queue", slot_mem.has_response() || !slot_mem.idle(), 0);
+    cout << "=== Read + Write Same Cycle Test Done ===" << endl;
+
     cout << endl << "=== Parallel Test Start ===" << endl;
     pe_array.reset();
 
     pe_array.mode = 1;
     pe_array.set_tag();
 
-    return 0;
+    // 同一串 access: 逐一等完 (read_data) vs pipelined (一個 cycle 發一個，最多 N 個 outstanding)
+    cout << endl << "=== Pipelined Memory Test Start ===" << endl;
+    vector<int> stream;
+    for (int i = 0; i < 64; i++)
+        stream.push_back(i * 7 % int(mem.mem.size()));
+    memory serial_mem(10);
+    serial_mem.mem = mem.mem;
+    long long serial_cycles = 0;
+    for (int address : stream)
+    {
+        serial_mem.read(address);
+        while (!serial_mem.read_done)
+        {
+            serial_mem.step_cycle();
+            serial_cycles++;
+        }
+    }
+    cout << "serialized: " << serial_cycles << " cycles" << endl;
+    for (int outstanding : {1, 2, 4, 8, 16})
+    {
+        memory pipe_mem(10, outstanding);
+        pipe_mem.mem = mem.mem;
+        long long cycles = stream_data(pipe_mem, stream, false);
+        cout << "outstanding " << outstanding << ": " << cycles << " cycles (" << double(serial_cycles) / cycles << "x)" << endl;
+    }
+    // write 比 read 慢時，out-of-order 完成讓後面的 read 不用等前面的 write
+    for (bool in_order : {true, false})
+    {
+        memory pipe_mem(4, 8, in_order, 12);
+        pipe_mem.mem = mem.mem;
+        long long cycles = stream_data(pipe_mem, stream, true);
+        cout << "read/write mix, " << (in_order ? "in-order" : "out-of-order") << " completion: " << cycles << " cycles" << endl;
+    }
+    cout << "=== Pipelined Memory Test Done ===" << endl;
+
+    // 同一批 strided read 在不同 interleave 下的 bank conflict (8 bank x 1 port，access 2 cycle)
+    // 預期值: 同一個 bank 連續的 request 每個等 2 cycle 而且別的 bank 空著 (conflict)，散在 8 個 bank 時一個 cycle 發 8 個
+    //   word:  stride 1 散開，stride 8 / 256 全在 bank 0
+    //   block: 8 個 word 一個 bank，stride 1 每 8 個擠在一起，stride 8 散開，stride 256 全在 bank 0
+    //   xor:   stride 256 時 bank = (4 * i) % 8，只用到 bank 0 / 4 兩個
+    cout << endl << "=== GLB Bank Conflict Test Start ===" << endl;
+    const int strides[3] = {1, 8, 256};
+    const long long expected_glb[3][GLB_INTERLEAVE_COUNT][3] = {  // {cycles, conflicts, stall cycles}
+        {{16, 0, 0}, {114, 56, 112}, {16, 0, 0}},
+        {{128, 63, 126}, {16, 0, 0}, {16, 0, 0}},
+        {{128, 63, 126}, {128, 63, 126}, {64, 31, 62}},
+    };
+    for (int s = 0; s < 3; s++)
+    {
+        int stride = strides[s];
+        vector<int> addresses;
+        for (int i = 0; i < 64; i++)
+            addresses.push_back(i * stride % (16 * 1024));
+        for (int interleave = 0; interleave < GLB_INTERLEAVE_COUNT; interleave++)
+        {
+            GLB glb(16 * 1024, 8, 1, 2, interleave);
+            long long cycles = glb.access(addresses);
+            cout << "stride " << stride << ", interleave " << glb_interleave_name(interleave) << ": " << cycles
+                 << " cycles, conflicts " << glb.total_conflicts() << endl;
+            string name = "GLB stride " + to_string(stride) + " " + glb_interleave_name(interleave);
+            check(name + " cycles", cycles, expected_glb[s][interleave][0]);
+            check(name + " conflicts", glb.total_conflicts(), expected_glb[s][interleave][1]);
+            check(name + " stall cycles", glb.total_stall_cycles(), expected_glb[s][interleave][2]);
+            check(name + " reads", glb.total_reads(), 64);
+            // 全在 bank 0 時 bank 0 整段都在忙
+            if (expected_glb[s][interleave][1] == 63)
+                check(name + " bank 0 utilization %", llround(glb.utilization(0) * 100), 100);
+        }
+    }
+    cout << "=== GLB Bank Conflict Test Done ===" << endl;
+
+    // port 的狀態在 simulator 的時間軸上: 上一批 (stride 1，16 cycle) 還沒做完就開始的一批要等 port 空下來
+    // 8 個 bank 都忙是頻寬不夠，不算 conflict；fast mode 用 measure() / apply() 重做同一批要得到一樣的狀態
+    cout << endl << "=== GLB Timeline Test Start ===" << endl;
+    {
+        vector<int> addresses;
+        for (int i = 0; i < 64; i++)
+            addresses.push_back(i);
+        GLB glb(16 * 1024, 8, 1, 2);
+        check("GLB timeline first", glb.access(addresses, false, 0), 16);
+        check("GLB timeline overlapped", glb.access(addresses, false, 4), 12 + 16);
+        check("GLB timeline overlapped conflicts", glb.total_conflicts(), 0);
+        check("GLB timeline after idle", glb.access(addresses, false, 40), 16);
+        check("GLB timeline total cycles", glb.total_cycles, 16 + 28 + 16);
+
+        GLB measured(16 * 1024, 8, 1, 2);
+        GLB applied(16 * 1024, 8, 1, 2);
+        measured.access(addresses, false, 100);
+        applied.access(addresses, false, 100);
+        vector<int> half(addresses.begin(), addresses.begin() + 8);
+        GLBAccessCost cost = measured.measure(half, true, 110);
+        check("GLB timeline measure overlapped", cost.latency, 6 + 2);
+        check("GLB timeline apply", applied.apply(cost, 110), cost.latency);
+        check("GLB timeline apply writes", applied.total_writes(), 8);
+        check("GLB timeline next after apply", applied.access(addresses, false, 112), measured.access(addresses, false, 112));
+    }
+    cout << "=== GLB Timeline Test Done ===" << endl;
+
+    // DRAM timing (預設 1 channel x 8 bank，tRCD = tCAS = tRP = 3，一個 burst 8 word 佔 bus 8 cycle)
+    cout << endl << "=== DRAM Timing Test Start ===" << endl;
+    {
+        // 同一個 row 連續 64 word: 第一個 burst miss (tRCD + tCAS = 6 cycle 後開始傳)，後面 7 個 hit 接著傳，bus 不空
+        DRAM dram;
+        check("DRAM stream cycles", dram.access(0, 0, 64), 6 + 8 * 8);
+        check("DRAM stream bursts", dram.bursts, 8);
+        check("DRAM stream row misses", dram.row_misses, 1);
+        check("DRAM stream row hits", dram.row_hits, 7);
+        // 同一個 bank 別的 row (row 1 = word 512 * 8 banks) 要先 precharge，別的 bank (word 512) 只是 miss
+        dram.access(1000, 512 * 8, 8);
+        check("DRAM same bank other row conflicts", dram.row_conflicts, 1);
+        dram.access(1100, 512, 8);
+        check("DRAM other bank misses", dram.row_misses, 2);
+        // 開著的 row 在 tREFI (1560) 的 refresh 之後關掉，再讀 row 1 是 miss 而不是 hit
+        dram.access(2000, 512 * 8 + 8, 8);
+        check("DRAM refreshes", dram.refreshes, 1);
+        check("DRAM miss after refresh", dram.row_misses, 3);
+        check("DRAM words", dram.words, 64 + 8 + 8 + 8);
+
+        // closed page: 每個 burst 都要重新 activate
+        DRAMTimingParam closed;
+        closed.open_page = false;
+        DRAM closed_dram(closed);
+        closed_dram.access(0, 0, 16);
+        check("DRAM closed page row hits", closed_dram.row_hits, 0);
+        check("DRAM closed page row misses", closed_dram.row_misses, 2);
+        dram.print_stats(cout);
+    }
+    cout << "=== DRAM Timing Test Done ===" << endl;
+
+    // 8 個 2-D tile，每個 tile compute 400 cycle: 要的時候才搬 vs 提早一個 tile 發出
+    cout << endl << "=== DMA Prefetch Test Start ===" << endl;
+    for (bool prefetch : {false, true})
+    {
+        DRAM dram;
+        DMAEngine dma(&dram);
+        long long now = 0;
+        int next = -1;
+        for (int t = 0; t < 8; t++)
+        {
+            DMADescriptor d;
+            d.dram_address = t * 64;
+            d.size[0] = 16;
+            d.size[1] = 4;
+            d.dram_stride[0] = 512;
+            int id = next >= 0 ? next : dma.submit(d, now);
+            now += dma.wait(id, now);
+            next = -1;
+            if (prefetch && t + 1 < 8)
+            {
+                d.dram_address += 64;
+                next = dma.submit(d, now);
+            }
+            now += 400;
+        }
+        // 最後的 write back: wait_all 的 stall 另外算 (drain)，不影響 wait() 的 exposed / hidden
+        long long exposed = dma.exposed_cycles;
+        long long hidden = dma.hidden_cycles();
+        DMADescriptor back;
+        back.size[0] = 64;
+        back.to_dram = true;
+        long long busy = dma.busy_cycles;
+        dma.submit(back, now);
+        now += dma.wait_all(now);
+        cout << (prefetch ? "prefetch" : "on demand") << ": " << now << " cycles, ";
+        dma.print_stats(cout);
+        string name = prefetch ? "DMA prefetch" : "DMA on demand";
+        check(name + " exposed + hidden == waited", dma.exposed_cycles + dma.hidden_cycles(), dma.waited_cycles);
+        if (prefetch)
+            check(name + " hides latency", dma.hidden_cycles() > 0, 1);
+        else
+            check(name + " hidden", dma.hidden_cycles(), 0);
+        check(name + " drain", dma.drain_cycles, dma.busy_cycles - busy);
+        check(name + " exposed after drain", dma.exposed_cycles, exposed);
+        check(name + " hidden after drain", dma.hidden_cycles(), hidden);
+    }
+    cout << "=== DMA Prefetch Test Done ===" << endl;
+
+    if (errors == 0)
+        cout << endl << "All memory checks passed!" << endl;
+    else
+        cout << endl << "Total " << errors << " memory checks failed!" << endl;
+    return errors == 0 ? 0 : 1;
 }
 
 void load_data(memory &mem, const string &filename)
 {
-    ifstream file(filename);
-    if (!file.is_open()) 
+    // 旁邊有 .bin 的話直接從 mmap 複製 (memory 可以寫，不能只拿 view)
+    TensorFile bin;
+    if (filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".txt") == 0
+        && bin.open(filename.substr(0, filename.size() - 4) + ".bin"))
     {
-        cerr << "Error opening file: " << filename << endl;
+        mem.mem.insert(mem.mem.end(), bin.view().begin(), bin.view().end());
+        cout << "Successfully map file: " << filename.substr(0, filename.size() - 4) + ".bin" << endl;
         return;
     }
-    else
-        cout << "Successfully open file: " << filename << endl;
-    string line;
-    while (getline(file, line)) 
+    if (!load_hex_file(mem.mem, filename))
     {
-        if (line.empty()) continue;
-        int32_t val;
-        stringstream ss(line);
-        ss >> hex >> val;
-        if (ss.fail()) 
-        {
-            cerr << "⚠️  Invalid line in " << filename << ": " << line << endl;
-            continue;
-        }
-        //cout << "load value: " << val << endl;
-        mem.mem.push_back(val);
+        cerr << "Error opening file: " << filename << endl;
+        return;
     }
-
-    file.close();
+    cout << "Successfully open file: " << filename << endl;
 }
 
 void read_data(memory &mem, int address)
@@ -127,4 +327,42 @@ void write_data(memory &mem, int address, int data)
         cerr << "Write Error" << endl;
     else
         cout << "mem[" << address << "]" << "now is: " << mem.mem[address] << endl;
-}
\ No newline at end of file
+}
+long long stream_data(memory &mem, const vector<int> &addresses, bool mixed)
+{
+    long long start = mem.cycle;
+    size_t next = 0;
+    size_t responses = 0;
+    vector<int> expected(addresses.size());
+    while (responses < addresses.size())
+    {
+        if (next < addresses.size() && mem.can_issue())
+        {
+            int address = addresses[next];
+            int id;
+            if (mixed && next % 2 == 0)
+                id = mem.issue_write(address, mem.mem[address]);
+            else
+                id = mem.issue_read(address);
+            expected[id] = mem.mem[address];
+            next++;
+        }
+        mem.step_cycle();
+        MemRequest response;
+        while (mem.pop_response(response))
+        {
+            if (response.data != expected[response.id])
+                cerr << "Response Error: id " << response.id << endl;
+            responses++;
+        }
+    }
+    return mem.cycle - start;
+}
+
+void check(const string &name, long long got, long long expected)
+{
+    if (got == expected)
+        return;
+    cout << name << " = " << got << " (expected " << expected << ") <-- MISMATCH!" << endl;
+    errors++;
+}
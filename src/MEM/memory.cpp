@@ -1,54 +1,129 @@
+#pragma once
+
 #include <iostream>
 #include <vector>
+#include <deque>
 #include <stdexcept>
 
 
 using namespace std;
 
-class memory 
+struct MemRequest
+{
+    int id;
+    bool is_write;
+    int address;
+    int data;               // write 的資料 / read 回來的值
+    long long issue_cycle;
+    long long ready_cycle;  // 資料準備好的 cycle
+};
+
+// Pipelined, non-blocking memory
+// 每個 cycle 最多收一個新的 request，最多 max_outstanding 個在路上，每個 request 有自己的 id
+// 完成的 request 進 completion queue，in_order 時照 issue 順序出來，否則誰先好誰先出來
+// read() / write() / read_done / write_done 是舊的單一 request 介面: read 和 write 各有一個自己的 slot
+// (和原本一樣可以同時各有一個在路上)，不佔 queue 的 issue slot / outstanding
+class memory
 {
     public:
-        int access_cycles;
-        int read_cycles = 0;
-        int write_cycles = 0;
-        int size;
+        int access_cycles;        // read latency
+        int write_access_cycles;  // write latency
+        int max_outstanding;
+        bool in_order;
+
+        long long cycle = 0;
+        long long reads = 0;
+        long long writes = 0;
+        long long full_stalls = 0;     // queue 滿而被拒絕的 issue 次數
+        long long max_in_flight = 0;
+
         bool read_busy = false;
         bool write_busy = false;
         bool read_done = false;
         bool write_done = false;
-        
+
         vector<int> mem;
         int read_value = 0;
-        memory(int access_cycles) : access_cycles(access_cycles)
+
+        memory(int access_cycles, int max_outstanding = 1, bool in_order = true, int write_access_cycles = -1)
+            : access_cycles(access_cycles), write_access_cycles(write_access_cycles < 0 ? access_cycles : write_access_cycles),
+              max_outstanding(max(1, max_outstanding)), in_order(in_order)
+        {
+
+        }
+
+        int outstanding() const
+        {
+            return int(in_flight.size());
+        }
+
+        // 這個 cycle 還能不能收 request
+        bool can_issue() const
+        {
+            return last_issue_cycle != cycle && outstanding() < max_outstanding;
+        }
+
+        // 回傳 request id，不能收時回傳 -1 (下個 cycle 再試)
+        int issue_read(int address)
+        {
+            return issue(false, address, 0);
+        }
+
+        int issue_write(int address, int data)
+        {
+            return issue(true, address, data);
+        }
+
+        // 拿一個完成的 request，沒有的話回傳 false
+        bool pop_response(MemRequest& response)
+        {
+            if (completed.empty())
+                return false;
+            response = completed.front();
+            completed.pop_front();
+            return true;
+        }
+
+        bool has_response() const
+        {
+            return !completed.empty();
+        }
+
+        bool idle() const
         {
-           
+            return in_flight.empty() && completed.empty();
         }
 
-        void write(int address, int data) 
+        void write(int address, int data)
         {
             if(read_done)
                 read_done = false;
-            if (address >= 0 && address < size) 
+            write_done = false;
+            if (address >= 0 && address < int(mem.size()))
             {
-                write_busy = true;
                 mem[address] = data;
-            } 
-            else 
+                writes++;
+                write_busy = true;
+                write_ready = cycle + write_access_cycles;
+            }
+            else
             {
                 cerr << "Write Error: Address out of bounds" << endl;
             }
         }
 
-        void read(int address) 
+        void read(int address)
         {
             if(read_done)
                 read_done = false;
-            if (address >= 0 && address < size) 
+            if (address >= 0 && address < int(mem.size()))
             {
+                reads++;
                 read_busy = true;
-                read_value = mem[address];
-            } 
-            else 
+                read_address = address;
+                read_ready = cycle + access_cycles;
+            }
+            else
             {
                 cerr << "Read Error: Address out of bounds" << endl;
             }
@@ -56,33 +131,110 @@ class memory
 
         void step_cycle()
         {
-            if(read_busy)
-                read_cycles++;
-
-            if(write_busy)
-                write_cycles++;
-
-            if(read_cycles == access_cycles) 
+            cycle++;
+            // 舊介面的 read / write slot
+            if (read_busy && read_ready <= cycle)
             {
-                if(read_busy)
-                {
-                    read_done = true;
-                    read_busy = false;
-                }
-                read_cycles = 0;
+                read_value = mem[read_address];
+                read_busy = false;
+                read_done = true;
             }
-
-            if(write_cycles == access_cycles) 
+            if (write_busy && write_ready <= cycle)
+            {
+                write_busy = false;
+                write_done = true;
+            }
+            // 到期的 request 完成 (in_order 時前面的還沒好，後面的要等)
+            for (size_t i = 0; i < in_flight.size(); )
             {
-                if(write_busy)
+                if (in_flight[i].ready_cycle <= cycle && (!in_order || i == 0))
                 {
-                    write_done = true;
-                    write_busy = false;
+                    MemRequest r = in_flight[i];
+                    if (!r.is_write)
+                        r.data = mem[r.address];
+                    in_flight.erase(in_flight.begin() + i);
+                    completed.push_back(r);
+                }
+                else if (in_order)
+                {
+                    break;
+                }
+                else
+                {
+                    i++;
                 }
-                write_cycles = 0;
             }
+        }
+
+        // 最早完成的 request 的 ready cycle，沒有 request 在路上時回傳 -1 (event kernel 用來跳過閒置的 cycle)
+        long long next_ready_cycle() const
+        {
+            long long t = -1;
+            auto earliest = [&](long long ready)
+            {
+                t = t < 0 ? ready : min(t, ready);
+            };
+            if (read_busy)
+                earliest(read_ready);
+            if (write_busy)
+                earliest(write_ready);
+            if (!in_flight.empty())
+                earliest(in_flight.front().ready_cycle);
+            for (size_t i = 1; i < in_flight.size() && !in_order; i++)
+                earliest(in_flight[i].ready_cycle);
+            return t < 0 ? -1 : max(t, cycle + 1);
+        }
+
+        // 直接跳到 cycle t (中間沒有 request 完成時和 step_cycle() t - cycle 次一樣)
+        void step_to(long long t)
+        {
+            if (t <= cycle)
+                return;
+            cycle = t - 1;
+            step_cycle();
+        }
 
-            //cout << "read_cycle: " << read_cycles << endl;
-            //cout << "write_cycle: " << write_cycles << endl;
+    private:
+        deque<MemRequest> in_flight;   // issue 順序
+        deque<MemRequest> completed;
+        long long last_issue_cycle = -1;
+        int next_id = 0;
+        int read_address = 0;      // 舊介面的 read slot
+        long long read_ready = 0;
+        long long write_ready = 0; // 舊介面的 write slot
+
+        int issue(bool is_write, int address, int data)
+        {
+            if (address < 0 || address >= int(mem.size()))
+            {
+                cerr << (is_write ? "Write" : "Read") << " Error: Address out of bounds" << endl;
+                return -1;
+            }
+            if (!can_issue())
+            {
+                full_stalls++;
+                return -1;
+            }
+            MemRequest r;
+            r.id = next_id++;
+            r.is_write = is_write;
+            r.address = address;
+            r.data = data;
+            r.issue_cycle = cycle;
+            r.ready_cycle = cycle + (is_write ? write_access_cycles : access_cycles);
+            if (is_write)
+            {
+                mem[address] = data;
+                writes++;
+            }
+            else
+            {
+                reads++;
+            }
+            in_flight.push_back(r);
+            last_issue_cycle = cycle;
+            max_in_flight = max<long long>(max_in_flight, in_flight.size());
+            return r.id;
         }
-};
\ No newline at end of file
+
+};
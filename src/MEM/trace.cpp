@@ -0,0 +1,209 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+// GLB / DRAM 的 memory traffic trace
+// 每個 access 一筆 16 bytes 的 TraceRecord，放進 single-producer / single-consumer 的 lock-free ring，
+// 背景 thread 一批一批 fwrite 到檔案 (格式: [TraceFileHeader][TraceRecord ...]，little endian)
+// 沒開 trace 時 GLB / DRAM 的 trace 指標是 nullptr，hot loop 只多一個 branch
+// 分析用 analayzer/trace_report.cpp
+
+enum TraceLevel
+{
+    TRACE_GLB = 0,
+    TRACE_DRAM,
+    TRACE_LEVEL_COUNT,
+};
+
+// 誰發的 request
+enum TraceRequester
+{
+    TRACE_REQ_OTHER = 0,
+    TRACE_REQ_IFMAP,
+    TRACE_REQ_WEIGHT,
+    TRACE_REQ_PSUM,
+    TRACE_REQ_COUNT,
+};
+
+inline const char* trace_level_name(int level)
+{
+    switch (level)
+    {
+        case TRACE_GLB: return "glb";
+        case TRACE_DRAM: return "dram";
+        default: return "unknown";
+    }
+}
+
+inline const char* trace_requester_name(int requester)
+{
+    switch (requester)
+    {
+        case TRACE_REQ_IFMAP: return "ifmap";
+        case TRACE_REQ_WEIGHT: return "weight";
+        case TRACE_REQ_PSUM: return "psum";
+        default: return "other";
+    }
+}
+
+struct TraceRecord
+{
+    uint64_t cycle;     // 絕對 cycle (simulator 的 total_cycles 時間軸)
+    uint32_t address;   // word address (GLB / DRAM 各自的 address space)
+    uint16_t bytes;
+    uint8_t level_rw;   // bit 0 ~ 6: TraceLevel，bit 7: write
+    uint8_t requester;  // TraceRequester
+
+    int level() const { return level_rw & 0x7f; }
+    bool is_write() const { return (level_rw & 0x80) != 0; }
+};
+static_assert(sizeof(TraceRecord) == 16, "trace record must stay 16 bytes");
+
+constexpr char TRACE_MAGIC[4] = {'E', 'Y', 'T', 'R'};
+constexpr uint32_t TRACE_VERSION = 1;
+
+struct TraceFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+};
+
+class TraceRecorder
+{
+    public:
+        static constexpr size_t RING_RECORDS = 1 << 16;  // 2 的冪次 (1 MB)
+        static constexpr size_t FLUSH_RECORDS = 1 << 12; // 背景 thread 最少湊這麼多筆才寫 (結束時除外)
+
+        long long full_waits = 0;  // ring 滿了 producer 等的次數 (不丟資料)
+
+        TraceRecorder() : ring(RING_RECORDS) {}
+        ~TraceRecorder()
+        {
+            close();
+        }
+
+        TraceRecorder(const TraceRecorder&) = delete;
+        TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+        bool open(const string& path)
+        {
+            close();
+            file = fopen(path.c_str(), "wb");
+            if (file == nullptr)
+            {
+                cerr << "Trace Error: cannot open " << path << endl;
+                return false;
+            }
+            TraceFileHeader header;
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, TRACE_MAGIC, 4);
+            header.version = TRACE_VERSION;
+            header.record_size = sizeof(TraceRecord);
+            fwrite(&header, sizeof(header), 1, file);
+            head.store(0);
+            tail.store(0);
+            written = 0;
+            full_waits = 0;
+            running.store(true);
+            writer = thread(&TraceRecorder::drain_loop, this);
+            return true;
+        }
+
+        // 等背景 thread 把 ring 寫完再關檔
+        void close()
+        {
+            if (file == nullptr)
+                return;
+            running.store(false, memory_order_release);
+            writer.join();
+            fclose(file);
+            file = nullptr;
+        }
+
+        bool is_open() const
+        {
+            return file != nullptr;
+        }
+
+        // 只能從一個 thread (simulator) 呼叫
+        void record(long long cycle, int level, bool is_write, long long address, int bytes, int requester)
+        {
+            size_t h = head.load(memory_order_relaxed);
+            while (h - tail.load(memory_order_acquire) == RING_RECORDS)
+            {
+                full_waits++;
+                this_thread::yield();
+            }
+            TraceRecord& r = ring[h & (RING_RECORDS - 1)];
+            r.cycle = uint64_t(cycle);
+            r.address = uint32_t(address);
+            r.bytes = uint16_t(bytes);
+            r.level_rw = uint8_t(level | (is_write ? 0x80 : 0));
+            r.requester = uint8_t(requester);
+            head.store(h + 1, memory_order_release);
+        }
+
+        long long records() const
+        {
+            return (long long)head.load(memory_order_acquire);
+        }
+
+        long long records_written() const
+        {
+            return written;
+        }
+
+    private:
+        vector<TraceRecord> ring;
+        atomic<size_t> head{0};  // producer 寫到哪
+        atomic<size_t> tail{0};  // consumer 寫到哪
+        atomic<bool> running{false};
+        thread writer;
+        FILE* file = nullptr;
+        long long written = 0;
+
+        void drain_loop()
+        {
+            while (true)
+            {
+                bool stop = !running.load(memory_order_acquire);
+                size_t t = tail.load(memory_order_relaxed);
+                size_t h = head.load(memory_order_acquire);
+                if (h == t)
+                {
+                    if (stop)
+                        break;
+                    this_thread::sleep_for(chrono::microseconds(200));
+                    continue;
+                }
+                if (h - t < FLUSH_RECORDS && !stop && h - t < RING_RECORDS / 2)
+                {
+                    this_thread::sleep_for(chrono::microseconds(50));
+                    h = head.load(memory_order_acquire);
+                }
+                // ring 尾端繞回來時分兩段寫
+                while (t != h)
+                {
+                    size_t begin = t & (RING_RECORDS - 1);
+                    size_t n = min(h - t, RING_RECORDS - begin);
+                    fwrite(&ring[begin], sizeof(TraceRecord), n, file);
+                    written += n;
+                    t += n;
+                    tail.store(t, memory_order_release);
+                }
+            }
+            fflush(file);
+        }
+};
@@ -0,0 +1,108 @@
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <iomanip>
+#include <array>
+#include <random>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include "pe.cpp"
+#include "../../testbench/Pattern/hex_loader.cpp"
+using namespace std;
+
+// PE::compute_full microbenchmark: 每個 kernel 跑一次完整的 Pattern3 GEMM，
+// 比較時間並確認結果和 scalar kernel bit-exact
+
+vector<int32_t> run_gemm(PE& pe, const vector<int32_t>& A, const vector<int32_t>& B, int m, int n_div4, int p);
+
+int main()
+{
+    // Pattern3: A(256 x 8192) * B(8192 x 256)
+    int m = 256;
+    int n = 128 * 8 * 8;
+    int p = 256;
+    int n_div4 = n / 4;
+
+    string folder = "../../testbench/Pattern/Pattern3/";
+    vector<int32_t> A = read_hex_file(folder + "A.txt");
+    vector<int32_t> B = read_hex_file(folder + "B.txt");
+    vector<int32_t> golden = read_hex_file(folder + "C_golden.txt");
+
+    bool from_file = (A.size() == size_t(m * n_div4) && B.size() == size_t(n_div4 * p));
+    if (!from_file)
+    {
+        // pattern 沒有放進 repo 時用同樣大小的隨機資料
+        cout << "Pattern3 A/B not found, using random data of the same shape\n";
+        mt19937 rng(3);
+        uniform_int_distribution<uint32_t> dist(0, 0xFFFFFFFF);
+        A.resize(m * n_div4);
+        B.resize(n_div4 * p);
+        for (auto& v : A) v = int32_t(dist(rng));
+        for (auto& v : B) v = int32_t(dist(rng));
+    }
+
+    long long macs = (long long)m * n * p;
+    cout << "GEMM " << m << " x " << n << " x " << p << " (" << macs << " MACs)\n\n";
+
+    vector<int32_t> reference;
+    double scalar_time = 0;
+    for (int k = 0; k < PE_KERNEL_COUNT; k++)
+    {
+        if (!PEKernelDispatch::select(PEKernel(k)))
+        {
+            cout << setw(12) << pe_kernel_name(PEKernel(k)) << ": not supported on this CPU\n";
+            continue;
+        }
+        PE pe;
+        auto start = chrono::steady_clock::now();
+        vector<int32_t> C = run_gemm(pe, A, B, m, n_div4, p);
+        double sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        if (k == PE_KERNEL_SCALAR)
+        {
+            reference = C;
+            scalar_time = sec;
+        }
+        bool exact = (C == reference);
+        bool pass_golden = from_file && golden.size() == C.size() && C == golden;
+
+        cout << setw(12) << pe_kernel_name(PEKernel(k)) << ": "
+             << fixed << setprecision(3) << sec << " s, "
+             << setprecision(1) << macs / sec / 1e6 << " MMAC/s, "
+             << "speedup " << setprecision(2) << scalar_time / sec << "x, "
+             << "cycle " << pe.get_cycle() << ", "
+             << (exact ? "bit-exact" : "MISMATCH");
+        if (from_file)
+            cout << ", golden " << (pass_golden ? "PASSED" : "FAILED");
+        cout << "\n";
+    }
+    return 0;
+}
+
+// 每個 PE pass 讀 3 個 in_feature 和 3 x 4 個 weight，psum 一直累加到整個 n 做完
+vector<int32_t> run_gemm(PE& pe, const vector<int32_t>& A, const vector<int32_t>& B, int m, int n_div4, int p)
+{
+    vector<int32_t> C(m * p, 0);
+    for (int i = 0; i < m; i++)
+    {
+        for (int j = 0; j < p; j += PE::PSUM_SIZE)
+        {
+            pe.reset_psum();
+            for (int k = 0; k < n_div4; k += PE::IFMAP_SIZE)
+            {
+                for (int l = 0; l < PE::IFMAP_SIZE; l++)
+                {
+                    bool valid = (k + l < n_div4);
+                    pe.in_feature_spad[l] = valid ? A[i * n_div4 + k + l] : 0;
+                    for (int o = 0; o < PE::PSUM_SIZE; o++)
+                        pe.weight_spad[l * PE::PSUM_SIZE + o] = valid ? B[(k + l) * p + j + o] : 0;
+                }
+                pe.compute_full();
+            }
+            for (int o = 0; o < PE::PSUM_SIZE; o++)
+                C[i * p + j + o] = pe.output_psum(o);
+        }
+    }
+    return C;
+}
@@ -0,0 +1,90 @@
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <iomanip>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include "pe_array.cpp"
+using namespace std;
+
+// 平行 stepping scaling benchmark: 大 PE array 逐 cycle step 到 idle 再 add_ipsum_all，
+// thread 數從 1 到 N，結果要和 1 thread bit-exact
+// usage: bench_parallel [pe_rows pe_cols [max_threads [passes]]]   (default 32 x 32, max(4, hardware_concurrency), 200)
+
+struct RunResult
+{
+    double sec;
+    long long steps;
+    vector<int32_t> psum;
+    vector<int> cycle;
+};
+
+RunResult run_passes(PE_Array& pe_array, const vector<int32_t>& ifmap, const vector<int32_t>& weight, int passes);
+
+int main(int argc, char* argv[])
+{
+    int pe_rows = 32;
+    int pe_cols = 32;
+    int max_threads = max(4u, thread::hardware_concurrency());
+    int passes = 200;
+    if (argc >= 3)
+    {
+        pe_rows = atoi(argv[1]);
+        pe_cols = atoi(argv[2]);
+    }
+    if (argc >= 4)
+        max_threads = atoi(argv[3]);
+    if (argc >= 5)
+        passes = atoi(argv[4]);
+
+    PE_Array pe_array(pe_rows, pe_cols);
+    pe_array.mode = 1;
+    pe_array.set_tag();
+
+    mt19937 rng(8);
+    vector<int32_t> ifmap(pe_array.ifmap_plane.size());
+    vector<int32_t> weight(pe_array.weight_plane.size());
+    for (auto& v : ifmap) v = int32_t(rng());
+    for (auto& v : weight) v = int32_t(rng());
+
+    cout << "PE array " << pe_rows << " x " << pe_cols << " (" << pe_array.num_pe << " PEs), "
+         << passes << " passes, hardware threads " << thread::hardware_concurrency() << "\n\n";
+
+    RunResult reference;
+    for (int t = 1; t <= max_threads; t *= 2)
+    {
+        pe_array.set_threads(t);
+        RunResult r = run_passes(pe_array, ifmap, weight, passes);
+        if (t == 1)
+            reference = r;
+        bool exact = r.psum == reference.psum && r.cycle == reference.cycle && r.steps == reference.steps;
+        cout << setw(3) << t << " threads: " << fixed << setprecision(3) << r.sec << " s, "
+             << setprecision(1) << double(r.steps) * pe_array.num_pe / r.sec / 1e6 << " M PE-cycles/s, "
+             << "speedup " << setprecision(2) << reference.sec / r.sec << "x, "
+             << (exact ? "identical" : "MISMATCH") << "\n";
+    }
+    return 0;
+}
+
+RunResult run_passes(PE_Array& pe_array, const vector<int32_t>& ifmap, const vector<int32_t>& weight, int passes)
+{
+    RunResult r;
+    r.steps = 0;
+    pe_array.reset();
+    pe_array.set_tag();
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < passes; i++)
+    {
+        pe_array.ifmap_plane = ifmap;
+        pe_array.weight_plane = weight;
+        pe_array.start_step();
+        r.steps += pe_array.step_until_idle();
+        pe_array.add_ipsum_all();
+    }
+    r.sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    r.psum = pe_array.psum_plane;
+    r.cycle = pe_array.cycle;
+    return r;
+}
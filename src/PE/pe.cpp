@@ -4,16 +4,24 @@
 #include <iomanip>
 #include <cstring>
 #include <array>
+#include "pe_spec.cpp"
 using namespace std;
 
-class PE 
+// spad 大小與 datapath (lane 格式) 是 template 參數，compute_full / step_cycle 的 trip count 都是常數
+// runtime 要選大小時用 pe_spec_registry() 裡同樣參數的 PESpec
+template <int IFMAP_N, int WEIGHT_H_N, int DP = DP_U8>
+class PE_T 
 {
     public:
-        static constexpr int IFMAP_SIZE  = 3;  // 4 bytes
-        static constexpr int WEIGHT_H  = 4;  // 4 bytes
+        static constexpr int IFMAP_SIZE  = IFMAP_N;  // 4 bytes
+        static constexpr int WEIGHT_H  = WEIGHT_H_N;  // 4 bytes
         static constexpr int WEIGHT_V  = IFMAP_SIZE;  // 4 bytes
-        static constexpr int WEIGHT_SIZE = 12;  // 4 bytes
-        static constexpr int PSUM_SIZE   = 4;  // 4 bytes (store 4x int32)
+        static constexpr int WEIGHT_SIZE = IFMAP_SIZE * WEIGHT_H;  // 4 bytes
+        static constexpr int PSUM_SIZE   = WEIGHT_H;  // 4 bytes (store 4x int32)
+        static constexpr int DATAPATH    = DP;
+        static constexpr int LANE_WIDTH  = dp_lane_bits(DP);
+        static constexpr int LANES       = dp_lanes(DP);  // lanes per word
+        static constexpr int MACS        = IFMAP_SIZE * PSUM_SIZE * LANES;  // cycles of compute_full
 
         // scratchpad memories
         // in_feature use 12 bytes
@@ -22,6 +30,11 @@ class PE
         int32_t  weight_spad[WEIGHT_SIZE];
         int32_t psum_spad[PSUM_SIZE];
 
+        // ping-pong: double_buffer 時下一個 tile 先載到 shadow，swap_spads() 後才給 compute 用
+        bool double_buffer = false;
+        int32_t in_feature_shadow[IFMAP_SIZE];
+        int32_t weight_shadow[WEIGHT_SIZE];
+
         //tag
         int tag;
 
@@ -34,17 +47,29 @@ class PE
 
         int cycle; // current cycle
 
-        PE() 
+        // zero gating (ZeroGating): ifmap lane 為 0 的 MAC 不做
+        int gating = GATE_NONE;
+        long long macs_executed;
+        long long macs_gated;
+
+        PE_T() 
         {
             reset();
         }
 
+        static PESpec spec()
+        {
+            return make_pe_spec<IFMAP_N, WEIGHT_H_N, DP>();
+        }
+
         // reset everything
         void reset() 
         {
             memset(in_feature_spad, 0, sizeof(in_feature_spad));
             memset(weight_spad, 0, sizeof(weight_spad));
             memset(psum_spad, 0, sizeof(psum_spad));
+            memset(in_feature_shadow, 0, sizeof(in_feature_shadow));
+            memset(weight_shadow, 0, sizeof(weight_shadow));
             weight_idx = 0;
             if_idx = 0;
             cal_idx = 0;
@@ -52,6 +77,8 @@ class PE
             out_valid = false;
             tag = 0;
             cycle = 0;
+            macs_executed = 0;
+            macs_gated = 0;
         }
         //set tag
         void set_tag(int t) 
@@ -65,15 +92,15 @@ class PE
             cout << "IFMAP: "<< "\n";
             for (int i = 0; i < IFMAP_SIZE; i++) 
             {
-                for(int j = 0; j < 4; j++)
-                    cout << setw(10) << (int)((in_feature_spad[i] >> 8*j)  & 0xFF);
+                for(int j = 0; j < LANES; j++)
+                    cout << setw(10) << pe_lane_int(in_feature_spad[i], j, DP);
                 cout << "\n";
             }
             cout << "\nFILTER:"<< "\n";
             for (int i = 0; i < WEIGHT_SIZE; i++) 
             {
-                for(int j = 0; j < 4; j++)
-                    cout << setw(10) << (int)((weight_spad[i] >> 8*j)  & 0xFF);
+                for(int j = 0; j < LANES; j++)
+                    cout << setw(10) << pe_lane_int(weight_spad[i], j, DP);
                 cout << "\n";
             }
             cout << "\nPSUM:  "<< "\n";
@@ -84,33 +111,36 @@ class PE
             cout << "\n";
         }
 
+        // 載入用的 spad: double_buffer 時是 shadow，否則直接寫 active spad
+        int32_t* in_feature_fill()
+        {
+            return double_buffer ? in_feature_shadow : in_feature_spad;
+        }
+
+        int32_t* weight_fill()
+        {
+            return double_buffer ? weight_shadow : weight_spad;
+        }
+
+        // shadow 和 active 對調 (compute 不能在進行中)
+        void swap_spads()
+        {
+            if (!double_buffer)
+                return;
+            swap(in_feature_spad, in_feature_shadow);
+            swap(weight_spad, weight_shadow);
+        }
+
         // compute in one shot (mode=0 use input psum, mode=1 accumulate into psum_spad)
+        // 3 x 4 x uint8 的預設形狀會用 PEKernelDispatch 選到的 SIMD kernel (scalar/SWAR/AVX2/VNNI)
         void compute_full() 
         {
-            for(int i = 0; i < IFMAP_SIZE; i++) 
-            {
-                array<uint8_t, 4> in_feature_byte = get_bytes(in_feature_spad[i]);
-                //in_feature_byte[0] = (in_feature_byte[i] >> 0)  & 0xFF;  // 取最低 8 bit
-                //in_feature_byte[1] = (in_feature_byte[i] >> 8)  & 0xFF;  // 取第 8~15 bit
-                //in_feature_byte[2] = (in_feature_byte[i] >> 16) & 0xFF;  // 取第 16~23 bit
-                //in_feature_byte[3] = (in_feature_byte[i] >> 24) & 0xFF;  // 取最高 8 bit
-
-                for(int j = 0; j <= WEIGHT_SIZE / 4; j++)
-                {
-                    array<uint8_t, 4> weight_byte = get_bytes(weight_spad[i * PSUM_SIZE + j]);
-                    //weight_byte[0] =(weight_byte[i + j * 3] >> 0)  & 0xFF;  // 取最低 8 bit
-                    //weight_byte[1] =(weight_byte[i + j * 3] >> 8)  & 0xFF;  // 取第 8~15 bit
-                    //weight_byte[2] =(weight_byte[i + j * 3] >> 16) & 0xFF;  // 取第 16~23 bit
-                    //weight_byte[3] =(weight_byte[i + j * 3] >> 24) & 0xFF;  // 取最高 8 bit
-
-                    for(int k = 0; k < 4; k++)
-                    {
-                        int prod = in_feature_byte[k] * weight_byte[k];
-                        psum_spad[j] += prod;
-                        cycle++;
-                    }
-                }
-            }
+            pe_mac_fixed<IFMAP_N, WEIGHT_H_N, DP>(in_feature_spad, weight_spad, psum_spad);
+            // 0 的 lane 乘出來就是 0，kernel 照算，gating 只影響 counter 和 cycle
+            int gated = gating == GATE_NONE ? 0 : pe_zero_lanes(in_feature_spad, IFMAP_SIZE, DP) * PSUM_SIZE;
+            macs_gated += gated;
+            macs_executed += MACS - gated;
+            cycle += gating == GATE_SKIP ? MACS - gated : MACS; // one MAC per cycle
         }
         int get_cycle() const 
         {
@@ -133,24 +163,27 @@ class PE
             int j = weight_idx;
             int k = cal_idx;
             
-            array<uint8_t, 4> in_feature_byte = get_bytes(in_feature_spad[i]);
-
-            array<uint8_t, 4> weight_byte = get_bytes(weight_spad[i * PSUM_SIZE + j]);
-
-            psum_spad[weight_idx] += in_feature_byte[k] * weight_byte[k];
+            bool zero = gating != GATE_NONE && pe_lane_zero(in_feature_spad[i], k, DP);
+            if (zero)
+                macs_gated++;
+            else
+            {
+                psum_spad[weight_idx] = pe_mac_lane(psum_spad[weight_idx], in_feature_spad[i], weight_spad[i * PSUM_SIZE + j], k, DP);
+                macs_executed++;
+            }
             //cout<<"cal_idx "<<cal_idx<<endl;
             //cout<<"weight_idx "<<i * PSUM_SIZE + j<<endl;
 
             //cout<<"if_idx "<<if_idx<<endl;
 
             cal_idx++;
-            if (cal_idx == 4) 
+            if (cal_idx == LANES) 
             {
                 cal_idx = 0;
                 weight_idx++;
                 //cout<<"weight_idx "<<weight_idx<<endl;
             }
-            if (weight_idx == 4)
+            if (weight_idx == PSUM_SIZE)
             {
                 weight_idx = 0;
                 if_idx++;
@@ -165,6 +198,13 @@ class PE
                 weight_idx = 0;
             }
 
+            // GATE_SKIP: 0 的 lane 不佔 cycle，直接往下一個 lane 走
+            if (zero && gating == GATE_SKIP)
+            {
+                if (busy)
+                    step_cycle();
+                return;
+            }
             cycle++;
         }
         
@@ -186,7 +226,7 @@ class PE
 
         void add_ipsum(int32_t psum_input, int ip_idx)
         {
-            psum_spad[ip_idx] += psum_input;
+            psum_spad[ip_idx] = pe_psum_add(psum_spad[ip_idx], psum_input, DP);
         }
 
         array<uint8_t, 4> get_bytes(int32_t value) 
@@ -199,3 +239,6 @@ class PE
         }
 
 };
+
+// Eyeriss 預設 PE: 3 個 in_feature, 3 x 4 個 weight, 4 個 psum, 4 x uint8 lane
+using PE = PE_T<3, 4>;
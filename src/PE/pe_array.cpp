@@ -1,89 +1,372 @@
+#pragma once
+
 #include <iostream>
 #include <vector>
 #include <cstdint>
 #include <iomanip>
 #include <cstring>
 #include <array>
+#include <algorithm>
+#include <memory>
 #include "pe.cpp"
+#include "pe_parallel.cpp"
 using namespace std;
 
+class PE_Array;
+
+// 一個 PE 在 SoA plane 裡的 spad (stride = num_pe)
+struct SpadView
+{
+    int32_t* base;
+    int stride;
+
+    int32_t& operator[](int i) const
+    {
+        return base[i * stride];
+    }
+};
+
+// PE_Array::pe[i] 回傳的 thin view，介面和 PE 相同，資料都在 PE_Array 的 plane 裡
+class PEView
+{
+    public:
+        PE_Array* owner;
+        int idx;
+
+        SpadView in_feature_spad;
+        SpadView weight_spad;
+        SpadView psum_spad;
+        SpadView in_feature_fill;  // 載入用 (double_buffer 時是 shadow)
+        SpadView weight_fill;
+
+        int& tag;
+        int& weight_idx;
+        int& if_idx;
+        int& cal_idx;
+        uint8_t& busy;
+        uint8_t& out_valid;
+        int& cycle;
+        long long& macs_executed;
+        long long& macs_gated;
+
+        PEView(PE_Array* owner, int idx);
+
+        void reset();
+        void set_tag(int t) { tag = t; }
+        void dump() const;
+        void compute_full();
+        int get_cycle() const { return cycle; }
+        void start_cycle_compute() { busy = true; }
+        void step_cycle();
+        bool is_busy() const { return busy; }
+        int32_t output_psum(int op_idx) { return psum_spad[op_idx]; }
+        void reset_psum();
+        void add_ipsum(int32_t psum_input, int ip_idx);
+};
+
+// 讓 pe_array.pe[i] 的寫法不變
+struct PEViewTable
+{
+    PE_Array* owner;
+
+    PEView operator[](int i) const;
+};
+
 class PE_Array 
 {
     public:
-        static constexpr int PE_H = 8;
-        static constexpr int PE_V = 6;
-        static constexpr int NUM_PE = PE_H * PE_V;
+        // 原本 Eyeriss 模型的 6 x 8，其他大小用 configure() 設定
+        static constexpr int DEFAULT_PE_H = 8;
+        static constexpr int DEFAULT_PE_V = 6;
+
+        int pe_h;    // PE per row
+        int pe_v;    // number of rows
+        int num_pe;
         int mode;
+        int gating;  // ZeroGating，所有 PE 共用
+        int reduction;  // PsumReduction
+        vector<int> group_start;  // 每組第一個 row，最後一個元素 = 用到的 row 數 (之後的 row 不參與累加)
+
+        // spad 大小與 datapath (從 pe_spec_registry() 選)
+        PESpec spec;
+        int ifmap_size;
+        int weight_h;
+        int weight_size;
+        int psum_size;
+        int lanes;
+        int datapath;  // DatapathMode
+
+        // mode = 累加的組數，必須整除 pe_v，每組 pe_v / mode 個 row 累加
         //1: 6個PE累加，共一組
         //2: 3個PE累加，共兩組
         //3: 2個PE累加，共三組
-        //4: 1個PE累加，共六組
+        //6: 1個PE累加，共六組
+
+        // SoA backing store: plane[row * num_pe + pe]
+        vector<int32_t> ifmap_plane;   // IFMAP_SIZE  x num_pe
+        vector<int32_t> weight_plane;  // WEIGHT_SIZE x num_pe
 
-        PE pe[NUM_PE];
+        // ping-pong spad: double_buffer 時下一個 tile 載到 shadow plane，swap_spads() 後才給 compute 用
+        bool double_buffer = false;
+        vector<int32_t> ifmap_shadow;
+        vector<int32_t> weight_shadow;
+        vector<int32_t> psum_plane;    // PSUM_SIZE   x num_pe
 
-        PE_Array() 
+        // per-PE control state
+        vector<int> tag;
+        vector<int> weight_idx;
+        vector<int> if_idx;
+        vector<int> cal_idx;
+        vector<uint8_t> busy;
+        vector<uint8_t> out_valid;
+        vector<int> cycle;
+        vector<long long> macs_executed;
+        vector<long long> macs_gated;
+
+        PEViewTable pe;
+
+        // 平行 stepping: step_all 依 row band 分給 thread，add_ipsum_all 依 column 分
+        // pool 不跟著複製 (PEThreadPool::run 不能同時被兩個 array 叫)，複製出來的是單 thread，要平行再 set_threads
+        shared_ptr<PEThreadPool> pool;
+
+        PE_Array(int v = DEFAULT_PE_V, int h = DEFAULT_PE_H) 
+            : mode(1), gating(GATE_NONE), reduction(REDUCE_CHAIN), pe{this}
         {
             // constructor
-            reset();
+            set_spec(pe_spec_registry()[0]);
+            configure(v, h);
+        }
+
+        // 選 spad 大小 (registry 裡要有這個組合)，會清掉所有 PE 狀態
+        bool configure_spad(int ifmap, int wh, int dp = DP_U8)
+        {
+            const PESpec* s = pe_spec_find(ifmap, wh, dp);
+            if (s == nullptr)
+            {
+                cerr << "No PE specialization for ifmap " << ifmap << ", weight_h " << wh
+                     << ", datapath " << dp_name(dp) << ". Available:\n";
+                pe_spec_list(cerr);
+                return false;
+            }
+            set_spec(*s);
+            configure(pe_v, pe_h);
+            return true;
+        }
+
+        void set_spec(const PESpec& s)
+        {
+            spec = s;
+            ifmap_size = s.ifmap_size;
+            weight_h = s.weight_h;
+            weight_size = s.weight_size();
+            psum_size = s.psum_size();
+            lanes = s.lanes();
+            datapath = s.datapath;
+        }
+
+        // set array geometry (v rows x h PEs), clears all PE state
+        void configure(int v, int h)
+        {
+            if (v <= 0 || h <= 0)
+            {
+                cerr << "Invalid PE array size " << v << " x " << h << "\n";
+                return;
+            }
+            pe_v = v;
+            pe_h = h;
+            num_pe = v * h;
+            ifmap_plane.assign(ifmap_size * num_pe, 0);
+            weight_plane.assign(weight_size * num_pe, 0);
+            ifmap_shadow.assign(ifmap_size * num_pe, 0);
+            weight_shadow.assign(weight_size * num_pe, 0);
+            psum_plane.assign(psum_size * num_pe, 0);
+            tag.assign(num_pe, 0);
+            weight_idx.assign(num_pe, 0);
+            if_idx.assign(num_pe, 0);
+            cal_idx.assign(num_pe, 0);
+            busy.assign(num_pe, 0);
+            out_valid.assign(num_pe, 0);
+            cycle.assign(num_pe, 0);
+            macs_executed.assign(num_pe, 0);
+            macs_gated.assign(num_pe, 0);
+            mode = 1;
+            group_start = {0, pe_v};
+        }
+
+        // plane 是 value，複製後 view 要指回自己
+        PE_Array(const PE_Array& other)
+            : pe_h(other.pe_h), pe_v(other.pe_v), num_pe(other.num_pe),
+              mode(other.mode), gating(other.gating), reduction(other.reduction), group_start(other.group_start), spec(other.spec), ifmap_size(other.ifmap_size), weight_h(other.weight_h),
+              weight_size(other.weight_size), psum_size(other.psum_size), lanes(other.lanes), datapath(other.datapath), ifmap_plane(other.ifmap_plane), weight_plane(other.weight_plane),
+              double_buffer(other.double_buffer), ifmap_shadow(other.ifmap_shadow), weight_shadow(other.weight_shadow),
+              psum_plane(other.psum_plane), tag(other.tag), weight_idx(other.weight_idx), if_idx(other.if_idx),
+              cal_idx(other.cal_idx), busy(other.busy), out_valid(other.out_valid), cycle(other.cycle),
+              macs_executed(other.macs_executed), macs_gated(other.macs_gated), pe{this}
+        {
+        }
+
+        PE_Array& operator=(const PE_Array& other)
+        {
+            pe_h = other.pe_h;
+            pe_v = other.pe_v;
+            num_pe = other.num_pe;
+            mode = other.mode;
+            gating = other.gating;
+            reduction = other.reduction;
+            group_start = other.group_start;
+            set_spec(other.spec);
+            ifmap_plane = other.ifmap_plane;
+            weight_plane = other.weight_plane;
+            double_buffer = other.double_buffer;
+            ifmap_shadow = other.ifmap_shadow;
+            weight_shadow = other.weight_shadow;
+            psum_plane = other.psum_plane;
+            tag = other.tag;
+            weight_idx = other.weight_idx;
+            if_idx = other.if_idx;
+            cal_idx = other.cal_idx;
+            busy = other.busy;
+            out_valid = other.out_valid;
+            cycle = other.cycle;
+            macs_executed = other.macs_executed;
+            macs_gated = other.macs_gated;
+            pe.owner = this;
+            return *this;  // pool 維持自己的
         }
 
         // reset all PEs
         void reset() 
         {
-            for (int i = 0; i < NUM_PE; i++) 
+            fill(ifmap_plane.begin(), ifmap_plane.end(), 0);
+            fill(weight_plane.begin(), weight_plane.end(), 0);
+            fill(ifmap_shadow.begin(), ifmap_shadow.end(), 0);
+            fill(weight_shadow.begin(), weight_shadow.end(), 0);
+            fill(psum_plane.begin(), psum_plane.end(), 0);
+            fill(tag.begin(), tag.end(), 0);
+            fill(weight_idx.begin(), weight_idx.end(), 0);
+            fill(if_idx.begin(), if_idx.end(), 0);
+            fill(cal_idx.begin(), cal_idx.end(), 0);
+            fill(busy.begin(), busy.end(), 0);
+            fill(out_valid.begin(), out_valid.end(), 0);
+            fill(cycle.begin(), cycle.end(), 0);
+            fill(macs_executed.begin(), macs_executed.end(), 0);
+            fill(macs_gated.begin(), macs_gated.end(), 0);
+        }
+        // legal accumulation groupings: mode 整除 pe_v
+        bool mode_legal(int m) const
+        {
+            return m > 0 && m <= pe_v && pe_v % m == 0;
+        }
+
+        vector<int> legal_modes() const
+        {
+            vector<int> modes;
+            for (int m = 1; m <= pe_v; m++)
+                if (mode_legal(m))
+                    modes.push_back(m);
+            return modes;
+        }
+
+        // 任意 grouping: groups 個組，每組 rows 個 row，不用整除 pe_v
+        bool grouping_legal(int rows, int groups) const
+        {
+            return rows > 0 && groups > 0 && rows * groups <= pe_v;
+        }
+
+        int group_rows(int g = 0) const
+        {
+            return group_start[g + 1] - group_start[g];
+        }
+
+        int used_rows() const
+        {
+            return group_start.back();
+        }
+
+        // 每組第一個 row 接收 GLB 讀回來的 psum，最後一個 row 輸出累加結果
+        int group_first_pe(int g) const
+        {
+            return group_start[g] * pe_h;
+        }
+
+        int group_last_pe(int g) const
+        {
+            return (group_start[g + 1] - 1) * pe_h;
+        }
+
+        // 由上往下連續分組，rows[g] = 第 g 組的 row 數，總和可以小於 pe_v (剩下的 row 閒置)
+        bool set_groups(const vector<int>& rows)
+        {
+            int total = 0;
+            for (int r : rows)
             {
-                pe[i].reset();
+                if (r <= 0)
+                {
+                    cerr << "Invalid group size " << r << "\n";
+                    return false;
+                }
+                total += r;
             }
+            if (rows.empty() || total > pe_v)
+            {
+                cerr << "Grouping uses " << total << " rows, PE array has " << pe_v << "\n";
+                return false;
+            }
+            mode = rows.size();
+            group_start.assign(1, 0);
+            for (int r : rows)
+                group_start.push_back(group_start.back() + r);
+
+            // 同一組同一個 column 的 PE 有相同 tag，閒置的 row 各自一個 (負的) tag
+            for (int i = 0; i < num_pe; i++)
+                tag[i] = -1 - i;
+            for (int g = 0; g < mode; g++)
+                for (int row = group_start[g]; row < group_start[g + 1]; row++)
+                    for (int c = 0; c < pe_h; c++)
+                        tag[row * pe_h + c] = g * pe_h + c;
+            return true;
         }
+
         //set tag for a specific PE
+        // 同一組 (連續 pe_v / mode 個 row) 同一個 column 的 PE 有相同 tag
         void set_tag() 
         {
             //pe[pe_index].set_tag(t);
-            switch (mode)
+            if (!mode_legal(mode))
             {
-                case 1:
-                {   //1: 6個PE累加，共一組
-                    for(int i = 0; i < PE_Array::NUM_PE; i++)
-                        pe[i].tag = i % 8; // set same tag for PE[0]~PE[7]
-                    break;
-                }
-                case 2:
-                {   //2: 3個PE累加，共兩組
-                    for(int i = 0; i < PE_Array::NUM_PE; i++)
-                    {
-                        if(i < 24)
-                            pe[i].tag = i % 8;
-                        else
-                            pe[i].tag = i % 8 + 8;
-                    }
-                    break;
-                }
-                case 3:
-                {   //3: 2個PE累加，共三組
-                    for(int i = 0; i < PE_Array::NUM_PE; i++)
-                    {
-                        if(i < 16)
-                            pe[i].tag = i % 8;
-                        else if(i >= 16 && i < 32)
-                            pe[i].tag = i % 8 + 8;
-                        else
-                            pe[i].tag = i % 8 + 16;
-                    }
-                    break;
-                }
-                case 6:
-                {   //4: 1個PE累加，共六組
-                    for(int i = 0; i < PE_Array::NUM_PE; i++)
-                        pe[i].tag = i;
-                    break;
-                }
+                cerr << "Invalid mode " << mode << " for " << pe_v << " rows\n";
+                return;
             }
+            set_groups(vector<int>(mode, pe_v / mode));
+        }
+
+        // ===== psum reduction 的 cycle model =====
+        // 每個 stage 把 psum_size 個 word 平行送到下一個 PE 相加 (PSUM_HOP_LAT)，最後 1 cycle 寫到 output
+        static constexpr int PSUM_HOP_LAT = 1;
+
+        int reduction_stages(int rows) const
+        {
+            if (reduction == REDUCE_CHAIN)
+                return rows - 1;
+            int stages = 0;
+            while ((1 << stages) < rows)
+                stages++;
+            return stages;
+        }
+
+        // 所有組同時做，latency 由最大的組決定
+        int reduction_cycles() const
+        {
+            int stages = 0;
+            for (int g = 0; g < mode; g++)
+                stages = max(stages, reduction_stages(group_rows(g)));
+            return stages * PSUM_HOP_LAT + 1;
         }
 
         // dump all PEs
         void dump_all() const 
         {
-            for (int i = 0; i < NUM_PE; i++) 
+            for (int i = 0; i < num_pe; i++) 
             {
                 cout << "PE[" << i << "] state:\n";
                 pe[i].dump();
@@ -102,39 +385,41 @@ class PE_Array
             cout << "---------------------\n";
         }
         //set input feature for a specific PE
-        void set_input_feature(int pe_index, const array<int32_t, PE::IFMAP_SIZE>& input_feature) 
+        template <size_t N>
+        void set_input_feature(int pe_index, const array<int32_t, N>& input_feature) 
         {
             if (!check_valid_pe(pe_index)) 
             {
                 cerr << "Invalid PE index\n";
                 return;
             }
-            if (input_feature.size() != PE::IFMAP_SIZE) 
+            if (input_feature.size() != size_t(ifmap_size)) 
             {
                 cerr << "Input feature size mismatch\n";
                 return;
             }
-            for (int i = 0; i < PE::IFMAP_SIZE; i++) 
+            for (int i = 0; i < ifmap_size; i++) 
             {
-                pe[pe_index].in_feature_spad[i] = input_feature[i];
+                ifmap_fill()[i * num_pe + pe_index] = input_feature[i];
             }
         }
         //set weights for a specific PE
-        void set_weights(int pe_index, const array<int32_t, PE::WEIGHT_SIZE>& weights) 
+        template <size_t N>
+        void set_weights(int pe_index, const array<int32_t, N>& weights) 
         {
             if (!check_valid_pe(pe_index)) 
             {
                 cerr << "Invalid PE index\n";
                 return;
             }
-            if (weights.size() != PE::WEIGHT_SIZE) 
+            if (weights.size() != size_t(weight_size)) 
             {
                 cerr << "Weights size mismatch\n";
                 return;
             }
-            for (int i = 0; i < PE::WEIGHT_SIZE; i++) 
+            for (int i = 0; i < weight_size; i++) 
             {
-                pe[pe_index].weight_spad[i] = weights[i];
+                weight_fill()[i * num_pe + pe_index] = weights[i];
             }
         }
 
@@ -144,54 +429,215 @@ class PE_Array
             pe[pe_index].compute_full();
         }
 
-        void compute_full_all() 
+        // 載入的目標 plane
+        vector<int32_t>& ifmap_fill()
+        {
+            return double_buffer ? ifmap_shadow : ifmap_plane;
+        }
+
+        vector<int32_t>& weight_fill()
+        {
+            return double_buffer ? weight_shadow : weight_plane;
+        }
+
+        // 整個 array 的 shadow / active 對調 (vector swap 只換指標)，compute 不能在進行中
+        void swap_spads()
+        {
+            if (!double_buffer)
+                return;
+            ifmap_plane.swap(ifmap_shadow);
+            weight_plane.swap(weight_shadow);
+        }
+
+        // 整個 array 一次 sweep，kernel 在 PE 維度上 vectorize
+        // 回傳這次 compute 的 latency: array 同步，等最慢的 PE (GATE_SKIP 時是 executed MAC 最多的)
+        // bf16 開 gating 時 0 的 lane 不能加進 fp32 psum (0 x inf = NaN)，和 step_pe 一樣逐 lane 做
+        int compute_full_all() 
+        {
+            if (gating != GATE_NONE && dp_is_float(datapath))
+            {
+                for (int p = 0; p < num_pe; p++)
+                    mac_ungated_lanes(p);
+            }
+            else
+                spec.mac_array(ifmap_plane.data(), weight_plane.data(), psum_plane.data(), num_pe);
+            if (gating == GATE_NONE)
+            {
+                for (int i = 0; i < num_pe; i++) 
+                {
+                    cycle[i] += spec.macs();
+                    macs_executed[i] += spec.macs();
+                }
+                return spec.macs();
+            }
+            int latency = 0;
+            for (int i = 0; i < num_pe; i++) 
+            {
+                int gated = pe_zero_lanes(ifmap_plane.data() + i, ifmap_size, datapath, num_pe) * psum_size;
+                int pe_cycles = gating == GATE_SKIP ? spec.macs() - gated : spec.macs();
+                macs_gated[i] += gated;
+                macs_executed[i] += spec.macs() - gated;
+                cycle[i] += pe_cycles;
+                latency = max(latency, pe_cycles);
+            }
+            return latency;
+        }
+
+        // 一個 PE 從頭做到尾沒被 gate 掉的 lane (順序和 step_pe 一樣)，不動 control state / counter
+        void mac_ungated_lanes(int p)
+        {
+            for (int pos = 0; pos < spec.macs(); pos++)
+            {
+                if (lane_gated(p, pos))
+                    continue;
+                int i = pos / (psum_size * lanes);
+                int j = (pos / lanes) % psum_size;
+                int32_t& ps = psum_plane[j * num_pe + p];
+                ps = pe_mac_lane(ps, ifmap_plane[i * num_pe + p], weight_plane[(i * psum_size + j) * num_pe + p], pos % lanes, datapath);
+            }
+        }
+
+        long long total_macs_executed() const
         {
-            for (int i = 0; i < NUM_PE; i++) 
-                pe[i].compute_full();
+            long long sum = 0;
+            for (long long m : macs_executed)
+                sum += m;
+            return sum;
+        }
+
+        long long total_macs_gated() const
+        {
+            long long sum = 0;
+            for (long long m : macs_gated)
+                sum += m;
+            return sum;
+        }
+
+        // checkpoint (src/checkpoint.cpp): spad / psum plane 和每個 PE 的 control state，大小由 configure() 決定
+        template <typename Archive>
+        void checkpoint(Archive& ar)
+        {
+            ar.io(mode);
+            ar.io(group_start);
+            ar.io(ifmap_plane);
+            ar.io(weight_plane);
+            ar.io(ifmap_shadow);
+            ar.io(weight_shadow);
+            ar.io(psum_plane);
+            ar.io(tag);
+            ar.io(weight_idx);
+            ar.io(if_idx);
+            ar.io(cal_idx);
+            ar.io(busy);
+            ar.io(out_valid);
+            ar.io(cycle);
+            ar.io(macs_executed);
+            ar.io(macs_gated);
+        }
+
+        // 另一個 PE_Array (平行模擬的 worker) 的 MAC / cycle counter 加進來
+        void merge_counters(const PE_Array& other)
+        {
+            for (int i = 0; i < num_pe; i++)
+            {
+                macs_executed[i] += other.macs_executed[i];
+                macs_gated[i] += other.macs_gated[i];
+                cycle[i] += other.cycle[i];
+            }
         }
 
         void out_valid_all() 
         {
-            for (int i = 0; i < NUM_PE; i++) 
-                pe[i].out_valid = true;
+            for (int i = 0; i < num_pe; i++) 
+                out_valid[i] = true;
         }
 
         void add_ipsum(int idx, int ipsum)
         {
-            for(int i = 0; i < PE::PSUM_SIZE; i++)
-                pe[idx].add_ipsum(ipsum, i);
+            for(int i = 0; i < psum_size; i++)
+                psum_plane[i * num_pe + idx] = pe_psum_add(psum_plane[i * num_pe + idx], ipsum, datapath);
         }
 
+        // 每組把 psum 累加到最後一個 row (chain 或 tree)，每個 column 是獨立的，
+        // 所以平行時一個 thread 負責幾個完整的 column，row 之間的順序不變
         void add_ipsum_all() 
         {
-            for (int i = 0; i < NUM_PE; i++) 
+            if (pool)
             {
-                if(i > 7)
+                pool->run([&](int t)
                 {
-                    if(pe[i].tag == pe[i-8].tag)
-                    {
-                        //cout << "PE[" << i << "] accumulates from PE[" << i-8 << "]\n";
-                        for(int j = 0; j < PE::PSUM_SIZE; j++)
-                        {
-                            if(pe[i-8].out_valid)
-                                pe[i].add_ipsum(pe[i-8].output_psum(j), j);
-                            //cout << pe[i-8].output_psum(j) << " added to PE[" << i << "] PSUM[" << j << "]\n";
-                            //cout << "After accumulation, PE[" << i << "] PSUM[" << j << "] = " << pe[i].psum_spad[j] << "\n";
-                        }
-                        pe[i-8].out_valid = false; // reset out_valid after accumulation
-                        pe[i-8].reset_psum(); // reset psum_spad after accumulation
-                    }
+                    pair<int, int> cols = pool->band(t, pe_h);
+                    add_ipsum_columns(cols.first, cols.second);
+                });
+                return;
+            }
+            add_ipsum_columns(0, pe_h);
+        }
+
+        void add_ipsum_columns(int col_begin, int col_end)
+        {
+            for (int g = 0; g < mode; g++)
+            {
+                int r0 = group_start[g];
+                int n = group_rows(g);
+                if (reduction == REDUCE_CHAIN)
+                {
+                    for (int k = 1; k < n; k++)
+                        for (int c = col_begin; c < col_end; c++)
+                            accumulate_psum((r0 + k) * pe_h + c, (r0 + k - 1) * pe_h + c);
+                }
+                else
+                {
+                    // stage d: row k 收 row k - d (k 從最後一個 row 往上每 2d 個一次)
+                    for (int d = 1; d < n; d *= 2)
+                        for (int k = n - 1; k - d >= 0; k -= 2 * d)
+                            for (int c = col_begin; c < col_end; c++)
+                                accumulate_psum((r0 + k) * pe_h + c, (r0 + k - d) * pe_h + c);
                 }
             }
         }
 
+        void accumulate_psum(int dst, int src)
+        {
+            //cout << "PE[" << dst << "] accumulates from PE[" << src << "]\n";
+            for(int j = 0; j < psum_size; j++)
+            {
+                if(out_valid[src])
+                    psum_plane[j * num_pe + dst] = pe_psum_add(psum_plane[j * num_pe + dst], psum_plane[j * num_pe + src], datapath);
+            }
+            out_valid[src] = false; // reset out_valid after accumulation
+            reset_psum(src); // reset psum_spad after accumulation
+        }
+
+        // 0 = hardware_concurrency，1 = 單 thread (不開 pool)
+        void set_threads(int n)
+        {
+            if (n <= 0)
+                n = max(1u, thread::hardware_concurrency());
+            if (n == 1)
+                pool.reset();
+            else if (!pool || pool->size() != n)
+                pool = make_shared<PEThreadPool>(n);
+        }
+
+        int threads() const
+        {
+            return pool ? pool->size() : 1;
+        }
+
+        void reset_psum(int pe_index)
+        {
+            for (int j = 0; j < psum_size; j++)
+                psum_plane[j * num_pe + pe_index] = 0;
+        }
+
 
         // check if any PE is busy
         bool is_any_busy() const 
         {
-            for (int i = 0; i < NUM_PE; i++) 
+            for (int i = 0; i < num_pe; i++) 
             {
-                if (pe[i].is_busy()) return true;
+                if (busy[i]) return true;
             }
             return false;
         }
@@ -199,23 +645,353 @@ class PE_Array
         // step all PEs by one cycle
         void start_step()
         {
-            for(int i = 0; i < NUM_PE; i++)
-                pe[i].start_cycle_compute();
+            for(int i = 0; i < num_pe; i++)
+                busy[i] = true;
         }
         void step_all() 
         {
-            for (int i = 0; i < NUM_PE; i++) 
+            if (pool)
+            {
+                pool->run([&](int t) { step_band(t); });
+                return;
+            }
+            for (int i = 0; i < num_pe; i++) 
             {
                 //cout << "PE[" << i <<"]: ";
-                pe[i].step_cycle();
+                step_pe(i);
                 //cout <<endl;
                 
             }
         }
 
+        // thread t 負責的 row band，PE 之間的 state 沒有共用，step 時不需要 lock
+        void step_band(int t)
+        {
+            pair<int, int> rows = pool->band(t, pe_v);
+            for (int p = rows.first * pe_h; p < rows.second * pe_h; p++)
+                step_pe(p);
+        }
+
+        // 等同 while (is_any_busy()) step_all();，回傳 step 的次數
+        // 平行時 worker 一直留在同一個 job 裡，每個 cycle 兩個 barrier:
+        //   phase 1: 各 band 回報還有沒有 busy PE，barrier 後大家讀到同一個結果
+        //   phase 2: barrier 確保都讀完了才 step 自己的 band (下一輪才會改寫回報)
+        long long step_until_idle()
+        {
+            long long steps = 0;
+            if (!pool)
+            {
+                while (is_any_busy())
+                {
+                    step_all();
+                    steps++;
+                }
+                return steps;
+            }
+            int n = pool->size();
+            vector<uint8_t> band_busy(n, 0);
+            PEBarrier barrier(n);
+            pool->run([&](int t)
+            {
+                pair<int, int> rows = pool->band(t, pe_v);
+                while (true)
+                {
+                    uint8_t local = 0;
+                    for (int p = rows.first * pe_h; p < rows.second * pe_h; p++)
+                        local |= busy[p];
+                    band_busy[t] = local;
+                    barrier.arrive_and_wait();
+                    bool any = any_of(band_busy.begin(), band_busy.end(), [](uint8_t b) { return b != 0; });
+                    if (t == 0 && any)
+                        steps++;
+                    barrier.arrive_and_wait();
+                    if (!any)
+                        break;
+                    step_band(t);
+                }
+            });
+            return steps;
+        }
+
+        // do one MAC per cycle (same state machine as PE::step_cycle)
+        void step_pe(int p)
+        {
+            if (!busy[p]) return;
+
+            int i = if_idx[p];
+            int j = weight_idx[p];
+            int k = cal_idx[p];
+
+            int32_t a = ifmap_plane[i * num_pe + p];
+            bool zero = gating != GATE_NONE && pe_lane_zero(a, k, datapath);
+            if (zero)
+                macs_gated[p]++;
+            else
+            {
+                int32_t& ps = psum_plane[j * num_pe + p];
+                ps = pe_mac_lane(ps, a, weight_plane[(i * psum_size + j) * num_pe + p], k, datapath);
+                macs_executed[p]++;
+            }
+
+            cal_idx[p]++;
+            if (cal_idx[p] == lanes) 
+            {
+                cal_idx[p] = 0;
+                weight_idx[p]++;
+            }
+            if (weight_idx[p] == psum_size)
+            {
+                weight_idx[p] = 0;
+                if_idx[p]++;
+            }
+            if (if_idx[p] == ifmap_size) 
+            {
+                busy[p] = false; // done
+                out_valid[p] = true;
+                if_idx[p] = 0;
+                cal_idx[p] = 0;
+                weight_idx[p] = 0;
+            }
+
+            // GATE_SKIP: 0 的 lane 不佔 cycle，直接往下一個 lane 走
+            if (zero && gating == GATE_SKIP)
+            {
+                if (busy[p])
+                    step_pe(p);
+                return;
+            }
+            cycle[p]++;
+        }
+
+        // ===== event-skipping: 不用每個 cycle 呼叫 step_all() =====
+        // busy PE 的 state path 是固定的 (if_idx -> weight_idx -> cal_idx)，
+        // 所以可以直接算出還要幾個 cycle 做完，一次把 MAC 做完再跳到下一個 event
+        // 結果 (cycle / psum / out_valid / counter) 和一直 step_all() 到 idle 相同
+
+        // 目前做到第幾個 lane MAC (0 ~ spec.macs())
+        int pe_position(int p) const
+        {
+            return (if_idx[p] * psum_size + weight_idx[p]) * lanes + cal_idx[p];
+        }
+
+        bool lane_gated(int p, int pos) const
+        {
+            int i = pos / (psum_size * lanes);
+            return gating != GATE_NONE && pe_lane_zero(ifmap_plane[i * num_pe + p], pos % lanes, datapath);
+        }
+
+        // 還要幾個 cycle 才做完 (GATE_SKIP 時 0 的 lane 不算)
+        int remaining_cycles(int p) const
+        {
+            if (!busy[p])
+                return 0;
+            int pos = pe_position(p);
+            if (gating != GATE_SKIP)
+                return spec.macs() - pos;
+            int n = 0;
+            for (; pos < spec.macs(); pos++)
+                n += !lane_gated(p, pos);
+            return n;
+        }
+
+        // 最近一個 busy PE 做完還要幾個 cycle，沒有 busy PE 時回傳 -1
+        int next_event() const
+        {
+            int dt = -1;
+            for (int p = 0; p < num_pe; p++)
+            {
+                if (!busy[p])
+                    continue;
+                int r = remaining_cycles(p);
+                if (dt < 0 || r < dt)
+                    dt = r;
+            }
+            return dt;
+        }
+
+        // 從目前位置做 lane MAC，最多用掉 max_cycles 個 cycle，回傳用掉的 cycle
+        int apply_lanes(int p, int max_cycles)
+        {
+            int pos = pe_position(p);
+            int used = 0;
+            while (pos < spec.macs() && used < max_cycles)
+            {
+                int i = pos / (psum_size * lanes);
+                int j = (pos / lanes) % psum_size;
+                int k = pos % lanes;
+                if (lane_gated(p, pos))
+                {
+                    macs_gated[p]++;
+                    used += gating == GATE_CLOCK;
+                }
+                else
+                {
+                    int32_t& ps = psum_plane[j * num_pe + p];
+                    ps = pe_mac_lane(ps, ifmap_plane[i * num_pe + p], weight_plane[(i * psum_size + j) * num_pe + p], k, datapath);
+                    macs_executed[p]++;
+                    used++;
+                }
+                pos++;
+            }
+            // GATE_SKIP: 接下來 0 的 lane 不花 cycle，一起跳過 (後面全是 0 時就做完了)
+            while (pos < spec.macs() && gating == GATE_SKIP && lane_gated(p, pos))
+            {
+                macs_gated[p]++;
+                pos++;
+            }
+            if (pos == spec.macs())
+            {
+                busy[p] = false; // done
+                out_valid[p] = true;
+                pos = 0;
+            }
+            if_idx[p] = pos / (psum_size * lanes);
+            weight_idx[p] = (pos / lanes) % psum_size;
+            cal_idx[p] = pos % lanes;
+            cycle[p] += used;
+            return used;
+        }
+
+        // 所有 busy PE 往前推 dt 個 cycle
+        void advance(int dt)
+        {
+            // 全部 PE 都剛開始而且這次會做完: 直接用 compute_full_all 的 array kernel
+            bool bulk = true;
+            for (int p = 0; p < num_pe && bulk; p++)
+                bulk = busy[p] && pe_position(p) == 0 && dt >= remaining_cycles(p);
+            if (bulk)
+            {
+                compute_full_all();
+                for (int p = 0; p < num_pe; p++)
+                {
+                    busy[p] = false;
+                    out_valid[p] = true;
+                }
+                return;
+            }
+            for (int p = 0; p < num_pe; p++)
+            {
+                if (busy[p])
+                    apply_lanes(p, dt);
+            }
+        }
+
+        // 跳 event 跑到所有 PE 都 idle，回傳經過的 cycle 數
+        long long run_until_idle()
+        {
+            long long elapsed = 0;
+            for (int dt = next_event(); dt >= 0; dt = next_event())
+            {
+                advance(dt);
+                elapsed += dt;
+            }
+            return elapsed;
+        }
+
+        PEView view(int pe_index)
+        {
+            return PEView(this, pe_index);
+        }
+
         bool check_valid_pe(int pe_index) const 
         {
-            return (pe_index >= 0 && pe_index < NUM_PE);
+            return (pe_index >= 0 && pe_index < num_pe);
         }
 
-};
\ No newline at end of file
+};
+
+inline PEView::PEView(PE_Array* owner, int idx)
+    : owner(owner), idx(idx),
+      in_feature_spad{owner->ifmap_plane.data() + idx, owner->num_pe},
+      weight_spad{owner->weight_plane.data() + idx, owner->num_pe},
+      psum_spad{owner->psum_plane.data() + idx, owner->num_pe},
+      in_feature_fill{owner->ifmap_fill().data() + idx, owner->num_pe},
+      weight_fill{owner->weight_fill().data() + idx, owner->num_pe},
+      tag(owner->tag[idx]), weight_idx(owner->weight_idx[idx]), if_idx(owner->if_idx[idx]),
+      cal_idx(owner->cal_idx[idx]), busy(owner->busy[idx]), out_valid(owner->out_valid[idx]),
+      cycle(owner->cycle[idx]), macs_executed(owner->macs_executed[idx]), macs_gated(owner->macs_gated[idx])
+{
+}
+
+inline PEView PEViewTable::operator[](int i) const
+{
+    return owner->view(i);
+}
+
+inline void PEView::reset()
+{
+    for (int i = 0; i < owner->ifmap_size; i++)
+        in_feature_spad[i] = 0;
+    for (int i = 0; i < owner->weight_size; i++)
+        weight_spad[i] = 0;
+    reset_psum();
+    weight_idx = 0;
+    if_idx = 0;
+    cal_idx = 0;
+    busy = false;
+    out_valid = false;
+    tag = 0;
+    cycle = 0;
+    macs_executed = 0;
+    macs_gated = 0;
+}
+
+inline void PEView::reset_psum()
+{
+    owner->reset_psum(idx);
+}
+
+inline void PEView::step_cycle()
+{
+    owner->step_pe(idx);
+}
+
+// 單一 PE 的 compute：gather 到連續 buffer 再用 spec 的 kernel
+inline void PEView::compute_full()
+{
+    const PE_Array& a = *owner;
+    int32_t ifmap[PE_SPEC_MAX_IFMAP], weight[PE_SPEC_MAX_IFMAP * PE_SPEC_MAX_WEIGHT_H], psum[PE_SPEC_MAX_WEIGHT_H];
+    for (int i = 0; i < a.ifmap_size; i++)
+        ifmap[i] = in_feature_spad[i];
+    for (int i = 0; i < a.weight_size; i++)
+        weight[i] = weight_spad[i];
+    for (int i = 0; i < a.psum_size; i++)
+        psum[i] = psum_spad[i];
+    a.spec.mac(ifmap, weight, psum);
+    for (int i = 0; i < a.psum_size; i++)
+        psum_spad[i] = psum[i];
+    int gated = a.gating == GATE_NONE ? 0 : pe_zero_lanes(ifmap, a.ifmap_size, a.datapath) * a.psum_size;
+    macs_gated += gated;
+    macs_executed += a.spec.macs() - gated;
+    cycle += a.gating == GATE_SKIP ? a.spec.macs() - gated : a.spec.macs();
+}
+
+inline void PEView::add_ipsum(int32_t psum_input, int ip_idx)
+{
+    psum_spad[ip_idx] = pe_psum_add(psum_spad[ip_idx], psum_input, owner->datapath);
+}
+
+inline void PEView::dump() const
+{
+    cout << "IFMAP: "<< "\n";
+    int dp = owner->datapath;
+    for (int i = 0; i < owner->ifmap_size; i++) 
+    {
+        for(int j = 0; j < owner->lanes; j++)
+            cout << setw(10) << pe_lane_int(in_feature_spad[i], j, dp);
+        cout << "\n";
+    }
+    cout << "\nFILTER:"<< "\n";
+    for (int i = 0; i < owner->weight_size; i++) 
+    {
+        for(int j = 0; j < owner->lanes; j++)
+            cout << setw(10) << pe_lane_int(weight_spad[i], j, dp);
+        cout << "\n";
+    }
+    cout << "\nPSUM:  "<< "\n";
+    for (int i = 0; i < owner->psum_size; i++) 
+    {
+        cout << setw(10) << psum_spad[i];
+    }
+    cout << "\n";
+}
@@ -0,0 +1,438 @@
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PE_KERNEL_X86 1
+#endif
+
+using namespace std;
+
+// packed 4 x uint8 MAC kernels for PE::compute_full
+// psum[j] += sum_i dot4(ifmap[i], weight[i * 4 + j]),  i = 0 ~ rows-1, j = 0 ~ 3
+// 所有 kernel 都以 mod 2^32 累加，和原本 scalar 路徑 bit-exact
+typedef void (*pe_mac_fn)(const int32_t* ifmap, const int32_t* weight, int32_t* psum, int rows);
+
+enum PEKernel
+{
+    PE_KERNEL_SCALAR = 0,
+    PE_KERNEL_SWAR,
+    PE_KERNEL_AVX2,
+    PE_KERNEL_AVX512_VNNI,
+    PE_KERNEL_COUNT
+};
+
+inline const char* pe_kernel_name(PEKernel k)
+{
+    switch (k)
+    {
+        case PE_KERNEL_SCALAR:      return "scalar";
+        case PE_KERNEL_SWAR:        return "swar";
+        case PE_KERNEL_AVX2:        return "avx2";
+        case PE_KERNEL_AVX512_VNNI: return "avx512_vnni";
+        default:                    return "unknown";
+    }
+}
+
+// one lane of a packed word (lane 0 = lowest byte)
+inline uint32_t pe_lane_u8(int32_t value, int lane)
+{
+    return (uint32_t(value) >> (8 * lane)) & 0xFF;
+}
+
+inline uint32_t pe_dot4_u8(int32_t a, int32_t b)
+{
+    return pe_lane_u8(a, 0) * pe_lane_u8(b, 0)
+         + pe_lane_u8(a, 1) * pe_lane_u8(b, 1)
+         + pe_lane_u8(a, 2) * pe_lane_u8(b, 2)
+         + pe_lane_u8(a, 3) * pe_lane_u8(b, 3);
+}
+
+static void pe_mac_scalar(const int32_t* ifmap, const int32_t* weight, int32_t* psum, int rows)
+{
+    for (int i = 0; i < rows; i++)
+        for (int j = 0; j < 4; j++)
+            psum[j] = int32_t(uint32_t(psum[j]) + pe_dot4_u8(ifmap[i], weight[i * 4 + j]));
+}
+
+// SWAR: 把 4 個 weight 同一個 lane 的 byte 排成 4 x 16-bit field，一次乘法做 4 個 MAC
+// u8 * u8 <= 65025 不會跨 field 進位，之後再拆成 2 x 32-bit field 累加
+static void pe_mac_swar(const int32_t* ifmap, const int32_t* weight, int32_t* psum, int rows)
+{
+    const uint64_t LANE_MASK = 0x000000FF000000FFull;
+    const uint64_t HALF_MASK = 0x0000FFFF0000FFFFull;
+    uint64_t acc_02 = 0; // psum[0] @ bit 0, psum[2] @ bit 32
+    uint64_t acc_13 = 0; // psum[1] @ bit 0, psum[3] @ bit 32
+
+    for (int i = 0; i < rows; i++)
+    {
+        const int32_t* w = weight + i * 4;
+        uint64_t w02 = uint64_t(uint32_t(w[0])) | (uint64_t(uint32_t(w[2])) << 32);
+        uint64_t w13 = uint64_t(uint32_t(w[1])) | (uint64_t(uint32_t(w[3])) << 32);
+        uint32_t a = uint32_t(ifmap[i]);
+
+        for (int k = 0; k < 4; k++)
+        {
+            uint64_t lanes = ((w02 >> (8 * k)) & LANE_MASK) | (((w13 >> (8 * k)) & LANE_MASK) << 16);
+            uint64_t prod = uint64_t((a >> (8 * k)) & 0xFF) * lanes;
+            acc_02 += prod & HALF_MASK;
+            acc_13 += (prod >> 16) & HALF_MASK;
+        }
+
+        // 每個 row 每個 field 最多加 4 * 65025，約 16000 個 row 會溢位到隔壁 field，提早 flush 保持 bit-exact
+        if ((i & 0xFFF) == 0xFFF)
+        {
+            psum[0] = int32_t(uint32_t(psum[0]) + uint32_t(acc_02));
+            psum[1] = int32_t(uint32_t(psum[1]) + uint32_t(acc_13));
+            psum[2] = int32_t(uint32_t(psum[2]) + uint32_t(acc_02 >> 32));
+            psum[3] = int32_t(uint32_t(psum[3]) + uint32_t(acc_13 >> 32));
+            acc_02 = acc_13 = 0;
+        }
+    }
+    psum[0] = int32_t(uint32_t(psum[0]) + uint32_t(acc_02));
+    psum[1] = int32_t(uint32_t(psum[1]) + uint32_t(acc_13));
+    psum[2] = int32_t(uint32_t(psum[2]) + uint32_t(acc_02 >> 32));
+    psum[3] = int32_t(uint32_t(psum[3]) + uint32_t(acc_13 >> 32));
+}
+
+#ifdef PE_KERNEL_X86
+// AVX2: 一個 row 的 4 個 weight (16 bytes) 展開成 16 x int16，madd 之後每兩個 int32 是一個 psum
+__attribute__((target("avx2")))
+static void pe_mac_avx2(const int32_t* ifmap, const int32_t* weight, int32_t* psum, int rows)
+{
+    __m256i acc = _mm256_setzero_si256();
+    for (int i = 0; i < rows; i++)
+    {
+        __m256i w = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(weight + i * 4)));
+        __m256i a = _mm256_cvtepu8_epi16(_mm_set1_epi32(ifmap[i]));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(w, a));
+    }
+    __m128i sum = _mm_hadd_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    __m128i p = _mm_loadu_si128((const __m128i*)psum);
+    _mm_storeu_si128((__m128i*)psum, _mm_add_epi32(p, sum));
+}
+
+// VNNI 的 dpbusd 是 u8 x s8，weight 先 xor 0x80 變成 (w - 128)，再補回 128 * sum(a)
+__attribute__((target("avx512vnni,avx512vl")))
+static void pe_mac_avx512_vnni(const int32_t* ifmap, const int32_t* weight, int32_t* psum, int rows)
+{
+    const __m128i bias = _mm_set1_epi8(char(0x80));
+    const __m128i ones = _mm_set1_epi8(1);
+    __m128i acc = _mm_setzero_si128();
+    __m128i asum = _mm_setzero_si128();
+    for (int i = 0; i < rows; i++)
+    {
+        __m128i a = _mm_set1_epi32(ifmap[i]);
+        __m128i w = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(weight + i * 4)), bias);
+        acc = _mm_dpbusd_epi32(acc, a, w);
+        asum = _mm_dpbusd_epi32(asum, a, ones);
+    }
+    __m128i sum = _mm_add_epi32(acc, _mm_slli_epi32(asum, 7));
+    __m128i p = _mm_loadu_si128((const __m128i*)psum);
+    _mm_storeu_si128((__m128i*)psum, _mm_add_epi32(p, sum));
+}
+#endif
+
+// SoA 版本：一次 sweep 整個 PE array，plane layout 為 [row][pe]
+// ifmap[l * num_pe + p], weight[(l * 4 + j) * num_pe + p], psum[j * num_pe + p]
+typedef void (*pe_mac_array_fn)(const int32_t* ifmap, const int32_t* weight, int32_t* psum, int rows, int num_pe);
+
+static void pe_mac_array_scalar(const int32_t* ifmap, const int32_t* weight, int32_t* psum, int rows, int num_pe)
+{
+    for (int l = 0; l < rows; l++)
+    {
+        const int32_t* a = ifmap + l * num_pe;
+        for (int j = 0; j < 4; j++)
+        {
+            const int32_t* w = weight + (l * 4 + j) * num_pe;
+            int32_t* ps = psum + j * num_pe;
+            for (int p = 0; p < num_pe; p++)
+                ps[p] = int32_t(uint32_t(ps[p]) + pe_dot4_u8(a[p], w[p]));
+        }
+    }
+}
+
+#ifdef PE_KERNEL_X86
+// 8 個 PE 一組，even/odd byte 拆成 16-bit 後 madd，兩個 madd 相加就是每個 PE 的 dot4
+__attribute__((target("avx2")))
+static void pe_mac_array_avx2(const int32_t* ifmap, const int32_t* weight, int32_t* psum, int rows, int num_pe)
+{
+    const __m256i mask = _mm256_set1_epi32(0x00FF00FF);
+    for (int l = 0; l < rows; l++)
+    {
+        const int32_t* a = ifmap + l * num_pe;
+        for (int j = 0; j < 4; j++)
+        {
+            const int32_t* w = weight + (l * 4 + j) * num_pe;
+            int32_t* ps = psum + j * num_pe;
+            int p = 0;
+            for (; p + 8 <= num_pe; p += 8)
+            {
+                __m256i va = _mm256_loadu_si256((const __m256i*)(a + p));
+                __m256i vw = _mm256_loadu_si256((const __m256i*)(w + p));
+                __m256i even = _mm256_madd_epi16(_mm256_and_si256(va, mask), _mm256_and_si256(vw, mask));
+                __m256i odd = _mm256_madd_epi16(_mm256_and_si256(_mm256_srli_epi16(va, 8), mask),
+                                                _mm256_and_si256(_mm256_srli_epi16(vw, 8), mask));
+                __m256i vp = _mm256_loadu_si256((const __m256i*)(ps + p));
+                _mm256_storeu_si256((__m256i*)(ps + p), _mm256_add_epi32(vp, _mm256_add_epi32(even, odd)));
+            }
+            for (; p < num_pe; p++)
+                ps[p] = int32_t(uint32_t(ps[p]) + pe_dot4_u8(a[p], w[p]));
+        }
+    }
+}
+
+__attribute__((target("avx512vnni,avx512vl")))
+static void pe_mac_array_avx512_vnni(const int32_t* ifmap, const int32_t* weight, int32_t* psum, int rows, int num_pe)
+{
+    const __m256i bias = _mm256_set1_epi8(char(0x80));
+    const __m256i ones = _mm256_set1_epi8(1);
+    for (int l = 0; l < rows; l++)
+    {
+        const int32_t* a = ifmap + l * num_pe;
+        int p = 0;
+        for (; p + 8 <= num_pe; p += 8)
+        {
+            __m256i va = _mm256_loadu_si256((const __m256i*)(a + p));
+            __m256i asum = _mm256_slli_epi32(_mm256_dpbusd_epi32(_mm256_setzero_si256(), va, ones), 7);
+            for (int j = 0; j < 4; j++)
+            {
+                int32_t* ps = psum + j * num_pe + p;
+                __m256i vw = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(weight + (l * 4 + j) * num_pe + p)), bias);
+                __m256i vp = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)ps), asum);
+                _mm256_storeu_si256((__m256i*)ps, _mm256_dpbusd_epi32(vp, va, vw));
+            }
+        }
+        for (; p < num_pe; p++)
+            for (int j = 0; j < 4; j++)
+                psum[j * num_pe + p] = int32_t(uint32_t(psum[j * num_pe + p]) + pe_dot4_u8(a[p], weight[(l * 4 + j) * num_pe + p]));
+    }
+}
+#endif
+
+// GEMM 的 inner loop (fast mode): 一個 row 的 k_count 個 ifmap word 乘 weight 的 k_count 個 row
+// c[o] += sum_k dot4(a[k], w[k][o]),  o = 0 ~ n-1, k_count <= PE_GEMM_K_BLOCK
+// c 的一段留在 register 裡把 k 全部加完才寫回
+constexpr int PE_GEMM_K_BLOCK = 64;
+typedef void (*pe_gemm_row_fn)(const int32_t* a, const int32_t* const* w, int k_count, int32_t* c, int n);
+
+// column [from, n)，SIMD kernel 剩下的尾巴也用這個
+static void pe_gemm_cols_scalar(const int32_t* a, const int32_t* const* w, int k_count, int32_t* c, int from, int n)
+{
+    for (int o = from; o < n; o++)
+    {
+        uint32_t sum = uint32_t(c[o]);
+        for (int k = 0; k < k_count; k++)
+            sum += pe_dot4_u8(a[k], w[k][o]);
+        c[o] = int32_t(sum);
+    }
+}
+
+static void pe_gemm_row_scalar(const int32_t* a, const int32_t* const* w, int k_count, int32_t* c, int n)
+{
+    pe_gemm_cols_scalar(a, w, k_count, c, 0, n);
+}
+
+#ifdef PE_KERNEL_X86
+// 和 pe_mac_array_avx2 一樣拆 even/odd byte，a[k] broadcast 到 8 個 column
+__attribute__((target("avx2")))
+static inline __m256i pe_gemm_dot4_avx2(__m256i acc, __m256i a_even, __m256i a_odd, const int32_t* w)
+{
+    const __m256i mask = _mm256_set1_epi32(0x00FF00FF);
+    __m256i vw = _mm256_loadu_si256((const __m256i*)w);
+    __m256i even = _mm256_madd_epi16(a_even, _mm256_and_si256(vw, mask));
+    __m256i odd = _mm256_madd_epi16(a_odd, _mm256_and_si256(_mm256_srli_epi16(vw, 8), mask));
+    return _mm256_add_epi32(acc, _mm256_add_epi32(even, odd));
+}
+
+// 一次 32 個 column (4 條互不相依的累加，不然卡在 add 的 latency)，剩下的 8 個一組，最後 scalar
+__attribute__((target("avx2")))
+static void pe_gemm_row_avx2(const int32_t* a, const int32_t* const* w, int k_count, int32_t* c, int n)
+{
+    const __m256i mask = _mm256_set1_epi32(0x00FF00FF);
+    __m256i a_even[PE_GEMM_K_BLOCK];
+    __m256i a_odd[PE_GEMM_K_BLOCK];
+    for (int k = 0; k < k_count; k++)
+    {
+        __m256i va = _mm256_set1_epi32(a[k]);
+        a_even[k] = _mm256_and_si256(va, mask);
+        a_odd[k] = _mm256_and_si256(_mm256_srli_epi16(va, 8), mask);
+    }
+    int o = 0;
+    for (; o + 32 <= n; o += 32)
+    {
+        __m256i acc0 = _mm256_loadu_si256((const __m256i*)(c + o));
+        __m256i acc1 = _mm256_loadu_si256((const __m256i*)(c + o + 8));
+        __m256i acc2 = _mm256_loadu_si256((const __m256i*)(c + o + 16));
+        __m256i acc3 = _mm256_loadu_si256((const __m256i*)(c + o + 24));
+        for (int k = 0; k < k_count; k++)
+        {
+            acc0 = pe_gemm_dot4_avx2(acc0, a_even[k], a_odd[k], w[k] + o);
+            acc1 = pe_gemm_dot4_avx2(acc1, a_even[k], a_odd[k], w[k] + o + 8);
+            acc2 = pe_gemm_dot4_avx2(acc2, a_even[k], a_odd[k], w[k] + o + 16);
+            acc3 = pe_gemm_dot4_avx2(acc3, a_even[k], a_odd[k], w[k] + o + 24);
+        }
+        _mm256_storeu_si256((__m256i*)(c + o), acc0);
+        _mm256_storeu_si256((__m256i*)(c + o + 8), acc1);
+        _mm256_storeu_si256((__m256i*)(c + o + 16), acc2);
+        _mm256_storeu_si256((__m256i*)(c + o + 24), acc3);
+    }
+    for (; o + 8 <= n; o += 8)
+    {
+        __m256i acc = _mm256_loadu_si256((const __m256i*)(c + o));
+        for (int k = 0; k < k_count; k++)
+            acc = pe_gemm_dot4_avx2(acc, a_even[k], a_odd[k], w[k] + o);
+        _mm256_storeu_si256((__m256i*)(c + o), acc);
+    }
+    pe_gemm_cols_scalar(a, w, k_count, c, o, n);
+}
+
+// weight xor 0x80 之後是 s8，128 * sum(a) 對所有 column 一樣，先算好
+__attribute__((target("avx512vnni,avx512vl")))
+static inline __m256i pe_gemm_dot4_vnni(__m256i acc, __m256i va, const int32_t* w)
+{
+    const __m256i bias = _mm256_set1_epi8(char(0x80));
+    return _mm256_dpbusd_epi32(acc, va, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)w), bias));
+}
+
+__attribute__((target("avx512vnni,avx512vl")))
+static void pe_gemm_row_avx512_vnni(const int32_t* a, const int32_t* const* w, int k_count, int32_t* c, int n)
+{
+    uint32_t a_sum = 0;
+    for (int k = 0; k < k_count; k++)
+        a_sum += pe_dot4_u8(a[k], 0x01010101);
+    __m256i asum = _mm256_set1_epi32(int32_t(a_sum << 7));
+    int o = 0;
+    for (; o + 32 <= n; o += 32)
+    {
+        __m256i acc0 = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(c + o)), asum);
+        __m256i acc1 = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(c + o + 8)), asum);
+        __m256i acc2 = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(c + o + 16)), asum);
+        __m256i acc3 = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(c + o + 24)), asum);
+        for (int k = 0; k < k_count; k++)
+        {
+            __m256i va = _mm256_set1_epi32(a[k]);
+            acc0 = pe_gemm_dot4_vnni(acc0, va, w[k] + o);
+            acc1 = pe_gemm_dot4_vnni(acc1, va, w[k] + o + 8);
+            acc2 = pe_gemm_dot4_vnni(acc2, va, w[k] + o + 16);
+            acc3 = pe_gemm_dot4_vnni(acc3, va, w[k] + o + 24);
+        }
+        _mm256_storeu_si256((__m256i*)(c + o), acc0);
+        _mm256_storeu_si256((__m256i*)(c + o + 8), acc1);
+        _mm256_storeu_si256((__m256i*)(c + o + 16), acc2);
+        _mm256_storeu_si256((__m256i*)(c + o + 24), acc3);
+    }
+    for (; o + 8 <= n; o += 8)
+    {
+        __m256i acc = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(c + o)), asum);
+        for (int k = 0; k < k_count; k++)
+            acc = pe_gemm_dot4_vnni(acc, _mm256_set1_epi32(a[k]), w[k] + o);
+        _mm256_storeu_si256((__m256i*)(c + o), acc);
+    }
+    pe_gemm_cols_scalar(a, w, k_count, c, o, n);
+}
+#endif
+
+inline bool pe_kernel_supported(PEKernel k)
+{
+#ifdef PE_KERNEL_X86
+    __builtin_cpu_init(); // 可能在 static init 階段被呼叫
+#endif
+    switch (k)
+    {
+        case PE_KERNEL_SCALAR:
+        case PE_KERNEL_SWAR:
+            return true;
+#ifdef PE_KERNEL_X86
+        case PE_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+        case PE_KERNEL_AVX512_VNNI:
+            return __builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx512vl");
+#endif
+        default:
+            return false;
+    }
+}
+
+inline pe_mac_fn pe_kernel_fn(PEKernel k)
+{
+    switch (k)
+    {
+        case PE_KERNEL_SWAR:        return pe_mac_swar;
+#ifdef PE_KERNEL_X86
+        case PE_KERNEL_AVX2:        return pe_mac_avx2;
+        case PE_KERNEL_AVX512_VNNI: return pe_mac_avx512_vnni;
+#endif
+        default:                    return pe_mac_scalar;
+    }
+}
+
+// PE_Array 整個 plane 一次算的版本
+// SWAR 在 SoA sweep 沒有優勢 (scalar 版本 compiler 本身就能 auto-vectorize)，共用 scalar
+inline pe_mac_array_fn pe_kernel_array_fn(PEKernel k)
+{
+    switch (k)
+    {
+#ifdef PE_KERNEL_X86
+        case PE_KERNEL_AVX2:        return pe_mac_array_avx2;
+        case PE_KERNEL_AVX512_VNNI: return pe_mac_array_avx512_vnni;
+#endif
+        default:                    return pe_mac_array_scalar;
+    }
+}
+
+// SWAR 也共用 scalar (理由同上)
+inline pe_gemm_row_fn pe_kernel_gemm_row_fn(PEKernel k)
+{
+    switch (k)
+    {
+#ifdef PE_KERNEL_X86
+        case PE_KERNEL_AVX2:        return pe_gemm_row_avx2;
+        case PE_KERNEL_AVX512_VNNI: return pe_gemm_row_avx512_vnni;
+#endif
+        default:                    return pe_gemm_row_scalar;
+    }
+}
+
+// 選最快的可用 kernel，環境變數 PE_KERNEL=scalar/swar/avx2/avx512_vnni 可強制指定
+inline PEKernel pe_kernel_detect()
+{
+    const char* env = getenv("PE_KERNEL");
+    if (env != nullptr)
+    {
+        for (int k = 0; k < PE_KERNEL_COUNT; k++)
+        {
+            if (string(env) == pe_kernel_name(PEKernel(k)) && pe_kernel_supported(PEKernel(k)))
+                return PEKernel(k);
+        }
+        cerr << "PE_KERNEL=" << env << " not available, using auto detect\n";
+    }
+    for (int k = PE_KERNEL_COUNT - 1; k > PE_KERNEL_SCALAR; k--)
+    {
+        if (pe_kernel_supported(PEKernel(k)))
+            return PEKernel(k);
+    }
+    return PE_KERNEL_SCALAR;
+}
+
+struct PEKernelDispatch
+{
+    static inline PEKernel kernel = pe_kernel_detect();
+    static inline pe_mac_fn mac = pe_kernel_fn(kernel);
+    static inline pe_mac_array_fn mac_array = pe_kernel_array_fn(kernel);
+    static inline pe_gemm_row_fn gemm_row = pe_kernel_gemm_row_fn(kernel);
+
+    static bool select(PEKernel k)
+    {
+        if (!pe_kernel_supported(k))
+            return false;
+        kernel = k;
+        mac = pe_kernel_fn(k);
+        mac_array = pe_kernel_array_fn(k);
+        gemm_row = pe_kernel_gemm_row_fn(k);
+        return true;
+    }
+};
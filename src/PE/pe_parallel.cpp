@@ -0,0 +1,141 @@
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+using namespace std;
+
+// PE_Array 平行 stepping 用的 barrier 與 persistent thread pool
+// worker 建好後一直留著，每次 run() 只是換一個 job，不會每個 cycle 重開 thread
+
+// 可重複使用的 barrier (generation 計數，C++17 沒有 std::barrier)
+class PEBarrier
+{
+    public:
+        explicit PEBarrier(int n = 1) : count(n), waiting(0), generation(0) {}
+
+        void reset(int n)
+        {
+            lock_guard<mutex> lock(mtx);
+            count = n;
+            waiting = 0;
+        }
+
+        void arrive_and_wait()
+        {
+            unique_lock<mutex> lock(mtx);
+            long long gen = generation;
+            if (++waiting == count)
+            {
+                waiting = 0;
+                generation++;
+                cv.notify_all();
+                return;
+            }
+            cv.wait(lock, [&] { return generation != gen; });
+        }
+
+    private:
+        mutex mtx;
+        condition_variable cv;
+        int count;
+        int waiting;
+        long long generation;
+};
+
+// thread 0 是呼叫 run() 的 thread，其餘 num_threads - 1 個是常駐 worker
+class PEThreadPool
+{
+    public:
+        explicit PEThreadPool(int n) : num_threads(max(1, n)), job_id(0), done(0), stop(false)
+        {
+            for (int t = 1; t < num_threads; t++)
+                workers.emplace_back([this, t] { worker_loop(t); });
+        }
+
+        ~PEThreadPool()
+        {
+            {
+                lock_guard<mutex> lock(mtx);
+                stop = true;
+                job_id++;
+            }
+            start_cv.notify_all();
+            for (thread& w : workers)
+                w.join();
+        }
+
+        PEThreadPool(const PEThreadPool&) = delete;
+        PEThreadPool& operator=(const PEThreadPool&) = delete;
+
+        int size() const
+        {
+            return num_threads;
+        }
+
+        // 每個 thread 跑 fn(tid)，全部做完才回傳
+        void run(const function<void(int)>& fn)
+        {
+            if (num_threads == 1)
+            {
+                fn(0);
+                return;
+            }
+            {
+                lock_guard<mutex> lock(mtx);
+                job = &fn;
+                done = 0;
+                job_id++;
+            }
+            start_cv.notify_all();
+            fn(0);
+            unique_lock<mutex> lock(mtx);
+            done_cv.wait(lock, [&] { return done == num_threads - 1; });
+            job = nullptr;
+        }
+
+        // [0, n) 切成 num_threads 段連續的 band，回傳第 t 段
+        pair<int, int> band(int t, int n) const
+        {
+            int base = n / num_threads;
+            int extra = n % num_threads;
+            int begin = t * base + min(t, extra);
+            return {begin, begin + base + (t < extra ? 1 : 0)};
+        }
+
+    private:
+        void worker_loop(int t)
+        {
+            long long seen = 0;
+            while (true)
+            {
+                const function<void(int)>* fn;
+                {
+                    unique_lock<mutex> lock(mtx);
+                    start_cv.wait(lock, [&] { return job_id != seen; });
+                    seen = job_id;
+                    if (stop)
+                        return;
+                    fn = job;
+                }
+                (*fn)(t);
+                {
+                    lock_guard<mutex> lock(mtx);
+                    done++;
+                }
+                done_cv.notify_one();
+            }
+        }
+
+        int num_threads;
+        vector<thread> workers;
+        mutex mtx;
+        condition_variable start_cv;
+        condition_variable done_cv;
+        const function<void(int)>* job = nullptr;
+        long long job_id;
+        int done;
+        bool stop;
+};
@@ -0,0 +1,322 @@
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include "pe_kernel.cpp"
+#include "../../analayzer/data_type.h"
+
+using namespace std;
+
+// PE spad 大小 / datapath 的 compile-time specialization 與 runtime registry
+// ROWS = in_feature spad 個數, COLS = 每個 in_feature 對應的 weight 個數 (= psum 個數)
+// DP = DatapathMode，決定一個 int32 word 裡 lane 的寬度與格式
+
+inline uint32_t pe_lane_bits(int32_t value, int lane, int bits)
+{
+    return (uint32_t(value) >> (bits * lane)) & ((1u << bits) - 1);
+}
+
+// 整數 lane 的值 (signed mode 做 sign extension)
+inline int32_t pe_lane_int(int32_t value, int lane, int dp)
+{
+    int bits = dp_lane_bits(dp);
+    uint32_t raw = pe_lane_bits(value, lane, bits);
+    if (dp_is_signed(dp) && (raw >> (bits - 1)) != 0)
+        return int32_t(raw) - (1 << bits);
+    return int32_t(raw);
+}
+
+inline float pe_bf16_to_float(uint32_t bits16)
+{
+    uint32_t bits = bits16 << 16;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// fp32 -> bf16 (round to nearest even)
+inline uint16_t pe_float_to_bf16(float f)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    bits += 0x7FFF + ((bits >> 16) & 1);
+    return uint16_t(bits >> 16);
+}
+
+inline float pe_psum_float(int32_t psum)
+{
+    float f;
+    memcpy(&f, &psum, sizeof(f));
+    return f;
+}
+
+inline int32_t pe_float_psum(float f)
+{
+    int32_t psum;
+    memcpy(&psum, &f, sizeof(psum));
+    return psum;
+}
+
+// psum += a[lane] * b[lane]，整數 mode 以 mod 2^32 累加，bf16 以 fp32 累加
+inline int32_t pe_mac_lane(int32_t psum, int32_t a, int32_t b, int lane, int dp)
+{
+    if (dp_is_float(dp))
+        return pe_float_psum(pe_psum_float(psum) + pe_bf16_to_float(pe_lane_bits(a, lane, 16)) * pe_bf16_to_float(pe_lane_bits(b, lane, 16)));
+    return int32_t(uint32_t(psum) + uint32_t(pe_lane_int(a, lane, dp) * pe_lane_int(b, lane, dp)));
+}
+
+// PE 之間 / GLB 讀回的 psum 累加
+inline int32_t pe_psum_add(int32_t psum, int32_t input, int dp)
+{
+    if (dp_is_float(dp))
+        return pe_float_psum(pe_psum_float(psum) + pe_psum_float(input));
+    return int32_t(uint32_t(psum) + uint32_t(input));
+}
+
+// zero gating 用: ifmap lane 是否為 0 (bf16 的 +0 / -0 都算)
+inline bool pe_lane_zero(int32_t value, int lane, int dp)
+{
+    uint32_t raw = pe_lane_bits(value, lane, dp_lane_bits(dp));
+    return dp_is_float(dp) ? (raw & 0x7FFF) == 0 : raw == 0;
+}
+
+// n 個 packed word 裡為 0 的 lane 數 (stride 給 SoA plane 用)
+inline int pe_zero_lanes(const int32_t* ifmap, int n, int dp, int stride = 1)
+{
+    int zeros = 0;
+    for (int i = 0; i < n; i++)
+    {
+        int32_t value = ifmap[i * stride];
+        if (value == 0)
+        {
+            zeros += dp_lanes(dp);
+            continue;
+        }
+        for (int k = 0; k < dp_lanes(dp); k++)
+            zeros += pe_lane_zero(value, k, dp);
+    }
+    return zeros;
+}
+
+// 驗證用: 整數 mode 要 bit-exact，bf16 容許 fp32 累加順序造成的誤差
+inline bool pe_psum_equal(int32_t dut, int32_t golden, int dp, float rel_tol = 1e-3f)
+{
+    if (!dp_is_float(dp))
+        return dut == golden;
+    float a = pe_psum_float(dut);
+    float b = pe_psum_float(golden);
+    return fabs(a - b) <= rel_tol * max(1.0f, fabs(b));
+}
+
+template <int DP>
+inline uint32_t pe_dot_lanes(int32_t a, int32_t b)
+{
+    uint32_t sum = 0;
+    for (int k = 0; k < dp_lanes(DP); k++)
+        sum += uint32_t(pe_lane_int(a, k, DP) * pe_lane_int(b, k, DP));
+    return sum;
+}
+
+// 單一 PE: trip count 都是常數，compiler 完全展開
+// COLS = 4 的 u8 形狀交給 PEKernelDispatch 的 SIMD kernel
+// bf16 依 (i, k) 順序逐 lane 做 fp32 累加，和 step_cycle 的順序相同
+template <int ROWS, int COLS, int DP>
+static void pe_mac_fixed(const int32_t* ifmap, const int32_t* weight, int32_t* psum)
+{
+    if constexpr (COLS == 4 && DP == DP_U8)
+    {
+        PEKernelDispatch::mac(ifmap, weight, psum, ROWS);
+    }
+    else if constexpr (dp_is_float(DP))
+    {
+        for (int j = 0; j < COLS; j++)
+            for (int i = 0; i < ROWS; i++)
+                for (int k = 0; k < dp_lanes(DP); k++)
+                    psum[j] = pe_mac_lane(psum[j], ifmap[i], weight[i * COLS + j], k, DP);
+    }
+    else
+    {
+        uint32_t acc[COLS] = {0};
+#pragma GCC unroll 16
+        for (int i = 0; i < ROWS; i++)
+#pragma GCC unroll 16
+            for (int j = 0; j < COLS; j++)
+                acc[j] += pe_dot_lanes<DP>(ifmap[i], weight[i * COLS + j]);
+        for (int j = 0; j < COLS; j++)
+            psum[j] = int32_t(uint32_t(psum[j]) + acc[j]);
+    }
+}
+
+// 整個 SoA array: plane[row * num_pe + pe]
+template <int ROWS, int COLS, int DP>
+static void pe_mac_array_fixed(const int32_t* ifmap, const int32_t* weight, int32_t* psum, int num_pe)
+{
+    if constexpr (COLS == 4 && DP == DP_U8)
+    {
+        PEKernelDispatch::mac_array(ifmap, weight, psum, ROWS, num_pe);
+    }
+    else
+    {
+#pragma GCC unroll 16
+        for (int i = 0; i < ROWS; i++)
+        {
+            const int32_t* a = ifmap + i * num_pe;
+#pragma GCC unroll 16
+            for (int j = 0; j < COLS; j++)
+            {
+                const int32_t* w = weight + (i * COLS + j) * num_pe;
+                int32_t* ps = psum + j * num_pe;
+                for (int p = 0; p < num_pe; p++)
+                {
+                    if constexpr (dp_is_float(DP))
+                    {
+                        for (int k = 0; k < dp_lanes(DP); k++)
+                            ps[p] = pe_mac_lane(ps[p], a[p], w[p], k, DP);
+                    }
+                    else
+                    {
+                        ps[p] = int32_t(uint32_t(ps[p]) + pe_dot_lanes<DP>(a[p], w[p]));
+                    }
+                }
+            }
+        }
+    }
+}
+
+// registry 裡最大的 spad (單一 PE 的 compute_full 用 stack buffer)
+constexpr int PE_SPEC_MAX_IFMAP = 6;
+constexpr int PE_SPEC_MAX_WEIGHT_H = 8;
+
+struct PESpec
+{
+    int ifmap_size;
+    int weight_h;
+    int datapath;
+    void (*mac)(const int32_t* ifmap, const int32_t* weight, int32_t* psum);
+    void (*mac_array)(const int32_t* ifmap, const int32_t* weight, int32_t* psum, int num_pe);
+
+    int weight_size() const { return ifmap_size * weight_h; }
+    int psum_size() const { return weight_h; }
+    int lane_bits() const { return dp_lane_bits(datapath); }
+    int lanes() const { return dp_lanes(datapath); }
+    int macs() const { return ifmap_size * weight_h * lanes(); } // cycles of one compute_full (one lane per cycle)
+};
+
+template <int ROWS, int COLS, int DP>
+PESpec make_pe_spec()
+{
+    static_assert(ROWS > 0 && COLS > 0, "empty spad");
+    static_assert(DP >= 0 && DP < DP_COUNT, "unknown datapath");
+    static_assert(ROWS <= PE_SPEC_MAX_IFMAP && COLS <= PE_SPEC_MAX_WEIGHT_H, "raise PE_SPEC_MAX_IFMAP / PE_SPEC_MAX_WEIGHT_H");
+    return {ROWS, COLS, DP, pe_mac_fixed<ROWS, COLS, DP>, pe_mac_array_fixed<ROWS, COLS, DP>};
+}
+
+// 可以 sweep 的 spad / datapath 組合，第一個是 Eyeriss 預設 (12B ifmap / 48B weight / 16B psum, u8)
+// 要新的大小在這裡加一行
+inline const vector<PESpec>& pe_spec_registry()
+{
+    static const vector<PESpec> registry = {
+        make_pe_spec<3, 4, DP_U8>(),
+        make_pe_spec<3, 4, DP_INT4>(),
+        make_pe_spec<3, 4, DP_INT8>(),
+        make_pe_spec<3, 4, DP_INT16>(),
+        make_pe_spec<3, 4, DP_BF16>(),
+        make_pe_spec<1, 4, DP_U8>(),
+        make_pe_spec<2, 4, DP_U8>(),
+        make_pe_spec<4, 4, DP_U8>(),
+        make_pe_spec<6, 4, DP_U8>(),
+        make_pe_spec<3, 2, DP_U8>(),
+        make_pe_spec<3, 8, DP_U8>(),
+        make_pe_spec<6, 8, DP_U8>(),
+    };
+    return registry;
+}
+
+inline const PESpec* pe_spec_find(int ifmap_size, int weight_h, int datapath = DP_U8)
+{
+    for (const PESpec& s : pe_spec_registry())
+    {
+        if (s.ifmap_size == ifmap_size && s.weight_h == weight_h && s.datapath == datapath)
+            return &s;
+    }
+    return nullptr;
+}
+
+inline void pe_spec_list(ostream& os)
+{
+    for (const PESpec& s : pe_spec_registry())
+        os << "  ifmap " << s.ifmap_size << ", weight " << s.ifmap_size << " x " << s.weight_h
+           << ", psum " << s.psum_size() << ", " << dp_name(s.datapath) << "\n";
+}
+
+// ===== fast mode 的 functional GEMM =====
+
+// c[o] += sum_k a[k] . w[k][o] (lane 逐一乘加)，u8 以外的 datapath 用
+template <int DP>
+static void pe_gemm_row_lanes(const int32_t* a, const int32_t* const* w, int k_count, int32_t* c, int n)
+{
+    for (int o = 0; o < n; o++)
+    {
+        for (int k = 0; k < k_count; k++)
+        {
+            if constexpr (dp_is_float(DP))
+            {
+                for (int l = 0; l < dp_lanes(DP); l++)
+                    c[o] = pe_mac_lane(c[o], a[k], w[k][o], l, DP);
+            }
+            else
+            {
+                c[o] = int32_t(uint32_t(c[o]) + pe_dot_lanes<DP>(a[k], w[k][o]));
+            }
+        }
+    }
+}
+
+inline pe_gemm_row_fn pe_gemm_row_for(int dp)
+{
+    switch (dp)
+    {
+        case DP_U8:    return PEKernelDispatch::gemm_row;
+        case DP_INT4:  return pe_gemm_row_lanes<DP_INT4>;
+        case DP_INT8:  return pe_gemm_row_lanes<DP_INT8>;
+        case DP_INT16: return pe_gemm_row_lanes<DP_INT16>;
+        default:       return pe_gemm_row_lanes<DP_BF16>;
+    }
+}
+
+// c[r][o] += sum_k a[r][k] . w[k][o]   a: [rows][k_words], w: [k_words][cols], c: [rows][cols]
+// packed word 的 lane 格式和 PE 一樣，整數 mode mod 2^32 累加 (和 PE array bit-exact)，bf16 以 fp32 累加 (順序和 PE 不同)
+// cache blocking: 一塊 PE_GEMM_K_BLOCK x C_BLOCK 的 weight 在 L2 裡給所有 row 重複用，整數的 a = 0 直接跳過
+inline void pe_gemm_packed(const int32_t* a, const int32_t* w, int32_t* c, int rows, int k_words, int cols, int dp)
+{
+    const int C_BLOCK = 512;
+    pe_gemm_row_fn row = pe_gemm_row_for(dp);
+    bool skip_zero = !dp_is_float(dp);  // bf16 的 0 * inf 不是 0
+    int32_t a_block[PE_GEMM_K_BLOCK];
+    const int32_t* w_block[PE_GEMM_K_BLOCK];
+    for (int c0 = 0; c0 < cols; c0 += C_BLOCK)
+    {
+        int nc = min(C_BLOCK, cols - c0);
+        for (int k0 = 0; k0 < k_words; k0 += PE_GEMM_K_BLOCK)
+        {
+            int k1 = min(k_words, k0 + PE_GEMM_K_BLOCK);
+            for (int r = 0; r < rows; r++)
+            {
+                const int32_t* ar = a + (size_t)r * k_words;
+                int count = 0;
+                for (int k = k0; k < k1; k++)
+                {
+                    if (skip_zero && ar[k] == 0)
+                        continue;
+                    a_block[count] = ar[k];
+                    w_block[count] = w + (size_t)k * cols + c0;
+                    count++;
+                }
+                if (count > 0)
+                    row(a_block, w_block, count, c + (size_t)r * cols + c0, nc);
+            }
+        }
+    }
+}
@@ -24,6 +24,10 @@ array<int32_t, TOTAL_WEIGHT> generate_weight();
 array<int32_t, NUM_WEIGHT> generate_golden_output
 (const array<int32_t, IFMAP_SIZE>& in_feature_spad, const array<int32_t, TOTAL_WEIGHT>& weight_spad);
 array<uint8_t, 4> get_bytes(int32_t value);
+int check_datapaths();
+int check_zero_gating();
+int check_fast_forward(int trials);
+int check_thread_pool_copies();
 
 random_device rd;  
 mt19937 rng(rd());  // random seed
@@ -42,9 +46,9 @@ int main()
     array<int32_t, IFMAP_SIZE> in_feature_spad;
     array<int32_t, TOTAL_WEIGHT> weight_spad;
     array<int32_t, NUM_WEIGHT> golden_output;
-    array<array<int32_t, NUM_WEIGHT>, 8 * MODE> golden_output_all = {0};
+    vector<array<int32_t, NUM_WEIGHT>> golden_output_all(pe_array.pe_h * MODE, array<int32_t, NUM_WEIGHT>{0});
     // 48 PEs, 根據不同mode輸出
-    for(int i = 0; i < PE_Array::NUM_PE; i++)
+    for(int i = 0; i < pe_array.num_pe; i++)
     {
         // === 產生 Input Feature ===
         in_feature_spad = generate_in_feature();
@@ -64,12 +68,21 @@ int main()
 
     }
 
+    // event-skipping 版本要和逐 cycle 的結果一樣
+    PE_Array ff_array = pe_array;
+
     // full compute
     pe_array.start_step();
     while (pe_array.is_any_busy())
     {
         pe_array.step_all();
     }
+
+    ff_array.start_step();
+    ff_array.run_until_idle();
+    bool ff_match = ff_array.cycle == pe_array.cycle && ff_array.psum_plane == pe_array.psum_plane
+                    && ff_array.out_valid == pe_array.out_valid;
+    cout << "Fast-forward vs step_all: " << (ff_match ? "match" : "MISMATCH") << "\n";
     
     //pe_array.compute_full_all();
     //pe_array.dump(0);
@@ -78,41 +91,9 @@ int main()
     //check results
     int errors = 0;
     cout << "\n=== Checking Results ===\n";
-    array<int, 6> base = {0};
-    switch (MODE)
-    {
-        case 1:
-        {
-            base[0] = 40;
-            break;
-        }
-        case 2:
-        {
-            base[0] = 16;
-            base[1] = 40;
-            break;
-        }
-        case 3:
-        {
-            base[0] = 8;
-            base[1] = 24;
-            base[2] = 40;
-            break;
-        }
-        case 6:
-        {
-            base[0] = 0;
-            base[1] = 8;
-            base[2] = 16;
-            base[3] = 24;
-            base[4] = 32;
-            base[5] = 40;
-        }
-    }
-
-    for(int i = 0; i < 8 * MODE; i++)
+    for(int i = 0; i < pe_array.pe_h * MODE; i++)
     {
-        int num = base[i / 8] + i % 8;
+        int num = pe_array.group_last_pe(i / pe_array.pe_h) + i % pe_array.pe_h;
         cout << "\n=== PE[" << num << "] Output ===\n";
         bool match = true;
         for (int j = 0; j < NUM_WEIGHT; j++)
@@ -142,6 +123,12 @@ int main()
         }
     }
 
+    if(!ff_match)
+        errors++;
+    errors += check_datapaths();
+    errors += check_zero_gating();
+    errors += check_fast_forward(20);
+    errors += check_thread_pool_copies();
     if(errors == 0)
         cout << "\nAll outputs match golden results!";
     else
@@ -235,4 +222,327 @@ array<uint8_t, 4> get_bytes(int32_t value)
         bytes[i] = (value >> (8 * i)) & 0xFF;
     //may need to dequantize here
     return bytes;
-}
\ No newline at end of file
+}
+
+// 單一 PE 一次算完 (compute_full) 和逐 cycle (step_cycle) 的 psum / cycle / counter 要一樣
+template <typename P>
+bool compute_both_ways(P& pe)
+{
+    P stepped = pe;
+    pe.compute_full();
+    stepped.start_cycle_compute();
+    while (stepped.is_busy())
+        stepped.step_cycle();
+    return memcmp(pe.psum_spad, stepped.psum_spad, sizeof(pe.psum_spad)) == 0 && pe.cycle == stepped.cycle
+           && pe.macs_executed == stepped.macs_executed && pe.macs_gated == stepped.macs_gated;
+}
+
+int expect_value(const string& name, int32_t got, int32_t want)
+{
+    if (got == want)
+        return 0;
+    cout << name << " = " << got << " (expected " << want << ") <-- MISMATCH!\n";
+    return 1;
+}
+
+// 每個 datapath 的邊界值: 整數 lane 是 sign extension 後相乘，psum mod 2^32 累加 (不飽和，超過 int32 會 wrap)
+// bf16 operand 轉換是 round to nearest even，psum 以 fp32 累加
+int check_datapaths()
+{
+    int errors = 0;
+
+    PE_T<3, 4, DP_U8> u8;
+    for (int i = 0; i < 3; i++)
+    {
+        u8.in_feature_spad[i] = int32_t(0xFFFFFFFF);
+        u8.weight_spad[i * 4 + 0] = int32_t(0xFFFFFFFF);  // 255 x 255
+        u8.weight_spad[i * 4 + 1] = 0x00000001;           // lane 0 = 1
+    }
+    errors += !compute_both_ways(u8);
+    errors += expect_value("u8 255 x 255", u8.psum_spad[0], 3 * 4 * 255 * 255);
+    errors += expect_value("u8 255 x 1", u8.psum_spad[1], 3 * 255);
+
+    // int4: 8 lanes，-8 (0x8) 和 7 (0x7) 是兩端
+    PE_T<3, 4, DP_INT4> int4;
+    for (int i = 0; i < 3; i++)
+    {
+        int4.in_feature_spad[i] = int32_t(0x88888888);
+        int4.weight_spad[i * 4 + 0] = int32_t(0x88888888);  // -8 x -8
+        int4.weight_spad[i * 4 + 1] = 0x77777777;           // -8 x 7
+        int4.weight_spad[i * 4 + 2] = int32_t(0xFFFFFFFF);  // -8 x -1
+        int4.weight_spad[i * 4 + 3] = 0x00000001;           // 只有 lane 0 = 1
+    }
+    errors += !compute_both_ways(int4);
+    errors += expect_value("int4 -8 x -8", int4.psum_spad[0], 3 * 8 * 64);
+    errors += expect_value("int4 -8 x 7", int4.psum_spad[1], 3 * 8 * -56);
+    errors += expect_value("int4 -8 x -1", int4.psum_spad[2], 3 * 8 * 8);
+    errors += expect_value("int4 -8 x 1 (lane 0)", int4.psum_spad[3], 3 * -8);
+
+    PE_T<3, 4, DP_INT8> int8;
+    for (int i = 0; i < 3; i++)
+    {
+        int8.in_feature_spad[i] = int32_t(0x80808080);
+        int8.weight_spad[i * 4 + 0] = int32_t(0x80808080);  // -128 x -128
+        int8.weight_spad[i * 4 + 1] = 0x7F7F7F7F;           // -128 x 127
+    }
+    errors += !compute_both_ways(int8);
+    errors += expect_value("int8 -128 x -128", int8.psum_spad[0], 3 * 4 * 16384);
+    errors += expect_value("int8 -128 x 127", int8.psum_spad[1], 3 * 4 * -16256);
+
+    // int16: -32768 x -32768 = 2^30，一個 word 兩個 lane 就是 2^31，三個 word 累加後 wrap 成 INT32_MIN
+    PE_T<3, 4, DP_INT16> int16;
+    for (int i = 0; i < 3; i++)
+    {
+        int16.in_feature_spad[i] = int32_t(0x80008000);
+        int16.weight_spad[i * 4 + 0] = int32_t(0x80008000);  // -32768 x -32768
+        int16.weight_spad[i * 4 + 1] = 0x7FFF7FFF;           // -32768 x 32767
+        int16.weight_spad[i * 4 + 2] = 0x00010000;           // lane 0 = 0, lane 1 = 1
+    }
+    errors += !compute_both_ways(int16);
+    errors += expect_value("int16 -32768 x -32768", int16.psum_spad[0], INT32_MIN);
+    errors += expect_value("int16 -32768 x 32767", int16.psum_spad[1], -2147287040);
+    errors += expect_value("int16 -32768 x 1 (lane 1)", int16.psum_spad[2], 3 * -32768);
+    errors += expect_value("int16 x 0", int16.psum_spad[3], 0);
+
+    // bf16 round to nearest even: 剛好一半時取偶數 mantissa
+    errors += expect_value("bf16 round 1 + 2^-8", pe_float_to_bf16(pe_psum_float(0x3F808000)), 0x3F80);
+    errors += expect_value("bf16 round 1 + 3 * 2^-8", pe_float_to_bf16(pe_psum_float(0x3F818000)), 0x3F82);
+    errors += expect_value("bf16 round above half", pe_float_to_bf16(pe_psum_float(0x3F808001)), 0x3F81);
+    errors += expect_value("bf16 round below half", pe_float_to_bf16(pe_psum_float(0x3F817FFF)), 0x3F81);
+    errors += expect_value("bf16 round -1 - 2^-8", pe_float_to_bf16(pe_psum_float(int32_t(0xBF808000))), 0xBF80);
+
+    PE_T<3, 4, DP_BF16> bf16;
+    for (int i = 0; i < 3; i++)
+    {
+        bf16.in_feature_spad[i] = int32_t(0xC0003FC0);  // lane 0 = 1.5, lane 1 = -2.0
+        bf16.weight_spad[i * 4 + 0] = 0x3F804000;       // lane 0 = 2.0, lane 1 = 1.0
+        bf16.weight_spad[i * 4 + 1] = 0x3F813F81;       // 1.0078125 (bf16 最小的 1 以上的值)
+    }
+    errors += !compute_both_ways(bf16);
+    errors += expect_value("bf16 1.5 x 2 - 2 x 1", bf16.psum_spad[0], pe_float_psum(3.0f));
+    errors += expect_value("bf16 x 1.0078125", bf16.psum_spad[1], pe_float_psum(3 * (1.5f - 2.0f) * 1.0078125f));
+
+    cout << "Datapath lanes (u8 / int4 / int8 / int16 / bf16): " << (errors == 0 ? "match" : "MISMATCH") << "\n";
+    return errors;
+}
+
+// zero gating: ifmap lane 是 0 的 MAC 算 gated，GATE_CLOCK 照樣花 cycle，GATE_SKIP 不花
+// u8: ifmap 的 0 lane 有 2 + 4 + 0 = 6 個，x 4 個 psum = 24 個 gated MAC (總共 48)
+// bf16: -0 也算 0，0 lane 有 1 + 2 + 0 = 3 個，x 4 = 12 個 gated MAC (總共 24)
+int check_zero_gating()
+{
+    int errors = 0;
+    for (int g = GATE_NONE; g < GATE_COUNT; g++)
+    {
+        string name = string("gating ") + gating_name(g);
+
+        PE_T<3, 4, DP_U8> u8;
+        u8.gating = g;
+        u8.in_feature_spad[0] = 0x00FF00FF;
+        u8.in_feature_spad[1] = 0;
+        u8.in_feature_spad[2] = 0x01020304;
+        for (int i = 0; i < 12; i++)
+            u8.weight_spad[i] = 0x01010101;
+        errors += !compute_both_ways(u8);
+        int gated = g == GATE_NONE ? 0 : 24;
+        errors += expect_value(name + " u8 psum", u8.psum_spad[0], 255 + 255 + 1 + 2 + 3 + 4);
+        errors += expect_value(name + " u8 macs_gated", int32_t(u8.macs_gated), gated);
+        errors += expect_value(name + " u8 macs_executed", int32_t(u8.macs_executed), 48 - gated);
+        errors += expect_value(name + " u8 cycles", u8.cycle, g == GATE_SKIP ? 24 : 48);
+
+        PE_T<3, 4, DP_BF16> bf16;
+        bf16.gating = g;
+        bf16.in_feature_spad[0] = int32_t(0x80003F80);  // lane 0 = 1.0, lane 1 = -0
+        bf16.in_feature_spad[1] = 0;
+        bf16.in_feature_spad[2] = 0x3F803F80;
+        for (int i = 0; i < 12; i++)
+            bf16.weight_spad[i] = 0x40004000;  // 2.0
+        errors += !compute_both_ways(bf16);
+        gated = g == GATE_NONE ? 0 : 12;
+        errors += expect_value(name + " bf16 psum", bf16.psum_spad[0], pe_float_psum(6.0f));
+        errors += expect_value(name + " bf16 macs_gated", int32_t(bf16.macs_gated), gated);
+        errors += expect_value(name + " bf16 macs_executed", int32_t(bf16.macs_executed), 24 - gated);
+        errors += expect_value(name + " bf16 cycles", bf16.cycle, g == GATE_SKIP ? 12 : 24);
+
+        // PE_Array: compute_full_all 回傳最慢的 PE 的 latency，其他 PE 全是 0 (skip 時 0 cycle)
+        PE_Array array;
+        array.reset();
+        array.gating = g;
+        for (int i = 0; i < 3; i++)
+        {
+            array.ifmap_plane[i * array.num_pe] = u8.in_feature_spad[i];
+            for (int j = 0; j < 4; j++)
+                array.weight_plane[(i * 4 + j) * array.num_pe] = 0x01010101;
+        }
+        int latency = array.compute_full_all();
+        errors += expect_value(name + " array latency", latency, g == GATE_SKIP ? 24 : 48);
+        errors += expect_value(name + " array gated", int32_t(array.total_macs_gated()),
+                               g == GATE_NONE ? 0 : 24 + 48 * (array.num_pe - 1));
+        errors += expect_value(name + " array psum", array.psum_plane[0], 520);
+    }
+    cout << "Zero gating counters (none / clock / skip): " << (errors == 0 ? "match" : "MISMATCH") << "\n";
+    return errors;
+}
+
+// 隨機的 packed word，每個 lane 30% 是 0 (bf16 的 0 一半是 -0)
+int32_t random_word(int dp)
+{
+    uniform_int_distribution<uint32_t> bits;
+    bernoulli_distribution zero(0.3);
+    int lane_bits = dp_lane_bits(dp);
+    uint32_t lane_mask = (1u << lane_bits) - 1;
+    uint32_t word = 0;
+    for (int k = 0; k < dp_lanes(dp); k++)
+    {
+        uint32_t lane;
+        if (zero(rng))
+            lane = dp_is_float(dp) ? (bits(rng) & 1) << 15 : 0;
+        else if (dp_is_float(dp))
+            lane = pe_float_to_bf16(uniform_real_distribution<float>(-4.0f, 4.0f)(rng));
+        else
+            lane = bits(rng) & lane_mask;
+        word |= lane << (lane_bits * k);
+    }
+    return int32_t(word);
+}
+
+bool same_state(const PE_Array& a, const PE_Array& b)
+{
+    return a.cycle == b.cycle && a.psum_plane == b.psum_plane && a.busy == b.busy && a.out_valid == b.out_valid
+           && a.if_idx == b.if_idx && a.weight_idx == b.weight_idx && a.cal_idx == b.cal_idx
+           && a.macs_executed == b.macs_executed && a.macs_gated == b.macs_gated;
+}
+
+// advance 到一半時: GATE_SKIP 的 0 lane 不花 cycle，advance 會先跳過，step_all 下一次才處理，
+// 所以位置 / macs_gated / busy 可能先走一步，cycle / psum / 做過的 MAC 要一樣
+bool same_progress(const PE_Array& a, const PE_Array& b)
+{
+    return a.cycle == b.cycle && a.psum_plane == b.psum_plane && a.macs_executed == b.macs_executed;
+}
+
+// event-skipping (advance / run_until_idle) 和 compute_full_all 都要和逐 cycle 的 step_all 一樣
+// 每個 datapath x gating 跑 trials 次隨機的資料: 先 step_all 隨機幾個 cycle (PE 停在不同的位置，一部分 PE 不啟動)，
+// 之後 advance 隨機的 dt 和 step_all 同樣的 cycle 數比對，idle 之後整個 state 要一樣 (一次 run_until_idle 也是)
+// bf16 開 gating 時 0 的 lane 配 inf 的 weight: 被 gate 掉的 lane 不能把 NaN 加進 psum
+int check_fast_forward(int trials)
+{
+    int errors = 0;
+    for (int dp = 0; dp < DP_COUNT; dp++)
+    {
+        for (int g = GATE_NONE; g < GATE_COUNT; g++)
+        {
+            for (int t = 0; t < trials; t++)
+            {
+                PE_Array array;
+                array.configure_spad(3, 4, dp);
+                array.reset();
+                array.gating = g;
+                int n = array.num_pe;
+                for (int i = 0; i < array.ifmap_size; i++)
+                    for (int p = 0; p < n; p++)
+                        array.ifmap_plane[i * n + p] = random_word(dp);
+                for (int w = 0; w < array.weight_size; w++)
+                {
+                    int i = w / array.psum_size;
+                    for (int p = 0; p < n; p++)
+                    {
+                        int32_t word = random_word(dp);
+                        for (int k = 0; k < array.lanes && dp_is_float(dp) && g != GATE_NONE; k++)
+                            if (pe_lane_zero(array.ifmap_plane[i * n + p], k, dp))
+                                word = int32_t((uint32_t(word) & ~(0xFFFFu << (16 * k))) | (0x7F80u << (16 * k)));
+                        array.weight_plane[w * n + p] = word;
+                    }
+                }
+
+                // 全部從頭開始: compute_full_all 和 step_all 到 idle
+                PE_Array bulk = array;
+                PE_Array stepped = array;
+                bulk.compute_full_all();
+                stepped.start_step();
+                while (stepped.is_any_busy())
+                    stepped.step_all();
+                bool match = bulk.psum_plane == stepped.psum_plane && bulk.cycle == stepped.cycle
+                             && bulk.macs_executed == stepped.macs_executed && bulk.macs_gated == stepped.macs_gated;
+
+                // 部分做完的狀態
+                array.start_step();
+                for (int p = 0; p < n; p++)
+                    if (rng() % 8 == 0)
+                        array.busy[p] = 0;
+                int warm = int(rng() % array.spec.macs());
+                for (int c = 0; c < warm; c++)
+                    array.step_all();
+                PE_Array ff = array;
+                PE_Array jump = array;
+                while (match && array.is_any_busy())
+                {
+                    int dt = 1 + int(rng() % 8);
+                    for (int c = 0; c < dt; c++)
+                        array.step_all();
+                    ff.advance(dt);
+                    match = same_progress(array, ff);
+                }
+                ff.run_until_idle();
+                jump.run_until_idle();
+                match = match && same_state(array, ff) && same_state(array, jump);
+                if (!match)
+                {
+                    cout << "Fast-forward " << dp_name(dp) << " / " << gating_name(g) << " trial " << t << " <-- MISMATCH!\n";
+                    errors++;
+                    break;
+                }
+            }
+        }
+    }
+    cout << "Fast-forward vs step_all (random, every datapath x gating): " << (errors == 0 ? "match" : "MISMATCH") << "\n";
+    return errors;
+}
+
+// 複製 / assign 不共用 thread pool: 兩個 array 可以同時在不同 thread 上平行 step
+int check_thread_pool_copies()
+{
+    int errors = 0;
+    PE_Array base;
+    base.reset();
+    base.set_tag();
+    for (int32_t& v : base.ifmap_plane)
+        v = random_word(DP_U8);
+    for (int32_t& v : base.weight_plane)
+        v = random_word(DP_U8);
+    PE_Array reference = base;
+    reference.start_step();
+    reference.step_until_idle();
+    reference.add_ipsum_all();
+
+    base.set_threads(4);
+    PE_Array copy = base;
+    PE_Array assigned;
+    assigned.set_threads(2);
+    assigned = base;
+    errors += expect_value("copy threads", copy.threads(), 1);
+    errors += expect_value("assigned keeps its threads", assigned.threads(), 2);
+    errors += expect_value("original threads", base.threads(), 4);
+    copy.set_threads(3);
+
+    PE_Array* arrays[3] = {&base, &copy, &assigned};
+    vector<thread> runners;
+    for (PE_Array* a : arrays)
+    {
+        runners.emplace_back([a]
+        {
+            for (int pass = 0; pass < 50; pass++)
+            {
+                fill(a->psum_plane.begin(), a->psum_plane.end(), 0);
+                a->start_step();
+                a->step_until_idle();
+                a->add_ipsum_all();
+            }
+        });
+    }
+    for (thread& t : runners)
+        t.join();
+    for (PE_Array* a : arrays)
+        errors += expect_value("concurrent copies psum", a->psum_plane == reference.psum_plane, 1);
+    cout << "Thread pool copies: " << (errors == 0 ? "match" : "MISMATCH") << "\n";
+    return errors;
+}
@@ -0,0 +1,156 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+
+#include "event_kernel.cpp"
+
+using namespace std;
+
+// event kernel vs 每個 cycle tick 所有 component (lockstep)
+// controller 編出來的一個小 GEMM (B x in_features x out_features) 在 memory + PE array 上跑，
+// 兩種模式的 cycle 數和寫回 memory 的 psum 要一樣
+// usage: bench_event_kernel [B [mem_latency outstanding]]   (預設 B = 16，跑幾組 latency / outstanding)
+
+struct BenchResult
+{
+    long long cycles;
+    long long events;
+    long long active_cycles;
+    long long mem_stall_cycles;
+    double seconds;
+    vector<int> psums;
+};
+
+BenchResult run_once(bool lockstep, const LinearShapeParam& shape, const EyerissMappingParam& map, int mem_latency, int outstanding)
+{
+    PE_Array pe_array;
+    pe_array.reset();
+    pe_array.set_groups(vector<int>(map.mode, map.tk));
+    int in_div4 = shape.in_features / pe_array.lanes;
+    int used_rows = map.tk * map.mode;
+
+    // memory: A [B][in_div4]、W [in_div4][out_features]、psum [B][out_features]
+    int weight_base = shape.B * in_div4;
+    int psum_base = weight_base + in_div4 * shape.out_features;
+    memory mem(mem_latency, outstanding);
+    mem.mem.assign(psum_base + shape.B * shape.out_features, 0);
+    mt19937 rng(7);
+    for (int i = 0; i < psum_base; i++)
+        mem.mem[i] = int(rng() & 0x7f7f7f7f);
+
+    controller ctrl;
+    ctrl.compile(map, shape, in_div4, pe_array.ifmap_size, pe_array.weight_h);
+
+    // micro-op -> memory request (index 和 GEMM_with_mem 的 load_* / store_psum 一樣)
+    auto transfers = [&](const MicroOp& op, vector<MemTransfer>& out)
+    {
+        int num_pe = pe_array.num_pe;
+        switch (op.op)
+        {
+            case UOP_LOAD_PSUM:
+                for (int i = 0; i < map.tn * map.mode; i++)
+                    for (int j = 0; j < pe_array.weight_h; j++)
+                        out.push_back({psum_base + op.a + i / map.tn * shape.out_features + (i % map.tn) * pe_array.weight_h + j,
+                                       false, 0, nullptr, 0, 0});
+                break;
+            case UOP_LOAD_IF:
+                for (int l = 0; l < pe_array.ifmap_size * used_rows; l++)
+                {
+                    int index = op.a + (l / map.tk / pe_array.ifmap_size * in_div4) + l % (map.tk * pe_array.ifmap_size);
+                    int32_t* dst = pe_array.ifmap_fill().data() + (l % pe_array.ifmap_size) * num_pe + (l / pe_array.ifmap_size) * pe_array.pe_h;
+                    out.push_back({index, false, 0, dst, map.tn, 1}); // multicast 到同一個 row 的 tn 個 PE
+                }
+                break;
+            case UOP_LOAD_W:
+                for (int l = 0; l < pe_array.weight_size * map.tn * used_rows; l++)
+                {
+                    int pe_index = (l / pe_array.weight_size) % used_rows * pe_array.pe_h + (l / pe_array.weight_size / used_rows);
+                    int index = op.a + l % pe_array.weight_h + ((l / pe_array.weight_h) % (map.tk * pe_array.ifmap_size)) * shape.out_features
+                                + (l / pe_array.weight_size / used_rows) * pe_array.weight_h;
+                    int32_t* dst = pe_array.weight_fill().data() + (l % pe_array.weight_size) * num_pe + pe_index;
+                    out.push_back({weight_base + index, false, 0, dst, 1, 1});
+                }
+                break;
+            case UOP_STORE_PSUM:
+                for (int i = 0; i < map.tn * map.mode; i++)
+                {
+                    int num = pe_array.group_last_pe(i / pe_array.pe_h) + i % pe_array.pe_h;
+                    for (int j = 0; j < pe_array.weight_h; j++)
+                        out.push_back({psum_base + op.a + i / map.tn * shape.out_features + (i % map.tn) * pe_array.weight_h + j,
+                                       true, pe_array.pe[num].output_psum(j), nullptr, 0, 0});
+                    pe_array.pe[num].out_valid = false;
+                    pe_array.pe[num].reset_psum();
+                }
+                break;
+        }
+    };
+
+    EventKernel kernel;
+    MemoryComponent mem_comp(mem);
+    PEArrayComponent pe_comp(pe_array);
+    ControllerComponent ctrl_comp(ctrl.program, mem_comp, pe_comp, transfers, pe_array.reduction_cycles());
+    // lockstep 時同一個 cycle 裡 memory -> PE -> controller，和 event 模式 wake 的順序一樣
+    kernel.add(&mem_comp);
+    kernel.add(&pe_comp);
+    kernel.add(&ctrl_comp);
+    mem_comp.listener = ctrl_comp.id;
+    pe_comp.listener = ctrl_comp.id;
+
+    auto start = chrono::steady_clock::now();
+    if (lockstep)
+        kernel.run_lockstep([&] { return ctrl_comp.done; });
+    else
+        kernel.run();
+    BenchResult result;
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    result.cycles = ctrl_comp.finish_cycle;
+    result.events = kernel.events;
+    result.active_cycles = kernel.active_cycles;
+    result.mem_stall_cycles = ctrl_comp.mem_stall_cycles;
+    result.psums.assign(mem.mem.begin() + psum_base, mem.mem.end());
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    LinearShapeParam shape;
+    shape.B = argc >= 2 ? atoi(argv[1]) : 16;
+    shape.in_features = 4 * 18 * 6;
+    shape.out_features = 64;
+    shape.datapath = DP_U8;
+    // 6 x 8 PE array: 兩組各 3 row，一次 8 個 PE column
+    EyerissMappingParam map = {3, 8, 2, 4, 6, 8};
+    // (memory latency, outstanding): 不 pipeline / latency 長的時候閒置的 cycle 多
+    vector<pair<int, int>> configs = {{10, 8}, {10, 1}, {100, 16}, {100, 1}};
+    if (argc >= 4)
+        configs = {{atoi(argv[2]), atoi(argv[3])}};
+
+    cout << "GEMM " << shape.B << " x " << shape.in_features << " x " << shape.out_features << endl << endl;
+    cout << left << setw(10) << "latency" << setw(8) << "outst" << setw(10) << "mode" << right << setw(12) << "cycles"
+         << setw(12) << "ticks" << setw(14) << "active cyc" << setw(12) << "mem stall" << setw(12) << "time (ms)"
+         << setw(16) << "sim cycles/s" << setw(10) << "speedup" << endl;
+    bool all_match = true;
+    for (pair<int, int> config : configs)
+    {
+        BenchResult event = run_once(false, shape, map, config.first, config.second);
+        BenchResult naive = run_once(true, shape, map, config.first, config.second);
+        bool match = event.cycles == naive.cycles && event.psums == naive.psums;
+        all_match = all_match && match;
+        for (int i = 0; i < 2; i++)
+        {
+            const BenchResult& r = i == 0 ? event : naive;
+            cout << left << setw(10) << config.first << setw(8) << config.second << setw(10) << (i == 0 ? "event" : "lockstep")
+                 << right << setw(12) << r.cycles << setw(12) << r.events << setw(14) << r.active_cycles << setw(12)
+                 << r.mem_stall_cycles << setw(12) << fixed << setprecision(2) << r.seconds * 1e3 << setw(16)
+                 << setprecision(0) << r.cycles / r.seconds;
+            if (i == 0)
+                cout << setw(9) << setprecision(1) << naive.seconds / event.seconds << "x";
+            cout << (match ? "" : "  MISMATCH") << endl;
+        }
+    }
+    cout << endl << (all_match ? "event kernel and lockstep agree (cycles and psums)" : "MISMATCH between event and lockstep") << endl;
+    return all_match ? 0 : 1;
+}
@@ -0,0 +1,315 @@
+#pragma once
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+using namespace std;
+
+// simulator state 的 checkpoint
+// 每個有狀態的 class 有一個 template <typename Archive> void checkpoint(Archive& ar)，依序對每個欄位叫 ar.io()，
+// 存 (SnapshotWriter) 和讀 (SnapshotReader) 走同一個函式，欄位順序不會對不上
+// 檔案格式: [CheckpointHeader][payload]，payload 以 32-bit word 為單位，每 32 個 word 先寫一個 bitmask 再寫不是 0 的 word
+// (final_psums 還沒算到的部分、沒用到的 counter、long long 的高位幾乎都是 0)
+// 壓縮和寫檔在背景 thread 做，simulator 只花 serialize 的時間；先寫 path.tmp 再 rename，寫到一半被打斷時舊的檔案還在
+
+constexpr char CHECKPOINT_MAGIC[4] = {'E', 'Y', 'C', 'K'};
+constexpr uint32_t CHECKPOINT_VERSION = 2;  // 2: DMAEngine::drain_cycles
+
+struct CheckpointHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t fingerprint;   // 設定 (shape / mapping / state 的大小) 的 hash，restore 時要一樣
+    uint64_t raw_bytes;     // payload 解開後的 byte 數
+    uint64_t packed_words;  // 檔案裡 payload 的 word 數
+};
+
+// FNV-1a
+inline uint64_t checkpoint_hash(const string& s)
+{
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : s)
+    {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+class SnapshotWriter
+{
+    public:
+        vector<uint8_t> bytes;
+
+        template <typename T>
+        void io(const T& v)
+        {
+            static_assert(is_trivially_copyable<T>::value, "checkpoint field must be trivially copyable");
+            append(&v, sizeof(T));
+        }
+
+        template <typename T>
+        void io(const vector<T>& v)
+        {
+            static_assert(is_trivially_copyable<T>::value, "checkpoint field must be trivially copyable");
+            io(uint64_t(v.size()));
+            append(v.data(), v.size() * sizeof(T));
+        }
+
+        void io(const string& s)
+        {
+            io(uint64_t(s.size()));
+            append(s.data(), s.size());
+        }
+
+    private:
+        void append(const void* p, size_t n)
+        {
+            const uint8_t* b = static_cast<const uint8_t*>(p);
+            bytes.insert(bytes.end(), b, b + n);
+        }
+};
+
+// 讀超過 payload 時 ok = false (後面的欄位不動)
+class SnapshotReader
+{
+    public:
+        bool ok = true;
+
+        SnapshotReader(const vector<uint8_t>& bytes) : bytes(bytes) {}
+
+        template <typename T>
+        void io(T& v)
+        {
+            take(&v, sizeof(T));
+        }
+
+        template <typename T>
+        void io(vector<T>& v)
+        {
+            uint64_t n = 0;
+            io(n);
+            if (!ok || n > (bytes.size() - pos) / sizeof(T))
+            {
+                ok = false;
+                return;
+            }
+            v.resize(n);
+            take(v.data(), n * sizeof(T));
+        }
+
+        void io(string& s)
+        {
+            uint64_t n = 0;
+            io(n);
+            if (!ok || n > bytes.size() - pos)
+            {
+                ok = false;
+                return;
+            }
+            s.assign(reinterpret_cast<const char*>(bytes.data() + pos), n);
+            pos += n;
+        }
+
+        // 全部讀完而且剛好用完
+        bool done() const
+        {
+            return ok && pos == bytes.size();
+        }
+
+    private:
+        const vector<uint8_t>& bytes;
+        size_t pos = 0;
+
+        void take(void* p, size_t n)
+        {
+            if (!ok || n > bytes.size() - pos)
+            {
+                ok = false;
+                return;
+            }
+            memcpy(p, bytes.data() + pos, n);
+            pos += n;
+        }
+};
+
+// 每 32 個 word: bitmask (bit i = 第 i 個 word 不是 0) + 不是 0 的 word
+inline vector<uint32_t> checkpoint_pack(const vector<uint8_t>& raw)
+{
+    size_t n = (raw.size() + 3) / 4;
+    vector<uint32_t> words(n, 0);
+    if (!raw.empty())
+        memcpy(words.data(), raw.data(), raw.size());
+    vector<uint32_t> packed;
+    packed.reserve(n + n / 32 + 1);
+    for (size_t i = 0; i < n; i += 32)
+    {
+        size_t mask_at = packed.size();
+        packed.push_back(0);
+        uint32_t mask = 0;
+        for (size_t k = 0; k < 32 && i + k < n; k++)
+        {
+            if (words[i + k] != 0)
+            {
+                mask |= 1u << k;
+                packed.push_back(words[i + k]);
+            }
+        }
+        packed[mask_at] = mask;
+    }
+    return packed;
+}
+
+inline bool checkpoint_unpack(const vector<uint32_t>& packed, size_t raw_bytes, vector<uint8_t>& raw)
+{
+    size_t n = (raw_bytes + 3) / 4;
+    vector<uint32_t> words(n, 0);
+    size_t p = 0;
+    for (size_t i = 0; i < n; i += 32)
+    {
+        if (p == packed.size())
+            return false;
+        uint32_t mask = packed[p++];
+        for (size_t k = 0; k < 32; k++)
+        {
+            if ((mask >> k & 1) == 0)
+                continue;
+            if (i + k >= n || p == packed.size())
+                return false;
+            words[i + k] = packed[p++];
+        }
+    }
+    if (p != packed.size())
+        return false;
+    raw.assign(raw_bytes, 0);
+    if (raw_bytes > 0)
+        memcpy(raw.data(), words.data(), raw_bytes);
+    return true;
+}
+
+// 背景 thread 寫 checkpoint，同時只有一個在寫 (下一個 submit 時還沒寫完就等)
+class CheckpointWriter
+{
+    public:
+        // counter (finish() 之後才讀)
+        long long snapshots = 0;
+        long long raw_bytes = 0;
+        long long stored_bytes = 0;
+        double serialize_seconds = 0;  // simulator thread 上 serialize 的時間 (caller 加)
+        double wait_seconds = 0;       // simulator 等上一個寫完
+        double write_seconds = 0;      // 背景 thread 壓縮 + 寫檔
+        bool failed = false;
+
+        CheckpointWriter() {}
+        ~CheckpointWriter()
+        {
+            finish();
+        }
+
+        CheckpointWriter(const CheckpointWriter&) = delete;
+        CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+        void submit(const string& path, uint64_t fingerprint, vector<uint8_t>&& payload)
+        {
+            auto start = chrono::steady_clock::now();
+            finish();
+            wait_seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            pending = move(payload);
+            snapshots++;
+            raw_bytes += (long long)pending.size();
+            writer = thread([this, path, fingerprint] { write_file(path, fingerprint); });
+        }
+
+        // 等背景 thread 寫完
+        void finish()
+        {
+            if (writer.joinable())
+                writer.join();
+        }
+
+        void print_stats(ostream& os)
+        {
+            finish();
+            if (snapshots == 0)
+                return;
+            os << "Checkpoint: " << snapshots << " snapshots, " << raw_bytes / snapshots / 1024 << " KB raw -> "
+               << stored_bytes / snapshots / 1024 << " KB stored each (" << fixed << setprecision(1)
+               << 100.0 * stored_bytes / max(1LL, raw_bytes) << "%), serialize " << setprecision(3)
+               << serialize_seconds * 1e3 << " ms + wait " << wait_seconds * 1e3 << " ms on the simulator thread, background write "
+               << write_seconds * 1e3 << " ms" << defaultfloat << setprecision(6) << (failed ? " (WRITE FAILED)" : "") << endl;
+        }
+
+        // 讀整個檔案並檢查 header，回傳解開的 payload
+        static bool read(const string& path, uint64_t fingerprint, vector<uint8_t>& payload)
+        {
+            FILE* file = fopen(path.c_str(), "rb");
+            if (file == nullptr)
+            {
+                cerr << "Checkpoint Error: cannot open " << path << endl;
+                return false;
+            }
+            CheckpointHeader header;
+            bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, CHECKPOINT_MAGIC, 4) == 0
+                      && header.version == CHECKPOINT_VERSION;
+            if (!ok)
+                cerr << "Checkpoint Error: " << path << " is not a checkpoint (version " << CHECKPOINT_VERSION << ")" << endl;
+            else if (header.fingerprint != fingerprint)
+            {
+                cerr << "Checkpoint Error: " << path << " was written for a different shape / mapping / hardware" << endl;
+                ok = false;
+            }
+            vector<uint32_t> packed;
+            if (ok)
+            {
+                packed.resize(header.packed_words);
+                ok = fread(packed.data(), sizeof(uint32_t), packed.size(), file) == packed.size()
+                     && checkpoint_unpack(packed, header.raw_bytes, payload);
+                if (!ok)
+                    cerr << "Checkpoint Error: " << path << " is truncated or corrupt" << endl;
+            }
+            fclose(file);
+            return ok;
+        }
+
+    private:
+        thread writer;
+        vector<uint8_t> pending;
+
+        void write_file(const string& path, uint64_t fingerprint)
+        {
+            auto start = chrono::steady_clock::now();
+            vector<uint32_t> packed = checkpoint_pack(pending);
+            CheckpointHeader header;
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, CHECKPOINT_MAGIC, 4);
+            header.version = CHECKPOINT_VERSION;
+            header.fingerprint = fingerprint;
+            header.raw_bytes = pending.size();
+            header.packed_words = packed.size();
+            string tmp = path + ".tmp";
+            FILE* file = fopen(tmp.c_str(), "wb");
+            bool ok = file != nullptr;
+            if (ok)
+            {
+                ok = fwrite(&header, sizeof(header), 1, file) == 1
+                     && fwrite(packed.data(), sizeof(uint32_t), packed.size(), file) == packed.size();
+                ok = fclose(file) == 0 && ok;
+                ok = ok && rename(tmp.c_str(), path.c_str()) == 0;
+            }
+            if (!ok)
+            {
+                cerr << "Checkpoint Error: cannot write " << path << endl;
+                failed = true;
+            }
+            stored_bytes += (long long)(sizeof(header) + packed.size() * sizeof(uint32_t));
+            write_seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        }
+};
@@ -1,8 +1,378 @@
+#pragma once
+
 #include <iostream>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include "../analayzer/data_type.h"
 
 using namespace std;
 
+// tile loop 的 microcode controller
+// compile() 依 EyerissMappingParam 把 out_feature / in_feature / batch 三層 tiling 和 PE array 裡的 m / n / k 展開成
+// 一串 MicroOp，tensor index 在這時候就算好，simulator 只要依序執行 (不用每次再算 loop index)
+// 外三層的順序由 loop_order 決定 ("oib" = out_feature -> in_feature -> batch，和原本手寫的 loop 一樣)
+
+enum MicroOpCode
+{
+    UOP_LOAD_PSUM = 0, // 從 GLB 讀回上一個 in_feature tile 的 psum
+    UOP_LOAD_IF,       // ifmap 填進 spad
+    UOP_LOAD_W,        // weight 填進 spad
+    UOP_COMPUTE,       // swap spad + 一個 k tile 的 MAC
+    UOP_ACC_PSUM,      // 等 compute 完，psum 經過 reduction network 累加
+    UOP_STORE_PSUM,    // psum 寫回 GLB
+    UOP_DMA_W,         // DRAM -> GLB weight tile (發出，id 放在 slot)
+    UOP_DMA_IF,        // DRAM -> GLB ifmap tile
+    UOP_DMA_STORE,     // GLB -> DRAM 結果
+    UOP_DMA_WAIT,      // 等 slot 的 transfer
+    UOP_DRAM,          // 沒有 tile DRAM model 時固定的 DRAM cycle
+    UOP_BARRIER,       // 等所有 DMA 做完
+    UOP_COUNT,
+};
+
+// 欄位的意思依 op 而定:
+//   LOAD_PSUM / STORE_PSUM   a = psum index (b + m 那個 row 的 outf + n)，b = out column (outf + n)
+//   LOAD_IF                  a = ifmap index ((b + m) row 的 inf + k)
+//   LOAD_W                   a = weight index ((inf + k) row 的 outf + n)，b = out column
+//   DMA_W                    a = outf，b = inf
+//   DMA_IF                   b = inf，c = batch
+//   DMA_STORE                a = outf，c = batch，d = batch 數
+//   DRAM                     a = cycle
+struct MicroOp
+{
+    uint8_t op;
+    uint8_t slot;  // DMA / DMA_WAIT 的 transfer slot
+    int32_t a;
+    int32_t b;
+    int32_t c;
+    int32_t d;
+};
+
+enum ControllerDRAM
+{
+    CTRL_DRAM_NONE = 0,  // 不算 DRAM (GEMM_no_mem)
+    CTRL_DRAM_FLAT,      // 原本每層 loop 固定的 DRAM cycle
+    CTRL_DRAM_TILE,      // 每個 tile 一個 DMA transfer
+};
+
+struct ControllerConfig
+{
+    string loop_order = "oib";
+    int dram = CTRL_DRAM_NONE;   // ControllerDRAM
+    bool prefetch = false;       // CTRL_DRAM_TILE 時下一個 tile 的 DMA 提早發出
+    int dram_word_cycles = 5;    // CTRL_DRAM_FLAT 每個 word 的 cycle
+    // 只產生 output tile [tile_begin, tile_end) 的 op (-1 = 到最後)，平行模擬時每個 worker 一段
+    // output tile 的編號 = out_feature tile * batch tile 數 + batch tile (見 controller::output_tiles())
+    // 不屬於單一 output tile 的 op (外層 loop 的 DRAM cycle) 給 "還沒定下來的 index 都是 0" 的那個 tile
+    int tile_begin = 0;
+    int tile_end = -1;
+    // in_feature tile 也可以只取一段 [inf_begin, inf_end) (sampled simulation 一次跑一個 (output tile, in_feature tile))
+    int inf_begin = 0;
+    int inf_end = -1;
+};
+
+inline const char* uop_name(int op)
+{
+    static const char* names[UOP_COUNT] = {"LOAD_PSUM", "LOAD_IF", "LOAD_W", "COMPUTE", "ACC_PSUM", "STORE_PSUM",
+                                           "DMA_W", "DMA_IF", "DMA_STORE", "DMA_WAIT", "DRAM", "BARRIER"};
+    return op >= 0 && op < UOP_COUNT ? names[op] : "?";
+}
+
 class controller
 {
-    
-};
\ No newline at end of file
+    public:
+        static constexpr int SLOT_W = 0;      // weight 用 slot 0 / 1 (prefetch 時輪流)
+        static constexpr int SLOT_IF = 2;     // ifmap 用 slot 2 / 3
+        static constexpr int SLOT_STORE = 4;
+        static constexpr int NUM_SLOTS = 5;
+
+        vector<MicroOp> program;
+        long long op_count[UOP_COUNT] = {0};
+        long long op_total = 0;
+        // 有設定時 compile() 不存 program，每個 op 直接交給 sink (fast mode 不用放整個 program)
+        function<void(const MicroOp&)> sink;
+
+        // loop_order: 'o' / 'i' / 'b' 各出現一次
+        static bool valid_order(const string& order)
+        {
+            string s = order;
+            sort(s.begin(), s.end());
+            return s == "bio";
+        }
+
+        // in_div4: 一個 row 的 packed word 數，ifmap_size / weight_h: PE 的 spad 大小
+        bool compile(const EyerissMappingParam& map, const LinearShapeParam& shape, int in_div4, int ifmap_size, int weight_h,
+                     const ControllerConfig& config = ControllerConfig())
+        {
+            if (!valid_order(config.loop_order))
+            {
+                cerr << "Controller Error: loop order " << config.loop_order << " (need a permutation of o / i / b)" << endl;
+                return false;
+            }
+            this->map = map;
+            this->shape = shape;
+            this->in_div4 = in_div4;
+            this->ifmap_size = ifmap_size;
+            this->weight_h = weight_h;
+            this->config = config;
+            for (int l = 0; l < 3; l++)
+                order[l] = config.loop_order[l] == 'o' ? DIM_OUTF : config.loop_order[l] == 'i' ? DIM_INF : DIM_B;
+            extent[DIM_OUTF] = shape.out_features;
+            extent[DIM_INF] = in_div4;
+            extent[DIM_B] = shape.B;
+            step[DIM_OUTF] = map.N * weight_h;
+            step[DIM_INF] = map.K * ifmap_size;
+            step[DIM_B] = map.M;
+
+            // 第一遍只收集 DMA tile 的順序 (prefetch 要知道下一個是誰)，第二遍才產生 program
+            w_tiles.clear();
+            if_tiles.clear();
+            program.clear();
+            fill(op_count, op_count + UOP_COUNT, 0);
+            op_total = 0;
+            for (int pass = 0; pass < 2; pass++)
+            {
+                collect = pass == 0;
+                w_next = if_next = 0;
+                int idx[3] = {0, 0, 0};
+                inf_done.assign((size_t)tiles(DIM_OUTF) * tiles(DIM_B), 0);
+                stored.assign(inf_done.size(), false);
+                emit_level(0, idx);
+            }
+            if (config.dram == CTRL_DRAM_TILE)
+                push(UOP_BARRIER);
+            return true;
+        }
+
+        // out_feature tile 數 x batch tile 數 (tile_begin / tile_end 的範圍)
+        int output_tiles() const
+        {
+            return tiles(DIM_OUTF) * tiles(DIM_B);
+        }
+
+        int inf_tiles() const
+        {
+            return tiles(DIM_INF);
+        }
+
+        void print_stats(ostream& os) const
+        {
+            os << "Controller: loop order " << config.loop_order << ", " << op_total << " micro-ops ("
+               << (program.size() < size_t(op_total) ? "streamed" : to_string(program.size() * sizeof(MicroOp) / 1024) + " KB") << ")";
+            for (int op = 0; op < UOP_COUNT; op++)
+            {
+                if (op_count[op] > 0)
+                    os << ", " << uop_name(op) << " " << op_count[op];
+            }
+            os << endl;
+        }
+
+        // 前 count 個 micro-op (debug 用)
+        void disassemble(ostream& os, size_t count = 64) const
+        {
+            for (size_t i = 0; i < min(count, program.size()); i++)
+            {
+                const MicroOp& op = program[i];
+                os << i << ": " << uop_name(op.op) << " slot " << int(op.slot) << " a " << op.a << " b " << op.b
+                   << " c " << op.c << " d " << op.d << endl;
+            }
+        }
+
+    private:
+        enum { DIM_OUTF = 0, DIM_INF, DIM_B };
+
+        EyerissMappingParam map;
+        LinearShapeParam shape;
+        int in_div4 = 0;
+        int ifmap_size = 0;
+        int weight_h = 0;
+        ControllerConfig config;
+        int order[3];
+        int extent[3];
+        int step[3];
+
+        bool collect = false;
+        vector<pair<int, int>> w_tiles;   // (outf, inf)
+        vector<pair<int, int>> if_tiles;  // (inf, b)
+        size_t w_next = 0;
+        size_t if_next = 0;
+        vector<int> inf_done;   // [outf tile][b tile] 做完幾個 in_feature tile
+        vector<bool> stored;
+
+        int tiles(int dim) const
+        {
+            return (extent[dim] + step[dim] - 1) / step[dim];
+        }
+
+        int level_of(int dim) const
+        {
+            for (int l = 0; l < 3; l++)
+            {
+                if (order[l] == dim)
+                    return l;
+            }
+            return -1;
+        }
+
+        void push(int op, int a = 0, int b = 0, int c = 0, int d = 0, int slot = 0)
+        {
+            if (collect)
+                return;
+            op_count[op]++;
+            op_total++;
+            if (sink)
+                sink(MicroOp{uint8_t(op), uint8_t(slot), a, b, c, d});
+            else
+                program.push_back(MicroOp{uint8_t(op), uint8_t(slot), a, b, c, d});
+        }
+
+        // 第 k 個 tile transfer: 沒 prefetch 時發出後馬上等；prefetch 時等這個 (第一個才自己發)，再發下一個
+        template <typename Issue>
+        void fetch(int base_slot, size_t k, size_t count, Issue issue)
+        {
+            int slot = base_slot + int(k % 2);
+            if (!config.prefetch || k == 0)
+                issue(k, slot);
+            push(UOP_DMA_WAIT, 0, 0, 0, 0, slot);
+            if (config.prefetch && k + 1 < count)
+                issue(k + 1, base_slot + int((k + 1) % 2));
+        }
+
+        void fetch_weight(int outf, int inf)
+        {
+            if (collect)
+            {
+                w_tiles.push_back({outf, inf});
+                return;
+            }
+            fetch(SLOT_W, w_next++, w_tiles.size(), [&](size_t k, int slot)
+                  { push(UOP_DMA_W, w_tiles[k].first, w_tiles[k].second, 0, 0, slot); });
+        }
+
+        void fetch_ifmap(int inf, int b)
+        {
+            if (collect)
+            {
+                if_tiles.push_back({inf, b});
+                return;
+            }
+            fetch(SLOT_IF, if_next++, if_tiles.size(), [&](size_t k, int slot)
+                  { push(UOP_DMA_IF, 0, if_tiles[k].first, if_tiles[k].second, 0, slot); });
+        }
+
+        void dram_cycles(long long words)
+        {
+            push(UOP_DRAM, int(words * config.dram_word_cycles));
+        }
+
+        // level 以上 (含) 的 loop index 定下來時，這裡的 op 屬於 config 的 tile 範圍嗎
+        bool selected(int level, const int idx[3]) const
+        {
+            int outf = level_of(DIM_OUTF) <= level ? idx[DIM_OUTF] / step[DIM_OUTF] : 0;
+            int b = level_of(DIM_B) <= level ? idx[DIM_B] / step[DIM_B] : 0;
+            int inf = level_of(DIM_INF) <= level ? idx[DIM_INF] / step[DIM_INF] : 0;
+            int t = outf * tiles(DIM_B) + b;
+            return t >= config.tile_begin && (config.tile_end < 0 || t < config.tile_end) && inf >= config.inf_begin
+                   && (config.inf_end < 0 || inf < config.inf_end);
+        }
+
+        void emit_level(int level, int idx[3])
+        {
+            int dim = order[level];
+            for (int v = 0; v < extent[dim]; v += step[dim])
+            {
+                idx[dim] = v;
+                bool flat = config.dram == CTRL_DRAM_FLAT && selected(level, idx);
+                // loop 開頭: DRAM tile 在它用到的兩個 index 都定下來的那一層搬
+                if (flat && dim == DIM_OUTF)
+                {
+                    dram_cycles((long long)shape.B * map.N * weight_h); // weight
+                    dram_cycles((long long)map.K * ifmap_size * map.M); // input feature
+                }
+                if (config.dram == CTRL_DRAM_TILE)
+                {
+                    if (level == max(level_of(DIM_OUTF), level_of(DIM_INF)) && (dim == DIM_OUTF || dim == DIM_INF))
+                        fetch_weight(idx[DIM_OUTF], idx[DIM_INF]);
+                    if (level == max(level_of(DIM_INF), level_of(DIM_B)) && (dim == DIM_INF || dim == DIM_B))
+                        fetch_ifmap(idx[DIM_INF], idx[DIM_B]);
+                }
+
+                if (level < 2)
+                    emit_level(level + 1, idx);
+                else
+                    emit_tile(idx[DIM_OUTF], idx[DIM_INF], idx[DIM_B]);
+
+                // loop 結尾
+                if (flat && dim == DIM_B)
+                    dram_cycles((long long)map.K * ifmap_size * map.M); // input feature
+                if (flat && dim == DIM_INF)
+                {
+                    dram_cycles((long long)map.K * ifmap_size * map.M);                 // input feature
+                    dram_cycles((long long)map.K * ifmap_size * map.N * weight_h);      // weight
+                }
+                if (config.dram == CTRL_DRAM_TILE && level == 0)
+                    store_finished();
+            }
+        }
+
+        // 最外層每跑完一次，把 in_feature 都做完的 (outf, b) 結果寫回 DRAM，同一個 outf 連續的 batch 合成一個 transfer
+        void store_finished()
+        {
+            int b_tiles = tiles(DIM_B);
+            for (int o = 0; o < tiles(DIM_OUTF); o++)
+            {
+                int first = -1;
+                for (int t = 0; t <= b_tiles; t++)
+                {
+                    size_t id = (size_t)o * b_tiles + t;
+                    bool ready = t < b_tiles && !stored[id] && inf_done[id] == tiles(DIM_INF);
+                    if (ready)
+                    {
+                        stored[id] = true;
+                        if (first < 0)
+                            first = t;
+                        continue;
+                    }
+                    if (first >= 0)
+                    {
+                        int b = first * step[DIM_B];
+                        int rows = min(t * step[DIM_B], shape.B) - b;
+                        push(UOP_DMA_STORE, o * step[DIM_OUTF], 0, b, rows, SLOT_STORE);
+                        if (!config.prefetch)
+                            push(UOP_DMA_WAIT, 0, 0, 0, 0, SLOT_STORE);
+                        first = -1;
+                    }
+                }
+            }
+        }
+
+        // PE array 上的 m / n / k (和 psum 的累加順序綁在一起，順序固定)
+        void emit_tile(int outf, int inf, int b)
+        {
+            int idx[3] = {outf, inf, b};
+            if (!selected(2, idx))
+                return;
+            inf_done[(size_t)(outf / step[DIM_OUTF]) * tiles(DIM_B) + b / step[DIM_B]]++;
+            if (collect)
+                return;
+            for (int m = 0; m < map.M; m += map.mode)
+            {
+                for (int n = 0; n < map.N * weight_h; n += map.tn * weight_h)
+                {
+                    int psum_index = (b + m) * shape.out_features + outf + n;
+                    if (inf != 0)
+                        push(UOP_LOAD_PSUM, psum_index, outf + n);
+                    for (int k = 0; k < map.K * ifmap_size; k += map.tk * ifmap_size)
+                    {
+                        push(UOP_LOAD_IF, (b + m) * in_div4 + inf + k);
+                        push(UOP_LOAD_W, (inf + k) * shape.out_features + outf + n, outf + n);
+                        push(UOP_COMPUTE);
+                    }
+                    push(UOP_ACC_PSUM);
+                    push(UOP_STORE_PSUM, psum_index, outf + n);
+                }
+            }
+        }
+};
@@ -0,0 +1,382 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <functional>
+#include <climits>
+#include <cstdint>
+#include "MEM/memory.cpp"
+#include "PE/pe_array.cpp"
+#include "controller.cpp"
+
+using namespace std;
+
+// Discrete-event simulation kernel
+// 每個 component 的 tick(now) 做完這個 cycle 的事，回傳下一次要被叫的 cycle (SIM_NEVER = 等別人 wake)
+// kernel 只在有 event 的 cycle 叫 component，中間閒置的 cycle 直接跳過
+// run_lockstep() 是對照組: 每個 cycle 叫所有 component (component 被早叫時要什麼都不做)
+// 同一個 cycle 裡照 schedule 的順序執行 (FIFO)
+
+constexpr long long SIM_NEVER = LLONG_MAX;
+
+class EventKernel;
+
+class SimComponent
+{
+    public:
+        string name;
+        EventKernel* kernel = nullptr;
+        int id = -1;
+
+        SimComponent(const string& name) : name(name) {}
+        virtual ~SimComponent() {}
+
+        virtual long long tick(long long now) = 0;
+};
+
+class EventKernel
+{
+    public:
+        long long now = 0;
+
+        // counter
+        long long events = 0;          // 執行的 event 數 (tick + callback)
+        long long stale_events = 0;    // 已經被更早的 wake 取代的 event
+        long long active_cycles = 0;   // 有 event 的 cycle 數
+
+        int add(SimComponent* c)
+        {
+            c->kernel = this;
+            c->id = int(components.size());
+            components.push_back(c);
+            next_time.push_back(SIM_NEVER);
+            wake(c->id, now);
+            return c->id;
+        }
+
+        // component id 最晚在 t 被叫 (已經排了更早的就不用再排)
+        void wake(int id, long long t)
+        {
+            t = max(t, now);
+            if (t >= next_time[id])
+                return;
+            next_time[id] = t;
+            queue.push(Event{t, seq++, id});
+        }
+
+        // one-shot callback
+        void schedule(long long t, function<void()> fn)
+        {
+            callbacks.push_back(move(fn));
+            queue.push(Event{max(t, now), seq++, -int(callbacks.size())});
+        }
+
+        bool idle() const
+        {
+            return queue.empty();
+        }
+
+        // 跑到沒有 event 或超過 until，回傳最後的 cycle
+        long long run(long long until = SIM_NEVER)
+        {
+            long long last_active = -1;
+            while (!queue.empty() && queue.top().time <= until)
+            {
+                Event e = queue.top();
+                queue.pop();
+                if (e.target >= 0 && next_time[e.target] != e.time)
+                {
+                    stale_events++;
+                    continue;
+                }
+                now = e.time;
+                if (now != last_active)
+                {
+                    active_cycles++;
+                    last_active = now;
+                }
+                events++;
+                if (e.target < 0)
+                {
+                    function<void()> fn = move(callbacks[-e.target - 1]);
+                    fn();
+                    continue;
+                }
+                next_time[e.target] = SIM_NEVER;
+                long long next = components[e.target]->tick(now);
+                if (next != SIM_NEVER)
+                    wake(e.target, next);
+            }
+            return now;
+        }
+
+        // 對照組: 每個 cycle 依序 tick 所有 component，直到 done() 為 true
+        long long run_lockstep(function<bool()> done, long long until = SIM_NEVER)
+        {
+            queue = priority_queue<Event, vector<Event>, greater<Event>>();
+            while (!done() && now < until)
+            {
+                for (SimComponent* c : components)
+                {
+                    c->tick(now);
+                    events++;
+                }
+                active_cycles++;
+                now++;
+            }
+            return now;
+        }
+
+    private:
+        struct Event
+        {
+            long long time;
+            long long seq;
+            int target;  // component id，負的是 callbacks[-target - 1]
+
+            bool operator>(const Event& o) const
+            {
+                return time != o.time ? time > o.time : seq > o.seq;
+            }
+        };
+
+        vector<SimComponent*> components;
+        vector<long long> next_time;   // 每個 component 排定的下一次 tick
+        vector<function<void()>> callbacks;
+        priority_queue<Event, vector<Event>, greater<Event>> queue;
+        long long seq = 0;
+};
+
+// ===== component adapter =====
+
+// memory: 在最早的 ready cycle 醒來，有 response 就叫醒 listener
+class MemoryComponent : public SimComponent
+{
+    public:
+        memory& mem;
+        int listener = -1;
+
+        MemoryComponent(memory& mem) : SimComponent("memory"), mem(mem) {}
+
+        long long tick(long long now) override
+        {
+            mem.step_to(now);
+            if (listener >= 0 && mem.has_response())
+                kernel->wake(listener, now);
+            long long t = mem.next_ready_cycle();
+            return t < 0 ? SIM_NEVER : t;
+        }
+
+        // 發 request 前把 memory 的 clock 對到 now
+        void sync(long long now)
+        {
+            mem.step_to(now);
+        }
+
+        // 發完 request 後排下一次完成
+        void issued()
+        {
+            kernel->wake(id, mem.next_ready_cycle());
+        }
+};
+
+// PE array: start() 之後所有 PE busy，event 模式一次跳到最近一個 PE 做完 (PE_Array::advance)，
+// lockstep 時每個 cycle 前進一個 MAC；全部 idle 時叫醒 listener
+class PEArrayComponent : public SimComponent
+{
+    public:
+        PE_Array& array;
+        int listener = -1;
+        long long compute_cycles = 0;
+
+        PEArrayComponent(PE_Array& array) : SimComponent("pe_array"), array(array) {}
+
+        void start(long long now)
+        {
+            array.start_step();
+            last = now;
+            running = true;
+            kernel->wake(id, now);
+        }
+
+        bool running_compute() const
+        {
+            return running;
+        }
+
+        long long tick(long long now) override
+        {
+            if (!running)
+                return SIM_NEVER;
+            if (now > last)
+            {
+                array.advance(int(now - last));
+                compute_cycles += now - last;
+                last = now;
+            }
+            int dt = array.next_event();
+            while (dt == 0) // GATE_SKIP: 剩下的 lane 全是 0，不花 cycle
+            {
+                array.advance(0);
+                dt = array.next_event();
+            }
+            if (dt > 0)
+                return now + dt;
+            running = false;
+            if (listener >= 0)
+                kernel->wake(listener, now);
+            return SIM_NEVER;
+        }
+
+    private:
+        long long last = 0;
+        bool running = false;
+};
+
+// controller 的 micro-op 在 memory / PE array 上實際跑一次 (不看 DMA 的 op)
+// 每個 LOAD / STORE 變成一串 memory request (一個 cycle 發一個，memory 允許就 pipeline)，
+// 全部回來才做下一個 op；COMPUTE 啟動 PE array 等它做完；ACC_PSUM 花 acc_cycles
+struct MemTransfer
+{
+    int address;
+    bool is_write;
+    int32_t data;          // write 的資料
+    int32_t* dst;          // read 回來寫到 dst[0], dst[stride], ... (nullptr = 只算 timing)
+    int dst_count;
+    int dst_stride;
+};
+
+class ControllerComponent : public SimComponent
+{
+    public:
+        const vector<MicroOp>& program;
+        MemoryComponent& mem;
+        PEArrayComponent& pe;
+        function<void(const MicroOp&, vector<MemTransfer>&)> transfers;  // op 要搬的資料
+        int acc_cycles;
+
+        size_t pc = 0;
+        bool done = false;
+        long long finish_cycle = 0;
+        long long mem_stall_cycles = 0;   // 等 memory response 的 cycle
+
+        ControllerComponent(const vector<MicroOp>& program, MemoryComponent& mem, PEArrayComponent& pe,
+                            function<void(const MicroOp&, vector<MemTransfer>&)> transfers, int acc_cycles)
+            : SimComponent("controller"), program(program), mem(mem), pe(pe), transfers(transfers), acc_cycles(acc_cycles)
+        {
+        }
+
+        long long tick(long long now) override
+        {
+            if (done || now < resume_at)
+                return done ? SIM_NEVER : resume_at;
+            mem.sync(now);
+            MemRequest r;
+            while (mem.mem.pop_response(r))
+            {
+                const MemTransfer& t = pending[r.id - id_base];
+                if (!r.is_write && t.dst != nullptr)
+                {
+                    for (int k = 0; k < t.dst_count; k++)
+                        t.dst[k * t.dst_stride] = r.data;
+                }
+                waiting--;
+            }
+            while (pc < program.size())
+            {
+                const MicroOp& op = program[pc];
+                if (state == OP_START)
+                {
+                    if (!begin(op, now))
+                        return resume_at;
+                    continue;
+                }
+                if (state == OP_MEMORY)
+                {
+                    if (issued < int(pending.size()))
+                    {
+                        const MemTransfer& t = pending[issued];
+                        int rid = t.is_write ? mem.mem.issue_write(t.address, t.data) : mem.mem.issue_read(t.address);
+                        if (rid >= 0)
+                        {
+                            if (issued == 0)
+                                id_base = rid;
+                            issued++;
+                            mem.issued();
+                        }
+                        else if (mem.mem.outstanding() >= mem.mem.max_outstanding)
+                        {
+                            return SIM_NEVER;  // queue 滿了，有 request 完成時 memory 會叫醒
+                        }
+                        resume_at = now + 1;  // 一個 cycle 發一個
+                        return resume_at;
+                    }
+                    if (waiting > 0)
+                    {
+                        wait_since = wait_since < 0 ? now : wait_since;
+                        return SIM_NEVER;  // memory 有 response 會叫醒
+                    }
+                    if (wait_since >= 0)
+                        mem_stall_cycles += now - wait_since;
+                    wait_since = -1;
+                }
+                else if (state == OP_COMPUTE && pe.running_compute())
+                {
+                    return SIM_NEVER;  // PE array 做完會叫醒
+                }
+                else if (state == OP_DELAY && now < resume_at)
+                {
+                    return resume_at;
+                }
+                state = OP_START;
+                pc++;
+            }
+            done = true;
+            finish_cycle = now;
+            return SIM_NEVER;
+        }
+
+    private:
+        enum { OP_START, OP_MEMORY, OP_COMPUTE, OP_DELAY };
+
+        int state = OP_START;
+        long long resume_at = 0;
+        vector<MemTransfer> pending;
+        int issued = 0;
+        int waiting = 0;
+        int id_base = 0;
+        long long wait_since = -1;
+
+        // 開始一個 op，回傳 false 代表這個 cycle 不能再往下
+        bool begin(const MicroOp& op, long long now)
+        {
+            switch (op.op)
+            {
+                case UOP_LOAD_PSUM:
+                case UOP_LOAD_IF:
+                case UOP_LOAD_W:
+                case UOP_STORE_PSUM:
+                    pending.clear();
+                    transfers(op, pending);
+                    issued = 0;
+                    waiting = int(pending.size());
+                    state = OP_MEMORY;
+                    return true;
+                case UOP_COMPUTE:
+                    pe.array.swap_spads();
+                    pe.start(now);
+                    state = OP_COMPUTE;
+                    return true;
+                case UOP_ACC_PSUM:
+                    pe.array.out_valid_all();
+                    pe.array.add_ipsum_all();
+                    state = OP_DELAY;
+                    resume_at = now + acc_cycles;
+                    return false;
+                default:
+                    state = OP_DELAY;  // DMA / DRAM / BARRIER 不在這裡模擬
+                    return true;
+            }
+        }
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+// sampled simulation 的統計: 每一類 (stratum) 抽幾個 unit 跑，依類別大小外插總和
+// stratified sampling (不放回)，類別裡的 variance 加 finite population correction，
+// confidence interval 用 normal 近似 (z = 1.96 是 95%)
+
+// 一類抽到的值 (Welford，cycle 很大時也不會掉精度)
+struct SampleStat
+{
+    long long n = 0;
+    double mean = 0;
+    double m2 = 0;
+    double lo = 0;
+    double hi = 0;
+
+    void add(double v)
+    {
+        lo = n == 0 ? v : min(lo, v);
+        hi = n == 0 ? v : max(hi, v);
+        n++;
+        double d = v - mean;
+        mean += d / double(n);
+        m2 += d * (v - mean);
+    }
+
+    // sample variance (n - 1)
+    double variance() const
+    {
+        return n > 1 ? m2 / double(n - 1) : 0.0;
+    }
+
+    double range() const
+    {
+        return hi - lo;
+    }
+};
+
+// 沒抽完的類別抽到的值全部一樣時 sample variance 是 0，但沒抽到的 unit 可能有少數不一樣
+// (例如偶爾才有的 zero gating)，CI 不能縮成 +-0:
+//   rule of three: n 個都沒看到，不一樣的比例 95% 上限是 3 / n (最多算 0.5)，
+//   差多少用這個 metric 在所有類別看到的最大差距 (至少 1，metric 都是整數 count)
+struct StratifiedEstimate
+{
+    double total = 0;
+    double variance = 0;
+    double unseen = 0;  // 全部一樣的類別，乘上 spread^2 才是 variance
+    double spread = 1;
+
+    // population 個 unit 的一類，抽了 s.n 個 (s.n == population 時這一類是精確的)
+    void add(long long population, const SampleStat& s)
+    {
+        if (s.n == 0)
+            return;
+        double N = double(population);
+        double n = double(s.n);
+        total += N * s.mean;
+        spread = max(spread, s.range());
+        if (s.n == population)
+            return;
+        if (s.range() > 0)
+            variance += N * N * (1.0 - n / N) * s.variance() / n;
+        else
+        {
+            double p = min(0.5, 3.0 / n);
+            unseen += N * N * (1.0 - n / N) * p * (1.0 - p) / n;
+        }
+    }
+
+    double total_variance() const
+    {
+        return variance + unseen * spread * spread;
+    }
+
+    double half_width(double z = 1.96) const
+    {
+        return z * sqrt(total_variance());
+    }
+
+    bool contains(double value, double z = 1.96) const
+    {
+        return fabs(value - total) <= half_width(z);
+    }
+};
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// tile schedule 的 scoreboard (hardware.pipeline)
+// controller 的 micro-op 還是依 program 順序 "功能上" 執行 (結果和 serial 一樣)，cycle 則由 scoreboard 排:
+// 每個 stage 佔一個 unit (同一個 unit 上依序做)，讀寫的 register 決定 data dependency
+//   RAW: 讀之前要等上一個寫完        WAW / WAR: 寫之前要等上一個寫完、之前的讀都讀完
+// 所以互不相干的 stage 可以重疊，例如 tile n 的 psum 寫回 (psum NoC) 和 tile n + 1 的 weight load (weight NoC)
+// ifmap / weight / psum 各走自己的 NoC (和 Eyeriss 一樣)，但都要佔一個 GLB channel (set_capacity: bank 數 x port 數)
+// 同時在跑的 stage 搶 bank / port 由 GLB model 自己排 (access() 的 start)，scoreboard 只拿到加長的 duration
+
+enum PipeStage
+{
+    PIPE_LOAD_PSUM = 0,
+    PIPE_LOAD_IF,
+    PIPE_LOAD_W,
+    PIPE_COMPUTE,
+    PIPE_ACC_PSUM,
+    PIPE_STORE_PSUM,
+    PIPE_DRAM,         // 沒有 tile DRAM model 時固定的 DRAM cycle
+    PIPE_STAGE_COUNT,
+};
+
+enum PipeUnit
+{
+    UNIT_NOC_IF = 0,
+    UNIT_NOC_W,
+    UNIT_NOC_PSUM,   // psum 讀回和寫回共用
+    UNIT_PE,
+    UNIT_REDUCE,     // reduction network
+    UNIT_DRAM,
+    UNIT_GLB,        // GLB 的 channel，NoC stage 同時要佔一個
+    UNIT_COUNT,
+};
+
+enum PipeReg
+{
+    REG_IF_FILL = 0,  // ifmap spad (double_buffer 時是 fill 那一份)
+    REG_W_FILL,       // weight spad
+    REG_PSUM,         // PE 裡的 psum
+    REG_GLB_TILE,     // GLB 裡 DRAM 搬進來的 ifmap / weight tile
+    REG_GLB_PSUM,     // GLB 裡寫回的 psum
+    REG_COUNT,
+};
+
+constexpr unsigned pipe_reg(int r)
+{
+    return 1u << r;
+}
+
+inline const char* pipe_stage_name(int stage)
+{
+    static const char* names[PIPE_STAGE_COUNT] = {"LOAD_PSUM", "LOAD_IF", "LOAD_W", "COMPUTE", "ACC_PSUM", "STORE_PSUM", "DRAM"};
+    return stage >= 0 && stage < PIPE_STAGE_COUNT ? names[stage] : "?";
+}
+
+inline const char* pipe_unit_name(int unit)
+{
+    static const char* names[UNIT_COUNT] = {"noc_if", "noc_w", "noc_psum", "pe", "reduce", "dram", "glb"};
+    return unit >= 0 && unit < UNIT_COUNT ? names[unit] : "?";
+}
+
+struct PipeStageStat
+{
+    long long ops = 0;
+    long long busy = 0;         // 做事的 cycle
+    long long data_stall = 0;   // unit 空著但在等 operand (RAW / WAR / WAW)
+    long long unit_stall = 0;   // operand 好了但 unit 還在做前一個
+};
+
+class Scoreboard
+{
+    public:
+        PipeStageStat stage_stat[PIPE_STAGE_COUNT];
+        long long unit_busy[UNIT_COUNT] = {0};
+
+        static int unit_of(int stage)
+        {
+            static const int units[PIPE_STAGE_COUNT] = {UNIT_NOC_PSUM, UNIT_NOC_IF, UNIT_NOC_W, UNIT_PE, UNIT_REDUCE,
+                                                        UNIT_NOC_PSUM, UNIT_DRAM};
+            return units[stage];
+        }
+
+        static bool uses_glb(int stage)
+        {
+            return stage == PIPE_LOAD_PSUM || stage == PIPE_LOAD_IF || stage == PIPE_LOAD_W || stage == PIPE_STORE_PSUM;
+        }
+
+        Scoreboard()
+        {
+            for (vector<long long>& f : unit_free)
+                f.assign(1, 0);
+            reset();
+        }
+
+        // unit 可以同時做幾個 op (預設 1)
+        void set_capacity(int unit, int channels)
+        {
+            unit_free[unit].assign(max(1, channels), 0);
+        }
+
+        void reset()
+        {
+            for (PipeStageStat& s : stage_stat)
+                s = PipeStageStat();
+            fill(unit_busy, unit_busy + UNIT_COUNT, 0);
+            for (vector<long long>& f : unit_free)
+                fill(f.begin(), f.end(), 0);
+            fill(reg_ready, reg_ready + REG_COUNT, 0);
+            fill(reg_read, reg_read + REG_COUNT, 0);
+            frontier = 0;
+            finish_cycle = 0;
+        }
+
+        template <typename Archive>
+        void checkpoint(Archive& ar)
+        {
+            ar.io(stage_stat);
+            ar.io(unit_busy);
+            for (vector<long long>& f : unit_free)
+                ar.io(f);
+            ar.io(reg_ready);
+            ar.io(reg_read);
+            ar.io(frontier);
+            ar.io(finish_cycle);
+        }
+
+        // 下一個 op 最早開始的 cycle (接著呼叫 end())
+        long long begin(int stage, unsigned reads, unsigned writes)
+        {
+            cur_stage = stage;
+            cur_reads = reads;
+            cur_writes = writes;
+            long long ready = 0;
+            for (int r = 0; r < REG_COUNT; r++)
+            {
+                if ((reads | writes) & pipe_reg(r))
+                    ready = max(ready, reg_ready[r]);
+                if (writes & pipe_reg(r))
+                    ready = max(ready, reg_read[r]);
+            }
+            cur_channel = earliest_channel(UNIT_GLB);
+            long long free = unit_free[unit_of(stage)][0];
+            if (uses_glb(stage))
+                free = max(free, unit_free[UNIT_GLB][cur_channel]);
+            PipeStageStat& s = stage_stat[stage];
+            if (ready > free)
+                s.data_stall += ready - free;
+            else
+                s.unit_stall += free - ready;
+            cur_start = max(ready, free);
+            return cur_start;
+        }
+
+        // begin() 的 op 花 duration cycle，回傳做完的 cycle
+        // released: reads 裡一開始就放掉的 register (double_buffer 的 spad 在 compute 開始時 swap)
+        // glb_busy: GLB stage 實際佔用的 port-cycle (所有 bank 加起來)，< 0 = 一個 channel 佔 duration
+        long long end(long long duration, unsigned released = 0, long long glb_busy = -1)
+        {
+            long long done = cur_start + duration;
+            int unit = unit_of(cur_stage);
+            unit_free[unit][0] = done;
+            unit_busy[unit] += duration;
+            if (uses_glb(cur_stage))
+            {
+                unit_free[UNIT_GLB][cur_channel] = done;
+                unit_busy[UNIT_GLB] += glb_busy < 0 ? duration : glb_busy;
+            }
+            stage_stat[cur_stage].ops++;
+            stage_stat[cur_stage].busy += duration;
+            for (int r = 0; r < REG_COUNT; r++)
+            {
+                if (cur_reads & pipe_reg(r))
+                    reg_read[r] = max(reg_read[r], (released & pipe_reg(r)) ? cur_start : done);
+                if (cur_writes & pipe_reg(r))
+                    reg_ready[r] = done;
+            }
+            frontier = max(frontier, cur_start);
+            finish_cycle = max(finish_cycle, done);
+            return done;
+        }
+
+        // scoreboard 以外 (DMA engine) 寫好 register 的 cycle
+        void produce(int reg, long long cycle)
+        {
+            reg_ready[reg] = max(reg_ready[reg], cycle);
+            finish_cycle = max(finish_cycle, cycle);
+        }
+
+        long long ready(int reg) const
+        {
+            return reg_ready[reg];
+        }
+
+        // 可以覆寫 reg 的 cycle
+        long long free_at(int reg) const
+        {
+            return max(reg_ready[reg], reg_read[reg]);
+        }
+
+        // controller 走到哪 (最後一個開始的 op)，DMA 的 submit / wait 用這個時間
+        long long now() const
+        {
+            return frontier;
+        }
+
+        void extend(long long cycle)
+        {
+            finish_cycle = max(finish_cycle, cycle);
+        }
+
+        // 所有 op 做完的 cycle
+        long long finish() const
+        {
+            return finish_cycle;
+        }
+
+        void print_stats(ostream& os, long long total_cycles) const
+        {
+            long long serial = 0;
+            for (const PipeStageStat& s : stage_stat)
+                serial += s.busy;
+            os << "Pipeline (scoreboard): " << total_cycles << " cycles, stages back to back " << serial << " cycles, overlap saved "
+               << max(0LL, serial - total_cycles) << endl;
+            os << "   " << left << setw(12) << "stage" << setw(10) << "unit" << right << setw(10) << "ops" << setw(14) << "busy"
+               << setw(14) << "data stall" << setw(14) << "unit stall" << endl;
+            for (int stage = 0; stage < PIPE_STAGE_COUNT; stage++)
+            {
+                const PipeStageStat& s = stage_stat[stage];
+                if (s.ops == 0)
+                    continue;
+                os << "   " << left << setw(12) << pipe_stage_name(stage) << setw(10) << pipe_unit_name(unit_of(stage)) << right
+                   << setw(10) << s.ops << setw(14) << s.busy << setw(14) << s.data_stall << setw(14) << s.unit_stall << endl;
+            }
+            os << "   unit utilization:";
+            for (int unit = 0; unit < UNIT_COUNT; unit++)
+            {
+                if (unit_busy[unit] > 0)
+                    os << " " << pipe_unit_name(unit) << " " << fixed << setprecision(1)
+                       << 100.0 * unit_busy[unit] / max(1LL, total_cycles * (long long)unit_free[unit].size()) << "%";
+            }
+            os << defaultfloat << endl;
+        }
+
+    private:
+        int earliest_channel(int unit) const
+        {
+            return int(min_element(unit_free[unit].begin(), unit_free[unit].end()) - unit_free[unit].begin());
+        }
+
+        vector<long long> unit_free[UNIT_COUNT];  // 每個 channel 空下來的 cycle
+        long long reg_ready[REG_COUNT] = {0};  // 最後一次寫完
+        long long reg_read[REG_COUNT] = {0};   // 最後一次讀完
+        long long frontier = 0;
+        long long finish_cycle = 0;
+
+        int cur_stage = 0;
+        int cur_channel = 0;
+        unsigned cur_reads = 0;
+        unsigned cur_writes = 0;
+        long long cur_start = 0;
+};
@@ -0,0 +1,409 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <random>
+#include "controller.cpp"
+#include "scoreboard.cpp"
+#include "tile_plan.cpp"
+#include "sampling.cpp"
+using namespace std;
+
+// controller / scheduling 這層的 deterministic check (每個 component 至少一組固定的答案)
+// 編譯: g++ -std=c++17 -O2 -o test test.cpp
+
+void check(const string &name, long long got, long long expected);//不一樣時印 MISMATCH 並計入 errors
+int check_controller();
+int check_scoreboard();
+int check_tile_plan();
+int check_sampling();
+
+int errors = 0;
+
+int main()
+{
+    check_controller();
+    check_scoreboard();
+    check_tile_plan();
+    check_sampling();
+
+    if (errors == 0)
+        cout << endl << "All checks passed!" << endl;
+    else
+        cout << endl << "Total " << errors << " checks failed!" << endl;
+    return errors == 0 ? 0 : 1;
+}
+
+// 小的 shape: out_feature / in_feature / batch 各 2 個 tile，每個 tile 裡 m / n / k 各跑 2 次
+//   step: outf = N * weight_h = 16，inf = K * ifmap_size = 12，batch = M = 4
+int check_controller()
+{
+    cout << endl << "=== Controller Micro-op Test Start ===" << endl;
+    int before = errors;
+    EyerissMappingParam map{};
+    map.tk = 2;
+    map.tn = 2;
+    map.mode = 2;
+    map.M = 4;
+    map.K = 4;
+    map.N = 4;
+    LinearShapeParam shape{};
+    shape.B = 8;
+    shape.in_features = 96;
+    shape.out_features = 32;
+    const int in_div4 = 24, ifmap_size = 3, weight_h = 4;
+
+    // 不管 loop order，PE 的 op 都一樣多: 8 個 tile x (m 2 x n 2) x k 2
+    // DMA_W 在 (outf, inf) 都定下來的那層發，batch 不在最內層時每個 batch tile 重搬一次；DMA_IF 同理 (out_feature 不在最內層)
+    // 寫回在最外層每跑完一次時做，同一個 outf 連續的 batch 合成一個: batch 在最外層時 4 個，否則 2 個
+    struct Expected
+    {
+        const char* order;
+        int dma_w, dma_if, dma_store;
+    };
+    const Expected expected[] = {
+        {"oib", 4, 8, 2}, {"obi", 8, 8, 2}, {"ibo", 8, 4, 2}, {"iob", 4, 8, 2}, {"boi", 8, 8, 4}, {"bio", 8, 4, 4},
+    };
+
+    vector<vector<int>> reference;  // oib 的 (LOAD_IF a, LOAD_W a, LOAD_W b)，其他 order 只是換順序
+    for (const Expected& e : expected)
+    {
+        for (int dram : {CTRL_DRAM_NONE, CTRL_DRAM_TILE})
+        {
+            for (bool prefetch : {false, true})
+            {
+                if (dram == CTRL_DRAM_NONE && prefetch)
+                    continue;
+                ControllerConfig config;
+                config.loop_order = e.order;
+                config.dram = dram;
+                config.prefetch = prefetch;
+                controller ctrl;
+                string name = string(e.order) + (dram == CTRL_DRAM_TILE ? (prefetch ? " tile+prefetch" : " tile") : " none");
+                if (!ctrl.compile(map, shape, in_div4, ifmap_size, weight_h, config))
+                {
+                    check(name + " compile", 0, 1);
+                    continue;
+                }
+                check(name + " output tiles", ctrl.output_tiles(), 4);
+                check(name + " LOAD_IF", ctrl.op_count[UOP_LOAD_IF], 64);
+                check(name + " LOAD_W", ctrl.op_count[UOP_LOAD_W], 64);
+                check(name + " COMPUTE", ctrl.op_count[UOP_COMPUTE], 64);
+                check(name + " ACC_PSUM", ctrl.op_count[UOP_ACC_PSUM], 32);
+                check(name + " STORE_PSUM", ctrl.op_count[UOP_STORE_PSUM], 32);
+                check(name + " LOAD_PSUM", ctrl.op_count[UOP_LOAD_PSUM], 16);  // in_feature tile 0 不用讀回
+                bool tile = dram == CTRL_DRAM_TILE;
+                check(name + " DMA_W", ctrl.op_count[UOP_DMA_W], tile ? e.dma_w : 0);
+                check(name + " DMA_IF", ctrl.op_count[UOP_DMA_IF], tile ? e.dma_if : 0);
+                check(name + " DMA_STORE", ctrl.op_count[UOP_DMA_STORE], tile ? e.dma_store : 0);
+                // prefetch 時寫回不用等 (最後的 BARRIER 一起等)
+                check(name + " DMA_WAIT", ctrl.op_count[UOP_DMA_WAIT], tile ? e.dma_w + e.dma_if + (prefetch ? 0 : e.dma_store) : 0);
+                check(name + " BARRIER", ctrl.op_count[UOP_BARRIER], tile ? 1 : 0);
+                check(name + " total", ctrl.op_total, (long long)ctrl.program.size());
+
+                vector<int> loads;
+                int load_if = -1;
+                for (const MicroOp& op : ctrl.program)
+                {
+                    if (op.op == UOP_LOAD_IF)
+                        load_if = op.a;
+                    if (op.op == UOP_LOAD_W)
+                        loads.insert(loads.end(), {load_if, op.a, op.b});
+                }
+                vector<vector<int>> triples;
+                for (size_t i = 0; i < loads.size(); i += 3)
+                    triples.push_back({loads[i], loads[i + 1], loads[i + 2]});
+                sort(triples.begin(), triples.end());
+                if (reference.empty())
+                    reference = triples;
+                check(name + " same (ifmap, weight) pairs as oib", triples == reference, 1);
+            }
+        }
+
+        // tile_begin / tile_end 切開來跑，每個 output tile 的 op 加起來要等於整個
+        long long compute = 0, dma_store = 0;
+        for (int t = 0; t < 4; t++)
+        {
+            ControllerConfig config;
+            config.loop_order = e.order;
+            config.dram = CTRL_DRAM_TILE;
+            config.tile_begin = t;
+            config.tile_end = t + 1;
+            controller ctrl;
+            ctrl.compile(map, shape, in_div4, ifmap_size, weight_h, config);
+            compute += ctrl.op_count[UOP_COMPUTE];
+            dma_store += ctrl.op_count[UOP_DMA_STORE];
+        }
+        check(string(e.order) + " split COMPUTE", compute, 64);
+        check(string(e.order) + " split DMA_STORE", dma_store, 4);  // 切開後不會跨 output tile 合併
+    }
+
+    controller bad;
+    ControllerConfig config;
+    config.loop_order = "oob";
+    check("invalid loop order rejected", bad.compile(map, shape, in_div4, ifmap_size, weight_h, config), 0);
+    cout << "=== Controller Micro-op Test Done ===" << endl;
+    return errors - before;
+}
+
+// 手算的小 schedule + random program 的上下界
+int check_scoreboard()
+{
+    cout << endl << "=== Scoreboard Test Start ===" << endl;
+    int before = errors;
+    const unsigned IF = pipe_reg(REG_IF_FILL), W = pipe_reg(REG_W_FILL), PSUM = pipe_reg(REG_PSUM);
+    const unsigned GLB_TILE = pipe_reg(REG_GLB_TILE), GLB_PSUM = pipe_reg(REG_GLB_PSUM);
+
+    // ifmap / weight 各走自己的 NoC，compute 要等兩個都填好 (RAW)，下一個 ifmap 要等 compute 讀完 (WAR)
+    // released = IF: double_buffer 時 compute 一開始就放掉 fill spad，下一個 ifmap 可以和 compute 重疊
+    for (int channels : {1, 2})
+    {
+        for (bool double_buffer : {false, true})
+        {
+            string name = "scoreboard " + to_string(channels) + " channel" + (double_buffer ? " double buffer" : "");
+            Scoreboard sb;
+            sb.set_capacity(UNIT_GLB, channels);
+            check(name + " LOAD_IF start", sb.begin(PIPE_LOAD_IF, 0, IF), 0);
+            sb.end(10);
+            check(name + " LOAD_W start", sb.begin(PIPE_LOAD_W, 0, W), channels == 2 ? 0 : 10);  // 1 channel: 等 GLB
+            long long w_done = sb.end(10);
+            check(name + " COMPUTE start", sb.begin(PIPE_COMPUTE, IF | W, PSUM), w_done);
+            sb.end(5, double_buffer ? IF | W : 0);
+            long long next_if = sb.begin(PIPE_LOAD_IF, 0, IF);
+            check(name + " next LOAD_IF start", next_if, double_buffer ? max(10LL, w_done) : w_done + 5);
+            sb.end(3);
+            check(name + " STORE_PSUM start", sb.begin(PIPE_STORE_PSUM, PSUM, GLB_PSUM), max(w_done + 5, channels == 2 ? 0 : next_if + 3));
+            sb.end(2);
+            long long expected_finish = channels == 2 ? (double_buffer ? 17 : 18) : (double_buffer ? 27 : 30);
+            check(name + " finish", sb.finish(), expected_finish);
+            check(name + " COMPUTE data stall", sb.stage_stat[PIPE_COMPUTE].data_stall, w_done);
+            check(name + " LOAD_W unit stall", sb.stage_stat[PIPE_LOAD_W].unit_stall, channels == 2 ? 0 : 10);
+            check(name + " PE busy", sb.unit_busy[UNIT_PE], 5);
+            check(name + " GLB busy", sb.unit_busy[UNIT_GLB], 25);
+        }
+    }
+
+    // glb_busy: GLB stage 算實際佔用的 port-cycle (8 個 bank 一起讀 8 cycle = 64)，NoC 還是算 duration
+    Scoreboard banked;
+    banked.set_capacity(UNIT_GLB, 8);
+    banked.begin(PIPE_LOAD_W, 0, W);
+    banked.end(10, 0, 64);
+    check("scoreboard GLB port-cycles", banked.unit_busy[UNIT_GLB], 64);
+    check("scoreboard NoC busy with port-cycles", banked.unit_busy[UNIT_NOC_W], 10);
+
+    // DMA engine 寫好 GLB tile 之前不能 load
+    Scoreboard dma;
+    dma.produce(REG_GLB_TILE, 50);
+    check("scoreboard load after DMA", dma.begin(PIPE_LOAD_IF, GLB_TILE, IF), 50);
+    dma.end(4);
+    check("scoreboard DMA data stall", dma.stage_stat[PIPE_LOAD_IF].data_stall, 50);
+    check("scoreboard DMA finish", dma.finish(), 54);
+
+    // random program: 重疊後不會比 stage 一個接一個慢，也不會比最忙的 unit 快；每個都讀上一個寫的 register 時完全不能重疊
+    mt19937 rng(20);
+    for (int trial = 0; trial < 200; trial++)
+    {
+        bool chain = trial % 4 == 0;
+        Scoreboard sb;
+        sb.set_capacity(UNIT_GLB, 1 + trial % 3);
+        long long serial = 0;
+        unsigned last = 0;
+        for (int i = 0; i < 100; i++)
+        {
+            int stage = int(rng() % PIPE_STAGE_COUNT);
+            unsigned reads = rng() % (1u << REG_COUNT), writes = rng() % (1u << REG_COUNT);
+            if (chain)
+            {
+                reads = last;
+                writes = pipe_reg(int(rng() % REG_COUNT));
+                last = writes;
+            }
+            long long duration = 1 + rng() % 20;
+            sb.begin(stage, reads, writes);
+            sb.end(duration, chain ? 0 : rng() % (1u << REG_COUNT) & reads);
+            serial += duration;
+        }
+        long long busiest = *max_element(sb.unit_busy, sb.unit_busy + UNIT_GLB);
+        if (chain)
+            check("scoreboard dependency chain " + to_string(trial) + " finish", sb.finish(), serial);
+        else if (sb.finish() > serial || sb.finish() < busiest)
+            check("scoreboard random " + to_string(trial) + " finish within [busiest unit, serial]", sb.finish(), serial);
+    }
+    cout << "=== Scoreboard Test Done ===" << endl;
+    return errors - before;
+}
+
+// plan 的每個 element 要和原本 load_ifmap / load_weight / load_psum / store_psum 逐一算的 index 一樣
+int check_tile_plan()
+{
+    cout << endl << "=== Tile Plan Test Start ===" << endl;
+    int before = errors;
+    struct Case
+    {
+        int pe_v, pe_h, tk, tn, mode;
+        int ifmap, weight, psum;  // 每個 tile 的 element 數
+    };
+    const Case cases[] = {
+        {6, 8, 3, 8, 2, 18, 576, 64},  // Pattern3 的 mapping
+        {6, 8, 2, 3, 3, 18, 216, 36},
+        {4, 8, 4, 8, 1, 12, 384, 32},
+        {6, 6, 1, 5, 4, 12, 240, 80},  // 只用 4 個 row
+    };
+    LinearShapeParam shape{};
+    shape.B = 16;
+    shape.in_features = 192;
+    shape.out_features = 80;
+    const int in_div4 = 48;
+    for (const Case& c : cases)
+    {
+        string name = "tile plan " + to_string(c.pe_v) + "x" + to_string(c.pe_h) + " tk " + to_string(c.tk) + " tn " + to_string(c.tn)
+                      + " mode " + to_string(c.mode);
+        PE_Array a(c.pe_v, c.pe_h);
+        a.set_groups(vector<int>(c.mode, c.tk));
+        EyerissMappingParam map{};
+        map.tk = c.tk;
+        map.tn = c.tn;
+        map.mode = c.mode;
+        TilePlan plan;
+        check(name + " compile", plan.compile(map, shape, in_div4, a), 1);
+        check(name + " ifmap elements", plan.ifmap.size(), c.ifmap);
+        check(name + " ifmap multicast", plan.ifmap.multicast, c.tn);
+        check(name + " weight elements", plan.weight.size(), c.weight);
+        check(name + " psum in", plan.psum_in.size(), c.psum);
+        check(name + " psum out", plan.psum_out.size(), c.psum);
+        check(name + " out PEs", plan.out_pes.size(), c.tn * c.mode);
+
+        int used_rows = c.tk * c.mode, bad = 0;
+        for (int l = 0; l < a.ifmap_size * used_rows; l++)
+        {
+            int off = l / c.tk / a.ifmap_size * in_div4 + l % (c.tk * a.ifmap_size);
+            int pe_index = (l / a.ifmap_size) * a.pe_h;
+            bad += plan.ifmap.offset[l] != off || plan.ifmap.plane[l] != (l % a.ifmap_size) * a.num_pe + pe_index;
+        }
+        check(name + " ifmap index mismatches", bad, 0);
+        bad = 0;
+        for (int l = 0; l < a.weight_size * c.tn * used_rows; l++)
+        {
+            int pe_index = (l / a.weight_size) % used_rows * a.pe_h + (l / a.weight_size / used_rows);
+            int off = l % a.weight_h + ((l / a.weight_h) % (c.tk * a.ifmap_size)) * shape.out_features
+                      + (l / a.weight_size / used_rows) * a.weight_h;
+            int col = (l / a.weight_size / used_rows) * a.weight_h + l % a.weight_h;
+            bad += plan.weight.offset[l] != off || plan.weight.column[l] != col
+                   || plan.weight.plane[l] != (l % a.weight_size) * a.num_pe + pe_index;
+        }
+        check(name + " weight index mismatches", bad, 0);
+        bad = 0;
+        for (int i = 0, e = 0; i < c.tn * c.mode; i++)
+        {
+            for (int j = 0; j < a.weight_h; j++, e++)
+            {
+                int off = i / c.tn * shape.out_features + (i % c.tn) * a.weight_h + j;
+                int col = (i % c.tn) * a.weight_h + j;
+                int in_pe = a.group_first_pe(i / a.pe_h) + i % a.pe_h, out_pe = a.group_last_pe(i / a.pe_h) + i % a.pe_h;
+                bad += plan.psum_in.offset[e] != off || plan.psum_in.column[e] != col || plan.psum_in.plane[e] != j * a.num_pe + in_pe;
+                bad += plan.psum_out.offset[e] != off || plan.psum_out.column[e] != col || plan.psum_out.plane[e] != j * a.num_pe + out_pe;
+            }
+        }
+        check(name + " psum index mismatches", bad, 0);
+
+        // 最後一個 out_feature tile: column 超出的 element 不搬，其他照搬
+        size_t weight_tensor = (size_t)in_div4 * shape.out_features;
+        int last_col = shape.out_features - c.tn * a.weight_h + 1;
+        check(name + " interior weight tile", plan.weight.interior(0, weight_tensor, 0, shape.out_features), 1);
+        check(name + " edge weight tile", plan.weight.interior(last_col, weight_tensor, last_col, shape.out_features), 0);
+        size_t last = plan.weight.size() - 1;  // 最後一個 PE column 的最後一個 element，column 最大
+        check(name + " edge first element", plan.weight.valid(0, last_col, weight_tensor, last_col, shape.out_features), 1);
+        check(name + " edge last element", plan.weight.valid(last, last_col, weight_tensor, last_col, shape.out_features), 0);
+    }
+
+    // weight 要用到第 9 個 column，超出 6 x 8 的 array
+    PE_Array a;
+    a.set_groups({3, 3});
+    EyerissMappingParam map{};
+    map.tk = 3;
+    map.tn = 9;
+    map.mode = 2;
+    TilePlan plan;
+    check("tile plan rejects tn past the array", plan.compile(map, shape, in_div4, a), 0);
+    cout << "=== Tile Plan Test Done ===" << endl;
+    return errors - before;
+}
+
+// 每類整個抽到時估計值就是總和 (CI 0)；只抽一部分時 variance 加 finite population correction
+int check_sampling()
+{
+    cout << endl << "=== Sampling Estimate Test Start ===" << endl;
+    int before = errors;
+
+    // population {1, 2, 3, 4} 抽到 {1, 3}: mean 2，s^2 = 2，variance = 4^2 x (1 - 2/4) x 2 / 2 = 8
+    SampleStat s;
+    s.add(1);
+    s.add(3);
+    check("sample variance", llround(s.variance()), 2);
+    StratifiedEstimate partial;
+    partial.add(4, s);
+    check("partial total", llround(partial.total), 8);
+    check("partial variance", llround(partial.variance), 8);
+    check("partial CI contains 10", partial.contains(10), 1);   // 1.96 x sqrt(8) = 5.5
+    check("partial CI excludes 14", partial.contains(14), 0);
+
+    // tile cycle 大小的值，3 類全部抽: 和逐一加起來完全一樣
+    mt19937_64 rng(24);
+    for (int trial = 0; trial < 20; trial++)
+    {
+        StratifiedEstimate full;
+        long long sum = 0;
+        for (int stratum = 0; stratum < 3; stratum++)
+        {
+            long long population = 1 + rng() % 5000;
+            long long base = 20000 + rng() % 100000;
+            SampleStat all;
+            for (long long k = 0; k < population; k++)
+            {
+                long long v = base + (long long)(rng() % 64);
+                all.add(double(v));
+                sum += v;
+            }
+            full.add(population, all);
+        }
+        check("every tile sampled " + to_string(trial) + " total", llround(full.total), sum);
+        check("every tile sampled " + to_string(trial) + " CI", llround(full.half_width()), 0);
+    }
+
+    // 少數 unit 才有的值 (1000 個裡 4 個是 2，總和 8) 一個都沒抽到: 抽到的 8 個全部是 0，CI 不能是 +-0
+    SampleStat zeros;
+    for (int k = 0; k < 8; k++)
+        zeros.add(0);
+    StratifiedEstimate rare;
+    rare.add(1000, zeros);
+    check("rare value total", llround(rare.total), 0);
+    check("rare value CI not zero", rare.half_width() > 0, 1);
+    check("rare value CI contains 8", rare.contains(8), 1);
+    // 再加一類 20 個全部抽 (0 / 1 / 2): 精確的部分不加 variance，spread 變 2
+    for (int trial = 0; trial < 20; trial++)
+    {
+        StratifiedEstimate mixed = rare;
+        SampleStat small;
+        long long sum = 0;
+        for (int k = 0; k < 20; k++)
+        {
+            long long v = (long long)(rng() % 3);
+            small.add(double(v));
+            sum += v;
+        }
+        mixed.add(20, small);
+        check("rare value + full class " + to_string(trial) + " total", llround(mixed.total), sum);
+        check("rare value + full class " + to_string(trial) + " CI", mixed.half_width() >= rare.half_width(), 1);
+        check("rare value + full class " + to_string(trial) + " contains", mixed.contains(double(sum + 8)), 1);
+    }
+    cout << "=== Sampling Estimate Test Done ===" << endl;
+    return errors - before;
+}
+
+void check(const string &name, long long got, long long expected)
+{
+    if (got == expected)
+        return;
+    cout << name << " = " << got << " (expected " << expected << ") <-- MISMATCH!" << endl;
+    errors++;
+}
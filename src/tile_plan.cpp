@@ -0,0 +1,129 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "../analayzer/data_type.h"
+#include "PE/pe_array.cpp"
+
+using namespace std;
+
+// tile 的 gather / scatter plan
+// 一個 mapping 下每個 LOAD_IF / LOAD_W / LOAD_PSUM / STORE_PSUM 搬的 pattern 都一樣，只差 MicroOp 的 a (tensor index)
+// 和 b (out column)，所以 compile() 先把 element 的相對 index 和 PE plane 的位置算好，
+// simulator 每個 tile 只要 base + offset[e] 照順序搬 (不用再做除法 / 餘數)
+// tile 整個在 tensor 裡面 (interior) 時不用逐一檢查邊界，邊緣的 tile 才檢查 (超出的補 0，和原本一樣)
+
+struct TileGather
+{
+    vector<int32_t> offset;   // tensor index - MicroOp.a
+    vector<int32_t> column;   // out column - MicroOp.b (ifmap 沒有 column 限制，全部是 0)
+    vector<int32_t> plane;    // PE array plane 的位置: slot * num_pe + pe
+    int multicast = 1;        // 同一個值寫到 plane[e], plane[e] + 1, ... (同一個 row 連續的 PE)
+    int32_t max_offset = 0;
+    int32_t max_column = 0;
+    bool check_column = false;
+
+    size_t size() const
+    {
+        return offset.size();
+    }
+
+    void push(int32_t off, int32_t col, int32_t pos)
+    {
+        offset.push_back(off);
+        column.push_back(col);
+        plane.push_back(pos);
+        max_offset = max(max_offset, off);
+        max_column = max(max_column, col);
+    }
+
+    // 這個 tile 的每個 element 都在 tensor 裡
+    bool interior(long long base, size_t tensor_size, int col_base, int out_features) const
+    {
+        return base >= 0 && base + max_offset < (long long)tensor_size && (!check_column || col_base + max_column < out_features);
+    }
+
+    // 邊緣 tile 的第 e 個 element 要不要搬
+    bool valid(size_t e, long long base, size_t tensor_size, int col_base, int out_features) const
+    {
+        long long index = base + offset[e];
+        return index >= 0 && index < (long long)tensor_size && (!check_column || col_base + column[e] < out_features);
+    }
+};
+
+class TilePlan
+{
+    public:
+        TileGather ifmap;     // LOAD_IF: A -> ifmap fill plane
+        TileGather weight;    // LOAD_W: B -> weight fill plane
+        TileGather psum_in;   // LOAD_PSUM: C -> psum plane (每組第一個 row，累加)
+        TileGather psum_out;  // STORE_PSUM: psum plane (每組最後一個 row) -> C
+        vector<int> out_pes;  // STORE_PSUM 之後要 reset 的 PE
+
+        // index 的算法和原本 load_ifmap / load_weight / load_psum / store_psum 的 inner loop 一樣 (element 順序也一樣)
+        // PE 超出 array 時回傳 false
+        bool compile(const EyerissMappingParam& map, const LinearShapeParam& shape, int in_div4, const PE_Array& a)
+        {
+            int num_pe = a.num_pe;
+            int used_rows = map.tk * map.mode;
+            int k_words = map.tk * a.ifmap_size;
+
+            ifmap = TileGather();
+            ifmap.multicast = map.tn;
+            for (int l = 0; l < a.ifmap_size * used_rows; l++)
+            {
+                int row = l / a.ifmap_size;
+                ifmap.push(l / k_words * in_div4 + l % k_words, 0, (l % a.ifmap_size) * num_pe + row * a.pe_h);
+            }
+
+            weight = TileGather();
+            weight.check_column = true;
+            for (int l = 0; l < a.weight_size * map.tn * used_rows; l++)
+            {
+                int col = l / a.weight_size / used_rows;  // PE column
+                int pe_index = (l / a.weight_size) % used_rows * a.pe_h + col;
+                int off = l % a.weight_h + ((l / a.weight_h) % k_words) * shape.out_features + col * a.weight_h;
+                weight.push(off, col * a.weight_h + l % a.weight_h, (l % a.weight_size) * num_pe + pe_index);
+            }
+
+            psum_in = TileGather();
+            psum_out = TileGather();
+            psum_in.check_column = psum_out.check_column = true;
+            out_pes.clear();
+            for (int i = 0; i < map.tn * map.mode; i++)
+            {
+                int in_pe = a.group_first_pe(i / a.pe_h) + i % a.pe_h;
+                int out_pe = a.group_last_pe(i / a.pe_h) + i % a.pe_h;
+                for (int j = 0; j < a.weight_h; j++)
+                {
+                    int off = i / map.tn * shape.out_features + (i % map.tn) * a.weight_h + j;
+                    int col = (i % map.tn) * a.weight_h + j;
+                    psum_in.push(off, col, j * num_pe + in_pe);
+                    psum_out.push(off, col, j * num_pe + out_pe);
+                }
+                out_pes.push_back(out_pe);
+            }
+
+            // pe_index 的檢查只要做一次
+            for (const TileGather* g : {&ifmap, &weight, &psum_in, &psum_out})
+            {
+                for (int32_t pos : g->plane)
+                {
+                    if (pos % num_pe + g->multicast > num_pe)
+                    {
+                        cerr << "Tile plan Error: pe_index out of range: " << pos % num_pe + g->multicast - 1 << endl;
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        void print_stats(ostream& os) const
+        {
+            os << "Tile plan: ifmap " << ifmap.size() << " x" << ifmap.multicast << ", weight " << weight.size() << ", psum "
+               << psum_in.size() << " / " << psum_out.size() << " elements per tile" << endl;
+        }
+};
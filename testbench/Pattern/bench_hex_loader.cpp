@@ -0,0 +1,96 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+
+#include "hex_loader.cpp"
+
+using namespace std;
+
+// hex_loader.cpp vs 原本 getline + stringstream 的 loader，Pattern1 ~ 3 每個 .txt 各跑 passes 次取最快
+// usage: bench_hex_loader [passes [threads]]   (在 testbench/Pattern 底下跑，預設 5 / hardware_concurrency)
+
+vector<int32_t> read_hex_file_stream(const string& filename);
+
+template <typename F>
+double best_of(int passes, F fn)
+{
+    double best = 1e30;
+    for (int i = 0; i < passes; i++)
+    {
+        auto start = chrono::steady_clock::now();
+        fn();
+        best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char* argv[])
+{
+    int passes = 5;
+    int threads = max(1u, thread::hardware_concurrency());
+    if (argc >= 2)
+        passes = atoi(argv[1]);
+    if (argc >= 3)
+        threads = atoi(argv[2]);
+
+    cout << "passes " << passes << ", threads " << threads << " (hardware " << thread::hardware_concurrency() << ")\n\n";
+    cout << left << setw(26) << "file" << right << setw(10) << "words" << setw(14) << "stringstream"
+         << setw(12) << "1 thread" << setw(12) << "N threads" << setw(10) << "speedup" << "\n";
+
+    bool all_match = true;
+    int files = 0;
+    for (int id = 1; id <= 3; id++)
+    {
+        for (const char* name : {"A.txt", "B.txt", "C_golden.txt"})
+        {
+            string path = "Pattern" + to_string(id) + "/" + name;
+            if (!ifstream(path).good())
+                continue;
+            files++;
+            vector<int32_t> reference, single, multi;
+            double t_stream = best_of(passes, [&] { reference = read_hex_file_stream(path); });
+            double t_single = best_of(passes, [&] { single.clear(); load_hex_file(single, path, 1); });
+            double t_multi = best_of(passes, [&] { multi.clear(); load_hex_file(multi, path, threads); });
+            bool match = single == reference && multi == reference;
+            all_match = all_match && match;
+            cout << left << setw(26) << path << right << setw(10) << reference.size()
+                 << fixed << setprecision(2)
+                 << setw(11) << t_stream * 1e3 << " ms"
+                 << setw(9) << t_single * 1e3 << " ms"
+                 << setw(9) << t_multi * 1e3 << " ms"
+                 << setw(9) << t_stream / t_multi << "x"
+                 << (match ? "" : "  MISMATCH") << "\n";
+        }
+    }
+    if (files == 0)
+    {
+        cerr << "No pattern files found (run in testbench/Pattern)\n";
+        return 1;
+    }
+    cout << "\n" << (all_match ? "All loaders agree" : "Loader MISMATCH") << "\n";
+    return all_match ? 0 : 1;
+}
+
+// 原本各 testbench 裡的 loader (對照用)
+vector<int32_t> read_hex_file_stream(const string& filename)
+{
+    ifstream fin(filename);
+    vector<int32_t> data;
+    string line;
+    while (getline(fin, line))
+    {
+        if (line.empty()) continue;
+        uint32_t val;
+        stringstream ss(line);
+        ss >> hex >> val;
+        if (ss.fail()) continue;
+        data.push_back(val);
+    }
+    return data;
+}
@@ -0,0 +1,74 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+#include "tensor_file.cpp"
+#include "hex_loader.cpp"
+
+using namespace std;
+
+
+// 舊的 .txt pattern 轉成 .bin (A.bin / B.bin / C_golden.bin 放在同一個資料夾)
+// usage: convert_pattern <pattern_dir> [datapath [m n p]]
+//        m x n 是 A、n x p 是 B (n 以 lane 計，和 pattern_generator 一樣)，預設 256 / 8192 / 256 / u8
+//        word 數和 shape 對不起來時依 column 數推 row 數，再不行就存成 1 維
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        cerr << "usage: convert_pattern <pattern_dir> [datapath [m n p]]\n";
+        return 1;
+    }
+    string folder = argv[1];
+    int dp = DP_U8;
+    uint64_t m = 256, n = 128 * 8 * 8, p = 256;
+    if (argc >= 3)
+    {
+        dp = dp_from_name(argv[2]);
+        if (dp < 0)
+        {
+            cerr << "Unknown datapath " << argv[2] << " (u8 | int4 | int8 | int16 | bf16)\n";
+            return 1;
+        }
+    }
+    if (argc >= 6)
+    {
+        m = atoll(argv[3]);
+        n = atoll(argv[4]);
+        p = atoll(argv[5]);
+    }
+    uint64_t n_words = n / dp_lanes(dp);
+
+    const string names[3] = {"A", "B", "C_golden"};
+    const vector<uint64_t> shapes[3] = {{m, n_words}, {n_words, p}, {m, p}};
+    int converted = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        string txt = folder + "/" + names[i] + ".txt";
+        string bin = folder + "/" + names[i] + ".bin";
+        if (!ifstream(txt).good())
+        {
+            cout << "skip " << txt << " (not found)" << endl;
+            continue;
+        }
+        vector<int32_t> data = read_hex_file(txt);
+        vector<uint64_t> shape = shapes[i];
+        if (shape[0] * shape[1] != data.size())
+        {
+            // row 數不同 (例如 batch 比較小) 時保留 column 數
+            if (data.size() % shape[1] == 0)
+                shape[0] = data.size() / shape[1];
+            else
+                shape = {data.size()};
+            cout << "   " << txt << ": " << data.size() << " words, stored as " << shape[0]
+                 << (shape.size() > 1 ? " x " + to_string(shape[1]) : string()) << endl;
+        }
+        if (!write_tensor(bin, data, shape, dp))
+            return 1;
+        cout << txt << " -> " << bin << " (" << data.size() << " words)" << endl;
+        converted++;
+    }
+    return converted > 0 ? 0 : 1;
+}
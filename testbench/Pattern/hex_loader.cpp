@@ -0,0 +1,178 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <charconv>
+#include <thread>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+// 一行一個 hex word 的 pattern (.txt) loader，取代各 testbench 裡 getline + stringstream 的版本
+// 整個檔案 mmap 進來，在換行的地方切成幾段給不同 thread，每段先數行數決定輸出位置，
+// 再用 from_chars 直接 parse 進事先 resize 好的 vector (每個 word 不會另外配置記憶體)
+// 空白行跳過，格式不對的行印 warning 後跳過，和舊的 loader 一樣
+// 接受 "0x" 開頭與前後空白 / '\r'
+
+// 一段檔案 parse 的結果
+struct HexChunk
+{
+    const char* begin;
+    const char* end;
+    size_t offset;                // 在輸出 vector 的起點
+    size_t parsed = 0;            // 實際 parse 出來的 word 數
+    vector<string_view> invalid;  // 格式不對的行 (通常是空的)
+};
+
+inline bool hex_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline void parse_hex_chunk(HexChunk& chunk, int32_t* out)
+{
+    const char* p = chunk.begin;
+    int32_t* dst = out + chunk.offset;
+    while (p < chunk.end)
+    {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', chunk.end - p));
+        if (eol == nullptr)
+            eol = chunk.end;
+        const char* s = p;
+        const char* e = eol;
+        while (s < e && hex_space(*s)) s++;
+        while (e > s && hex_space(e[-1])) e--;
+        if (s < e)
+        {
+            if (e - s > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X'))
+                s += 2;
+            uint32_t val; // 最高位元是 1 的 word (負數 lane / bf16) 要用 unsigned parse
+            from_chars_result r = from_chars(s, e, val, 16);
+            if (r.ec == errc() && r.ptr == e)
+                *dst++ = int32_t(val);
+            else
+                chunk.invalid.push_back(string_view(p, eol - p));
+        }
+        p = eol + 1;
+    }
+    chunk.parsed = dst - (out + chunk.offset);
+}
+
+// filename 的 word 接在 data 後面，threads = 0 時依檔案大小和 hardware_concurrency 決定
+// 檔案打不開回傳 false
+inline bool load_hex_file(vector<int32_t>& data, const string& filename, int threads = 0)
+{
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    if (size == 0)
+    {
+        ::close(fd);
+        return true;
+    }
+    void* base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED)
+        return false;
+    madvise(base, size, MADV_SEQUENTIAL);
+    const char* text = static_cast<const char*>(base);
+    const char* text_end = text + size;
+
+    // 一個 thread 至少 256 KB，小檔案就單 thread
+    const size_t min_chunk = 256 * 1024;
+    if (threads <= 0)
+        threads = max(1u, thread::hardware_concurrency());
+    threads = int(max<size_t>(1, min<size_t>(threads, size / min_chunk)));
+
+    // 在換行後面切
+    vector<HexChunk> chunks(threads);
+    const char* p = text;
+    for (int t = 0; t < threads; t++)
+    {
+        const char* e = (t == threads - 1) ? text_end : text + size * (t + 1) / threads;
+        if (e < p)
+            e = p;
+        if (e < text_end)
+        {
+            const char* nl = static_cast<const char*>(memchr(e, '\n', text_end - e));
+            e = nl ? nl + 1 : text_end;
+        }
+        chunks[t].begin = p;
+        chunks[t].end = e;
+        p = e;
+    }
+
+    // 每段的行數 (= 最多幾個 word) 決定輸出位置，vector 只 resize 一次
+    vector<size_t> lines(threads, 0);
+    auto count_lines = [&](int t)
+    {
+        const char* q = chunks[t].begin;
+        size_t n = 0;
+        while (q < chunks[t].end)
+        {
+            const char* nl = static_cast<const char*>(memchr(q, '\n', chunks[t].end - q));
+            n++;
+            if (nl == nullptr)
+                break;
+            q = nl + 1;
+        }
+        lines[t] = n;
+    };
+    auto run = [&](auto fn)
+    {
+        vector<thread> workers;
+        for (int t = 1; t < threads; t++)
+            workers.emplace_back(fn, t);
+        fn(0);
+        for (thread& w : workers)
+            w.join();
+    };
+    run(count_lines);
+
+    size_t start = data.size();
+    size_t total = 0;
+    for (int t = 0; t < threads; t++)
+    {
+        chunks[t].offset = start + total;
+        total += lines[t];
+    }
+    data.resize(start + total);
+    run([&](int t) { parse_hex_chunk(chunks[t], data.data()); });
+
+    // 有空白行 / 錯誤行時把後面的段往前補
+    size_t dst = start;
+    for (int t = 0; t < threads; t++)
+    {
+        if (dst != chunks[t].offset)
+            memmove(data.data() + dst, data.data() + chunks[t].offset, chunks[t].parsed * sizeof(int32_t));
+        dst += chunks[t].parsed;
+        for (string_view line : chunks[t].invalid)
+            cerr << "⚠️  Invalid line in " << filename << ": " << line << endl;
+    }
+    data.resize(dst);
+    munmap(base, size);
+    return true;
+}
+
+inline vector<int32_t> read_hex_file(const string& filename, int threads = 0)
+{
+    vector<int32_t> data;
+    if (!load_hex_file(data, filename, threads))
+        cerr << "Error opening file: " << filename << endl;
+    return data;
+}
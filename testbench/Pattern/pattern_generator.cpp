@@ -7,6 +7,8 @@
 #include <random>
 #include <fstream>
 #include <string>
+#include "../../src/PE/pe_spec.cpp"
+#include "tensor_file.cpp"
 
 using namespace std;
 
@@ -21,23 +23,51 @@ using namespace std;
 //4: 1個PE累加，共六組
 
 int32_t make_int32_from_bytes(uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3);
-int32_t generate_in_data();
+int32_t generate_in_data(int dp);
+int32_t sparsify(int32_t value, int dp, double density);
 
 int32_t generate_golden_output
-(const int32_t& in_feature_spad, const int32_t& weight_spad);
+(const int32_t& in_feature_spad, const int32_t& weight_spad, int32_t psum, int dp);
 array<uint8_t, 4> get_bytes(int32_t value);
 
 random_device rd;  
 mt19937 rng(rd());  // random seed
 uniform_int_distribution<int32_t> dist_byte(0, 32);//數字隨機範圍
+uniform_int_distribution<int32_t> dist_int4(-8, 7);
+uniform_int_distribution<int32_t> dist_int8(-32, 32);
+uniform_int_distribution<int32_t> dist_int16(-1024, 1024);
+uniform_real_distribution<float> dist_bf16(-1.0f, 1.0f);
 
-int main()
+// usage: pattern_generator [pattern_id [datapath [ifmap_density [format]]]]   datapath: u8 | int4 | int8 | int16 | bf16
+// ifmap_density < 1 時 A 的 lane 以 1 - density 的機率設成 0 (模擬 ReLU 後的 activation)
+// format: txt | bin | both (預設 both，.bin 是 tensor_file.cpp 的 mmap 格式)
+int main(int argc, char* argv[])
 {
     int pattern_id = 3;//放在第幾個資料夾
+    int dp = DP_U8;
+    if (argc >= 2)
+        pattern_id = atoi(argv[1]);
+    if (argc >= 3)
+    {
+        dp = dp_from_name(argv[2]);
+        if (dp < 0)
+        {
+            cerr << "Unknown datapath " << argv[2] << " (u8 | int4 | int8 | int16 | bf16)\n";
+            return -1;
+        }
+    }
+    double ifmap_density = 1.0;
+    if (argc >= 4)
+        ifmap_density = atof(argv[3]);
+    string format = "both";
+    if (argc >= 5)
+        format = argv[4];
+    bool write_txt = format != "bin";
+    bool write_bin = format != "txt";
     int m = 256; //GEMM now
     int n = 128 * 8 * 8;
     int p = 256;
-    int n_div4 = n / 4;
+    int n_div4 = n / dp_lanes(dp); // packed words per row
     // A: m * n
     // B: n * p
     // C: m * p
@@ -56,10 +86,10 @@ int main()
     // ===== 產生 A 和 B =====
     cout << "✅ Generating random matrices A and B..." << endl;
     for(int i = 0; i < m * n_div4; i++)
-        A[i] = generate_in_data();
+        A[i] = sparsify(generate_in_data(dp), dp, ifmap_density);
 
     for(int i= 0; i < n_div4 * p; i++)
-        B[i] = generate_in_data();
+        B[i] = generate_in_data(dp);
     cout << "✅ Random matrices A and B generated." << endl;
     // ===== 計算 C = A × B =====
     for (int i = 0; i < m; i++) 
@@ -68,7 +98,7 @@ int main()
         {
             int32_t sum = 0;
             for (int k = 0; k < n_div4; k++) 
-                sum += generate_golden_output((A[i * n_div4 + k]), B[k * p + j]);
+                sum = generate_golden_output((A[i * n_div4 + k]), B[k * p + j], sum, dp);
     
             C[i * p + j] = sum;
             //cout << "C = " << i * p + j<< endl;
@@ -77,45 +107,60 @@ int main()
 
     cout << "✅ Matrix Multiplication Done!" << endl;
 
+    // ===== 寫入檔案 (bin) =====
+    if (write_bin)
+    {
+        if (!write_tensor(folder + "/A.bin", A, {uint64_t(m), uint64_t(n_div4)}, dp)
+            || !write_tensor(folder + "/B.bin", B, {uint64_t(n_div4), uint64_t(p)}, dp)
+            || !write_tensor(folder + "/C_golden.bin", C, {uint64_t(m), uint64_t(p)}, dp))
+        {
+            cerr << "❌ Cannot write tensor file.\n";
+            return -1;
+        }
+        cout << "✅ Done: A.bin, B.bin, and C_golden.bin generated in '" << folder << "/'" << endl;
+    }
+
     // ===== 寫入檔案 (txt) =====
+    if (write_txt)
+    {
+        string pathA = folder + "/A.txt";
+        string pathB = folder + "/B.txt";
+        string pathC = folder + "/C_golden.txt";
 
-    string pathA = folder + "/A.txt";
-    string pathB = folder + "/B.txt";
-    string pathC = folder + "/C_golden.txt";
+        ofstream fa(pathA);
+        ofstream fb(pathB);
+        ofstream fc(pathC);
+        if(!fa.is_open() || !fb.is_open() || !fc.is_open()) 
+        {
+            cerr << "❌ Cannot open output file.\n";
+            return -1;
+        }
+        else
+            cout << "✅ Output file opened: " << pathA << ", " << pathB << ", " << pathC << endl;
 
-    ofstream fa(pathA);
-    ofstream fb(pathB);
-    ofstream fc(pathC);
-    if(!fa.is_open() || !fb.is_open() || !fc.is_open()) 
-    {
-        cerr << "❌ Cannot open output file.\n";
-        return -1;
-    }
-    else
-        cout << "✅ Output file opened: " << pathA << ", " << pathB << ", " << pathC << endl;
+        fa << hex << uppercase << setfill('0');
+        fb << hex << uppercase << setfill('0');
+        fc << hex << uppercase << setfill('0');
+        for (int i = 0; i < m; i++) 
+            for (int j = 0; j < n_div4; j++)
+                fa << setw(8) << A[i * n_div4 + j] << "\n";
 
-    fa << hex << uppercase << setfill('0');
-    fb << hex << uppercase << setfill('0');
-    fc << hex << uppercase << setfill('0');
-    for (int i = 0; i < m; i++) 
-        for (int j = 0; j < n_div4; j++)
-            fa << setw(8) << A[i * n_div4 + j] << "\n";
+        for (int i = 0; i < n_div4; i++) 
+            for (int j = 0; j < p; j++)
+                fb << setw(8) << B[i * p + j] << "\n";
 
-    for (int i = 0; i < n_div4; i++) 
-        for (int j = 0; j < p; j++)
-            fb << setw(8) << B[i * p + j] << "\n";
+        for (int i = 0; i < m; i++) 
+            for (int j = 0; j < p; j++)
+                fc << setw(8) << C[i * p + j] << "\n";
 
-    for (int i = 0; i < m; i++) 
-        for (int j = 0; j < p; j++)
-            fc << setw(8) << C[i * p + j] << "\n";
-    
+        fa.close();
+        fb.close();
+        fc.close();
 
-    fa.close();
-    fb.close();
-    fc.close();
+        cout << "✅ Done: A.txt, B.txt, and C_golden.txt generated in '" << folder << "/'" << endl;
+    }
 
-    cout << "✅ Done: A.txt, B.txt, and C_golden.txt generated in '" << folder << "/'" << endl;
-    cout << "\n--- Matrix Dimensions (at uint8_t level) ---" << endl;
+    cout << "\n--- Matrix Dimensions (at " << dp_name(dp) << " level) ---" << endl;
     cout << "  A: " << m << " x " << n << endl;
     cout << "  B: " << n << " x " << p << endl;
     cout << "  C: " << m << " x " << p << endl;
@@ -138,21 +183,67 @@ int32_t make_int32_from_bytes(const std::array<uint8_t, 4>& bytes)
     );
 }
 
-int32_t generate_in_data()
+int32_t generate_in_data(int dp)
 {
     int32_t in_data;
     array<uint8_t, 4> in_data_bytes;
 
-    for (int b = 0; b < 4; b++)
-        in_data_bytes[b] = uint8_t(dist_byte(rng));
+    if (dp == DP_U8)
+    {
+        for (int b = 0; b < 4; b++)
+            in_data_bytes[b] = uint8_t(dist_byte(rng));
+
+        in_data = make_int32_from_bytes(in_data_bytes);
+        return in_data;
+    }
 
-    in_data = make_int32_from_bytes(in_data_bytes);
+    // 其他 datapath: 每個 lane 依格式產生，低位 lane 放在低位 bits
+    int bits = dp_lane_bits(dp);
+    uint32_t word = 0;
+    for (int lane = 0; lane < dp_lanes(dp); lane++)
+    {
+        uint32_t raw;
+        if (dp == DP_BF16)
+            raw = pe_float_to_bf16(dist_bf16(rng));
+        else if (dp == DP_INT4)
+            raw = uint32_t(dist_int4(rng));
+        else if (dp == DP_INT8)
+            raw = uint32_t(dist_int8(rng));
+        else
+            raw = uint32_t(dist_int16(rng));
+        word |= (raw & ((1u << bits) - 1)) << (bits * lane);
+    }
+    in_data = int32_t(word);
     return in_data;
 }
 
 
-int32_t generate_golden_output(const int32_t& in_feature_spad, const int32_t& weight_spad)
+int32_t sparsify(int32_t value, int dp, double density)
 {
+    if (density >= 1.0)
+        return value;
+    static bernoulli_distribution keep_lane;
+    keep_lane.param(bernoulli_distribution::param_type(density));
+    int bits = dp_lane_bits(dp);
+    uint32_t word = uint32_t(value);
+    for (int lane = 0; lane < dp_lanes(dp); lane++)
+    {
+        if (!keep_lane(rng))
+            word &= ~(((1u << bits) - 1) << (bits * lane));
+    }
+    return int32_t(word);
+}
+
+// psum + dot(in_feature, weight)，u8 以外的 datapath 用和 PE 相同的 lane MAC (bf16 為 fp32 累加)
+int32_t generate_golden_output(const int32_t& in_feature_spad, const int32_t& weight_spad, int32_t psum, int dp)
+{
+    if (dp != DP_U8)
+    {
+        for (int j = 0; j < dp_lanes(dp); j++)
+            psum = pe_mac_lane(psum, in_feature_spad, weight_spad, j, dp);
+        return psum;
+    }
+
     array<uint8_t, 4> in_feature_bytes = get_bytes(in_feature_spad);
     array<uint8_t, 4> weight_bytes = get_bytes(weight_spad);
     
@@ -161,7 +252,7 @@ int32_t generate_golden_output(const int32_t& in_feature_spad, const int32_t& we
     {
             golden_output += in_feature_bytes[j] * weight_bytes[j];
     }
-    return golden_output;
+    return psum + golden_output;
 }
 
 array<uint8_t, 4> get_bytes(int32_t value) 
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../../analayzer/data_type.h"
+
+using namespace std;
+
+// Pattern 的 binary tensor 格式 (.bin)，取代一行一個 hex word 的 .txt
+// [TensorHeader 128 bytes][packed int32 word x words] (little endian)
+// shape 以 packed word 計，dtype 是 DatapathMode (決定一個 word 裡幾個 lane)
+// 讀的時候直接 mmap，TensorView 指向 mapping，不會複製到 vector
+
+enum TensorLayout
+{
+    TENSOR_ROW_MAJOR = 0,
+    TENSOR_COL_MAJOR,
+};
+
+constexpr char TENSOR_MAGIC[4] = {'E', 'Y', 'T', 'S'};
+constexpr uint32_t TENSOR_VERSION = 1;
+constexpr uint64_t TENSOR_DATA_OFFSET = 128;
+constexpr int TENSOR_MAX_RANK = 4;
+
+struct TensorHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t dtype;      // DatapathMode
+    uint32_t layout;     // TensorLayout
+    uint32_t rank;
+    uint32_t reserved;
+    uint64_t shape[TENSOR_MAX_RANK];
+    uint64_t words;      // payload 的 int32 個數 (= shape 相乘)
+    uint64_t checksum;   // payload 的 FNV-1a 64
+    uint64_t data_offset;
+};
+static_assert(sizeof(TensorHeader) <= TENSOR_DATA_OFFSET, "tensor header too large");
+
+// FNV-1a 64，一次吃一個 word (比逐 byte 快，格式裡寫死這個算法)
+inline uint64_t tensor_checksum(const int32_t* data, size_t words)
+{
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < words; i++)
+    {
+        h ^= uint32_t(data[i]);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// 唯讀的 int32 view (C++17 沒有 std::span)，simulator / test 用它讀 A / B / golden
+struct TensorView
+{
+    const int32_t* ptr = nullptr;
+    size_t n = 0;
+
+    TensorView() {}
+    TensorView(const int32_t* ptr, size_t n) : ptr(ptr), n(n) {}
+    TensorView(const vector<int32_t>& v) : ptr(v.data()), n(v.size()) {}
+
+    size_t size() const { return n; }
+    bool empty() const { return n == 0; }
+    const int32_t& operator[](size_t i) const { return ptr[i]; }
+    const int32_t* begin() const { return ptr; }
+    const int32_t* end() const { return ptr + n; }
+};
+
+// mmap 一個 .bin，物件活著的時候 view() 有效
+class TensorFile
+{
+    public:
+        TensorHeader header;
+
+        TensorFile() {}
+        ~TensorFile()
+        {
+            close();
+        }
+
+        TensorFile(const TensorFile&) = delete;
+        TensorFile& operator=(const TensorFile&) = delete;
+
+        // 檔案不存在時安靜地回傳 false (讓呼叫的人退回 .txt)，格式錯誤才印 error
+        bool open(const string& path, bool verify = true)
+        {
+            close();
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+            struct stat st;
+            if (fstat(fd, &st) != 0 || size_t(st.st_size) < TENSOR_DATA_OFFSET)
+            {
+                cerr << "Tensor Error: " << path << " is too small" << endl;
+                ::close(fd);
+                return false;
+            }
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (p == MAP_FAILED)
+            {
+                cerr << "Tensor Error: cannot mmap " << path << endl;
+                return false;
+            }
+            base = p;
+            mapped = st.st_size;
+            memcpy(&header, base, sizeof(header));
+
+            if (memcmp(header.magic, TENSOR_MAGIC, 4) != 0 || header.version != TENSOR_VERSION)
+                return fail(path, "bad magic / version");
+            if (header.rank > TENSOR_MAX_RANK || header.data_offset < sizeof(TensorHeader)
+                || header.data_offset + header.words * 4 > mapped)
+                return fail(path, "truncated or corrupt header");
+            uint64_t count = 1;
+            for (uint32_t i = 0; i < header.rank; i++)
+                count *= header.shape[i];
+            if (count != header.words)
+                return fail(path, "shape does not match word count");
+            if (verify && tensor_checksum(data(), size()) != header.checksum)
+                return fail(path, "checksum mismatch");
+            madvise(base, mapped, MADV_SEQUENTIAL);
+            return true;
+        }
+
+        void close()
+        {
+            if (base != nullptr)
+                munmap(base, mapped);
+            base = nullptr;
+            mapped = 0;
+        }
+
+        bool is_open() const
+        {
+            return base != nullptr;
+        }
+
+        const int32_t* data() const
+        {
+            return reinterpret_cast<const int32_t*>(static_cast<const char*>(base) + header.data_offset);
+        }
+
+        size_t size() const
+        {
+            return is_open() ? size_t(header.words) : 0;
+        }
+
+        TensorView view() const
+        {
+            return TensorView(data(), size());
+        }
+
+    private:
+        void* base = nullptr;
+        size_t mapped = 0;
+
+        bool fail(const string& path, const char* why)
+        {
+            cerr << "Tensor Error: " << path << ": " << why << endl;
+            close();
+            return false;
+        }
+};
+
+// 寫 .bin (shape 以 packed word 計，相乘要等於 words)
+inline bool write_tensor(const string& path, const int32_t* data, size_t words, const vector<uint64_t>& shape,
+                         int dtype = DP_U8, int layout = TENSOR_ROW_MAJOR)
+{
+    if (shape.size() > TENSOR_MAX_RANK)
+    {
+        cerr << "Tensor Error: rank " << shape.size() << " > " << TENSOR_MAX_RANK << endl;
+        return false;
+    }
+    TensorHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TENSOR_MAGIC, 4);
+    header.version = TENSOR_VERSION;
+    header.dtype = dtype;
+    header.layout = layout;
+    header.rank = shape.size();
+    uint64_t count = 1;
+    for (size_t i = 0; i < shape.size(); i++)
+    {
+        header.shape[i] = shape[i];
+        count *= shape[i];
+    }
+    if (count != words)
+    {
+        cerr << "Tensor Error: shape does not match word count for " << path << endl;
+        return false;
+    }
+    header.words = words;
+    header.checksum = tensor_checksum(data, words);
+    header.data_offset = TENSOR_DATA_OFFSET;
+
+    ofstream out(path, ios::binary);
+    if (!out.is_open())
+    {
+        cerr << "Tensor Error: cannot open " << path << endl;
+        return false;
+    }
+    char padded[TENSOR_DATA_OFFSET] = {0};
+    memcpy(padded, &header, sizeof(header));
+    out.write(padded, TENSOR_DATA_OFFSET);
+    out.write(reinterpret_cast<const char*>(data), words * sizeof(int32_t));
+    return bool(out);
+}
+
+inline bool write_tensor(const string& path, const vector<int32_t>& data, const vector<uint64_t>& shape,
+                         int dtype = DP_U8, int layout = TENSOR_ROW_MAJOR)
+{
+    return write_tensor(path, data.data(), data.size(), shape, dtype, layout);
+}
@@ -1,52 +1,71 @@
 #include <iostream>
 #include <fstream>
 #include <iomanip>
-#include <sstream>
 #include <string>
 #include <vector>
 #include <array>
+#include <cstdlib>
+
+#include "../../src/PE/pe_spec.cpp"
+#include "tensor_file.cpp"
+#include "hex_loader.cpp"
 
 using namespace std;
 
-#define IFMAP_SIZE 3   // 3 個輸入 (12 bytes)
-#define NUM_WEIGHT 4   // 4 組 filter
-#define TOTAL_WEIGHT (IFMAP_SIZE * NUM_WEIGHT)  // 12 個 int32_t
 #define MODE 1
 
 
 
-vector<int32_t> read_hex_file(const string& filename);
-array<int32_t, NUM_WEIGHT> generate_golden_output
-(const array<int32_t, IFMAP_SIZE>& in_feature_spad, const array<int32_t, TOTAL_WEIGHT>& weight_spad);
-array<uint8_t, 4> get_bytes(int32_t value);
+TensorView open_pattern(TensorFile& bin, vector<int32_t>& txt, const string& stem);
+int check_tensor_file();
+int check_hex_loader();
 
-int main() 
+// usage: test [ifmap_size weight_h [datapath]]   (PE spad 大小 / datapath，要在 pe_spec_registry() 裡，預設 3 / 4 / u8)
+int main(int argc, char* argv[]) 
 {
+    int ifmap = 3, wh = 4, dp = DP_U8;
+    if (argc >= 3)
+    {
+        ifmap = atoi(argv[1]);
+        wh = atoi(argv[2]);
+    }
+    if (argc >= 4)
+        dp = dp_from_name(argv[3]);
+    const PESpec* spec = pe_spec_find(ifmap, wh, dp);
+    if (spec == nullptr)
+    {
+        cerr << "No PE specialization for this spad size / datapath. Available:\n";
+        pe_spec_list(cerr);
+        return 1;
+    }
+    if (check_tensor_file() + check_hex_loader() != 0)
+        return 1;
+    const int IFMAP_SIZE = spec->ifmap_size;
+    const int NUM_WEIGHT = spec->weight_h;
+
     int pattern_id = 3;
     int m = 64;
     int n = 128 * 8 * 8;
     int p = 256;
-    int n_div4 = n / 4;
+    int n_div4 = n / spec->lanes();
 
     cout << "--- GEMM Verification using test.cpp structure ---" << endl;
     cout << "Matrix Dimensions (int32_t elements):" << endl;
     cout << "  A: " << m << " x " << n << endl;
     cout << "  B: " << n << " x " << p << endl;
     cout << "  C: " << m << " x " << p << endl;
+    cout << "PE spad: ifmap " << IFMAP_SIZE << ", weight " << IFMAP_SIZE << " x " << NUM_WEIGHT << ", " << dp_name(spec->datapath) << endl;
     cout << "----------------------------------------------------" << endl;
 
 
     string folder = "Pattern" + to_string(pattern_id);
 
-    // 檔案名稱
-    string fileA = folder + "/A.txt";
-    string fileB = folder + "/B.txt";
-    string fileGolden = folder + "/C_golden.txt";
-
-    // 讀取
-    auto A = read_hex_file(fileA);
-    auto B = read_hex_file(fileB);
-    auto golden = read_hex_file(fileGolden);
+    // 讀取 (有 .bin 就 mmap，沒有才讀 .txt)
+    TensorFile A_bin, B_bin, golden_bin;
+    vector<int32_t> A_txt, B_txt, golden_txt;
+    TensorView A = open_pattern(A_bin, A_txt, folder + "/A");
+    TensorView B = open_pattern(B_bin, B_txt, folder + "/B");
+    TensorView golden = open_pattern(golden_bin, golden_txt, folder + "/C_golden");
 
     if (A.empty() || B.empty() || golden.empty()) 
     {
@@ -56,8 +75,8 @@ int main()
     //cout << "A[0]: "<< golden.size()<<endl;
     //cout << "golden[" << 1 * 4 << "]: "<< golden[1 * 4]<<endl;
 
-    array<int32_t, IFMAP_SIZE> in_feature_spad;
-    array<int32_t, TOTAL_WEIGHT> weight_spad;
+    vector<int32_t> in_feature_spad(IFMAP_SIZE);
+    vector<int32_t> weight_spad(IFMAP_SIZE * NUM_WEIGHT);
 
     bool all_pass = true;
     cout << "✅ Starting verification..." << endl;
@@ -66,14 +85,14 @@ int main()
     {
         for (int j = 0; j < p; j+=NUM_WEIGHT) 
         {
-            array<int32_t, NUM_WEIGHT> C;
-            array<int32_t, NUM_WEIGHT> sum = {0};
+            vector<int32_t> sum(NUM_WEIGHT, 0);
             for (int k = 0; k < n_div4; k+=IFMAP_SIZE) 
             {
+                // 最後一段不足 IFMAP_SIZE 時補 0
                 for(int l = 0; l < IFMAP_SIZE; l++)
                 {
                     int idxA = i * n_div4 + k + l;
-                    in_feature_spad[l] = A[idxA];
+                    in_feature_spad[l] = (k + l < n_div4) ? A[idxA] : 0;
                 }
                     
                 //cout << "in_feature_spad[0]: "<< in_feature_spad[0]<<endl;
@@ -82,24 +101,21 @@ int main()
                     for(int o = 0; o < NUM_WEIGHT; o++)
                     {
                         int idxB = (k + l) * p + j + o;
-                        weight_spad[l * NUM_WEIGHT + o] = B[idxB];
+                        weight_spad[l * NUM_WEIGHT + o] = (k + l < n_div4 && j + o < p) ? B[idxB] : 0;
                     }
                 //cout << "weight_spad[0]: "<< weight_spad[0]<<endl;
                 //取B12筆，為3*4
-                C = generate_golden_output(in_feature_spad, weight_spad);
-                //cout << "C[0]: "<< C[0]<<endl;
-                for(int l = 0; l < NUM_WEIGHT; l++)
-                    sum[l] += C[l];
+                spec->mac(in_feature_spad.data(), weight_spad.data(), sum.data());
             }
 
-            for(int l = 0; l < NUM_WEIGHT; l++)
+            for(int l = 0; l < NUM_WEIGHT && j + l < p; l++)
             {
                 //cout <<"sum[" << l <<"]: " << sum[l]<< endl;
                 //cout <<"Checking index " << i * n / 32 << " ... ";
                 //cout << j * 4 + l << "\n";
                 //cout <<"golden[" << i * n / 32 + j * 4 + l <<"]: " << golden[i * n / 32 + j * 4 + l]<< endl;
                 int golden_idx = i * p + (j + l);
-                if (sum[l] != golden[golden_idx]) 
+                if (!pe_psum_equal(sum[l], golden[golden_idx], spec->datapath)) 
                 {
                     cout << "❌ Mismatch at index " << golden_idx << endl;
                     cout << "Got=" << sum[l] << " "
@@ -120,69 +136,114 @@ int main()
     return 0;
 }
 
-vector<int32_t> read_hex_file(const string& filename) 
+TensorView open_pattern(TensorFile& bin, vector<int32_t>& txt, const string& stem)
 {
-    ifstream fin(filename);
-    if (!fin.is_open()) 
-    {
-        cerr << "❌ Cannot open file: " << filename << endl;
-        return {};
-    }
-    vector<int32_t> data;
-    string line;
-    while (getline(fin, line)) 
+    if (bin.open(stem + ".bin"))
+        return bin.view();
+    txt = read_hex_file(stem + ".txt");
+    return TensorView(txt);
+}
+
+// .bin 格式: 寫了再 mmap 讀回來，header / payload 要一樣，壞掉的檔案要被擋下來
+int check_tensor_file()
+{
+    int errors = 0;
+    auto expect = [&](const char* name, bool ok)
     {
-        if (line.empty()) continue;
-        int32_t val;
-        stringstream ss(line);
-        ss >> hex >> val;
-        if (ss.fail()) 
+        if (!ok)
         {
-            cerr << "⚠️  Invalid line in " << filename << ": " << line << endl;
-            continue;
+            cout << "Tensor file: " << name << " <-- MISMATCH!" << endl;
+            errors++;
         }
-        data.push_back(val);
+    };
+    const string path = "_tensor_check.bin";
+    vector<int32_t> data = {1, -1, 0, int32_t(0x80000000), 0x7FFFFFFF, 0x12345678};
+    expect("write", write_tensor(path, data, {2, 3}, DP_INT8, TENSOR_COL_MAJOR));
+    {
+        TensorFile file;
+        expect("open", file.open(path));
+        expect("header", file.header.rank == 2 && file.header.shape[0] == 2 && file.header.shape[1] == 3
+                         && file.header.words == 6 && file.header.dtype == DP_INT8 && file.header.layout == TENSOR_COL_MAJOR
+                         && file.header.data_offset == TENSOR_DATA_OFFSET);
+        expect("payload", file.size() == data.size() && equal(data.begin(), data.end(), file.view().begin()));
+    }
+    cerr << "(expected) ";
+    expect("shape / word count mismatch is rejected", !write_tensor(path + ".bad", data, {4, 2}));
+
+    // payload 改一個 byte: checksum 擋下來，verify = false 時還是可以打開
+    {
+        fstream f(path, ios::in | ios::out | ios::binary);
+        f.seekp(TENSOR_DATA_OFFSET + 5);
+        f.put(char(0x5A));
+    }
+    {
+        TensorFile file;
+        cerr << "(expected) ";
+        expect("corrupt payload is rejected", !file.open(path));
+        expect("corrupt payload opens without verify", file.open(path, false) && file.view()[1] != -1);
+    }
+    // 截掉最後一個 word
+    {
+        vector<char> bytes(TENSOR_DATA_OFFSET + data.size() * 4);
+        ifstream in(path, ios::binary);
+        in.read(bytes.data(), bytes.size());
+        in.close();
+        ofstream out(path, ios::binary | ios::trunc);
+        out.write(bytes.data(), bytes.size() - 4);
+    }
+    {
+        TensorFile file;
+        cerr << "(expected) ";
+        expect("truncated file is rejected", !file.open(path));
+        expect("missing file", !file.open(path + ".missing"));
     }
-    return data;
+    remove(path.c_str());
+    cout << "Tensor file round trip: " << (errors == 0 ? "match" : "MISMATCH") << endl;
+    return errors;
 }
 
-array<int32_t, NUM_WEIGHT> generate_golden_output(const array<int32_t, IFMAP_SIZE>& in_feature_spad, const array<int32_t, TOTAL_WEIGHT>& weight_spad)
+// .txt loader: 0x 開頭 / 前後空白 / '\r' / 最高位元是 1 的 word，空白行和格式不對的行跳過
+// 大檔案切成好幾段平行 parse，結果要和單 thread 一樣 (段和段的接縫在行中間也不能錯)
+int check_hex_loader()
 {
-    array<array<uint8_t, 4>, IFMAP_SIZE> in_feature_bytes = {get_bytes(in_feature_spad[0]),
-                                                             get_bytes(in_feature_spad[1]),
-                                                             get_bytes(in_feature_spad[2])};
-    array<array<uint8_t, 4>, TOTAL_WEIGHT> weight_bytes = {get_bytes(weight_spad[0]),  get_bytes(weight_spad[1]),
-                                                            get_bytes(weight_spad[2]),  get_bytes(weight_spad[3]),
-                                                            get_bytes(weight_spad[4]),  get_bytes(weight_spad[5]),
-                                                            get_bytes(weight_spad[6]),  get_bytes(weight_spad[7]),
-                                                            get_bytes(weight_spad[8]),  get_bytes(weight_spad[9]),
-                                                            get_bytes(weight_spad[10]), get_bytes(weight_spad[11])};
-    
-    array<int32_t, NUM_WEIGHT> golden_output = {0};
-    for (int j = 0; j < NUM_WEIGHT; j++) 
+    int errors = 0;
+    auto expect = [&](const char* name, bool ok)
     {
-        for (int i = 0; i < IFMAP_SIZE; i++) 
+        if (!ok)
         {
-            int idx = i * NUM_WEIGHT + j;
-            //cout << "in_feature_bytes["<<i<<"][0]: "<<int(in_feature_bytes[i][0])<<endl;
-            golden_output[j] += in_feature_bytes[i][0] *
-                                weight_bytes[idx][0] +
-                                in_feature_bytes[i][1] *
-                                weight_bytes[idx][1] +
-                                in_feature_bytes[i][2] *
-                                weight_bytes[idx][2] +
-                                in_feature_bytes[i][3] *
-                                weight_bytes[idx][3];
+            cout << "Hex loader: " << name << " <-- MISMATCH!" << endl;
+            errors++;
         }
+    };
+    const string path = "_hex_check.txt";
+    {
+        ofstream out(path);
+        out << "0x1A2B3C4D\n  ffffffff\r\n\nzz\n\t0X00000010 \n00000001";  // 最後一行沒有換行
     }
-    return golden_output;
-}
+    vector<int32_t> small = {7};  // 接在原本的資料後面
+    cerr << "(expected) ";
+    expect("small file", load_hex_file(small, path, 1));
+    expect("small values", small == vector<int32_t>({7, 0x1A2B3C4D, -1, 16, 1}));
 
-array<uint8_t, 4> get_bytes(int32_t value) 
-{                                   
-    array<uint8_t, 4> bytes{};
-    for (int i = 0; i < 4; ++i)
-        bytes[i] = (value >> (8 * i)) & 0xFF;
-    //may need to dequantize here
-    return bytes;
-}
\ No newline at end of file
+    const int lines = 300000;  // 約 2.7 MB，4 個 thread 時每段都超過 256 KB
+    vector<int32_t> expected;
+    {
+        ofstream out(path);
+        for (int i = 0; i < lines; i++)
+        {
+            int32_t v = int32_t(uint32_t(i) * 2654435761u);
+            if (i % 1000 == 0)
+                out << "\n";
+            out << hex << setw(8) << setfill('0') << uint32_t(v) << "\n";
+            expected.push_back(v);
+        }
+    }
+    vector<int32_t> one, four;
+    expect("large file", load_hex_file(one, path, 1) && load_hex_file(four, path, 4));
+    expect("large file single thread", one == expected);
+    expect("large file 4 threads", four == expected);
+    expect("missing file", !load_hex_file(one, path + ".missing"));
+    remove(path.c_str());
+    cout << "Hex loader (1 / 4 threads): " << (errors == 0 ? "match" : "MISMATCH") << endl;
+    return errors;
+}
@@ -6,13 +6,217 @@
 
 using namespace std;
 
-int main()
+// usage: tb_pe_array [pe_rows pe_cols [ifmap_size weight_h [datapath [zero_gating [psum_reduction [double_buffer
+//                    [glb_banks glb_ports [glb_interleave [glb_outstanding [dram_model [dma [trace_file [loop_order [pipeline [threads]]]]]]]]]]]]]]]
+//                    [--fast[=N]] [--sample[=N]] [--validate] [--seed=S] [--pattern=NAME]
+//                    [--checkpoint=FILE] [--checkpoint-every=N] [--stop-after=N] [--restore=FILE]
+//        (default 6 x 8, 3 / 4, u8, none, chain, 0, 1 bank x 1 port, word, 1, 0, 0)
+// datapath: u8 | int4 | int8 | int16 | bf16
+// zero_gating: none | clock | skip
+// psum_reduction: chain | tree
+// double_buffer: 0 | 1 (ping-pong spad, load 和 compute 重疊)
+// glb_interleave: word | block | xor
+// glb_outstanding: 每個 GLB port 最多幾個 request 在路上 (1 = 逐一等完)
+// dram_model: 0 | 1 (DRAM 用 row buffer / burst / refresh 的 timing model)
+// dma: 0 | 1 (DMA engine 在 compute 時 prefetch 下一個 tile，結果寫回不等)
+// trace_file: GLB / DRAM 的 memory trace 寫到這個檔案 (analayzer/trace_report 分析，預設不記，"-" 也是不記)
+// loop_order: 外三層 tiling 的順序，o (out_feature) / i (in_feature) / b (batch) 的排列，預設 oib
+// pipeline: 0 | 1 (scoreboard 排 load / compute / store，互不相干的 stage 重疊；0 = 依序加總)
+// threads: 平行模擬的 thread 數，output tile (out_feature x batch) 分給各個 thread (0 = 全部 core，預設 1；dram_model / dma / pipeline / trace 時只能 1)
+// --fast[=N] (任何位置): functional GEMM + analytic cycle，不經過 PE array；抽 N 個 output tile 和 detailed model 比對 (預設 2，0 = 不比)
+//     self-check 不合時 Result Verification 是 FAILED (exit code 1)
+//     速度 (Pattern3，單 core): detailed ~420 ms，--fast=0 ~8 ms (~51x)，--fast (2 個 tile 的 self-check) ~21 ms (~20x)，沒有達到 100x 的目標
+// --sample[=N]: sampled simulation，tile 分類後每類隨機抽 N 個 (預設 8) 跑，外插 total cycles / GLB traffic (95% CI)
+// --validate: sampled 之外再跑一次完整的 simulation 對照，--seed=S: 抽樣的 random seed (預設 1)
+// --pattern=NAME: 測試資料的資料夾 (預設 Pattern3)
+// --checkpoint=FILE: 每 N 個 micro-op (--checkpoint-every，預設 100000) 把完整的 simulator state 存到 FILE (背景寫檔)
+// --stop-after=N: 跑到第 N 個 micro-op 存 checkpoint 後停下來，--restore=FILE: 從 checkpoint 接著跑
+int main(int argc, char* argv[])
 {
-    TileBasedSimulator simulator;
+    int pe_rows = PE_Array::DEFAULT_PE_V;
+    int pe_cols = PE_Array::DEFAULT_PE_H;
+    int ifmap_size = PE::IFMAP_SIZE;
+    int weight_h = PE::WEIGHT_H;
+    int datapath = DP_U8;
+    int zero_gating = GATE_NONE;
+    int psum_reduction = REDUCE_CHAIN;
+    bool double_buffer = false;
+    int glb_banks = 1;
+    int glb_ports = 1;
+    int glb_interleave = GLB_INTERLEAVE_WORD;
+    int glb_outstanding = 1;
+    bool dram_model = false;
+    bool dma = false;
+    string trace_path;
+    string loop_order = "oib";
+    bool pipeline = false;
+    int threads = 1;
+    bool fast = false;
+    int fast_check_tiles = 2;
+    int sample_tiles = 0;
+    bool sample_validate = false;
+    unsigned sample_seed = 1;
+    string pattern = "Pattern3";
+    string checkpoint_path;
+    long long checkpoint_every = 100000;
+    long long stop_after = 0;
+    string restore_path;
+    vector<char*> args;
+    for (int i = 0; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--fast" || arg.rfind("--fast=", 0) == 0)
+        {
+            fast = true;
+            if (arg.size() > 7)
+                fast_check_tiles = atoi(arg.c_str() + 7);
+            continue;
+        }
+        if (arg == "--sample" || arg.rfind("--sample=", 0) == 0)
+        {
+            sample_tiles = arg.size() > 9 ? atoi(arg.c_str() + 9) : 8;
+            continue;
+        }
+        if (arg == "--validate")
+        {
+            sample_validate = true;
+            continue;
+        }
+        if (arg.rfind("--seed=", 0) == 0)
+        {
+            sample_seed = unsigned(strtoul(arg.c_str() + 7, nullptr, 10));
+            continue;
+        }
+        if (arg.rfind("--pattern=", 0) == 0)
+        {
+            pattern = arg.substr(10);
+            continue;
+        }
+        if (arg.rfind("--checkpoint=", 0) == 0)
+        {
+            checkpoint_path = arg.substr(13);
+            continue;
+        }
+        if (arg.rfind("--checkpoint-every=", 0) == 0)
+        {
+            checkpoint_every = atoll(arg.c_str() + 19);
+            continue;
+        }
+        if (arg.rfind("--stop-after=", 0) == 0)
+        {
+            stop_after = atoll(arg.c_str() + 13);
+            continue;
+        }
+        if (arg.rfind("--restore=", 0) == 0)
+        {
+            restore_path = arg.substr(10);
+            continue;
+        }
+        args.push_back(argv[i]);
+    }
+    argc = int(args.size());
+    argv = args.data();
+    if (argc >= 3)
+    {
+        pe_rows = atoi(argv[1]);
+        pe_cols = atoi(argv[2]);
+    }
+    if (argc >= 5)
+    {
+        ifmap_size = atoi(argv[3]);
+        weight_h = atoi(argv[4]);
+    }
+    if (argc >= 6)
+    {
+        datapath = dp_from_name(argv[5]);
+        if (datapath < 0)
+        {
+            cerr << "Unknown datapath " << argv[5] << " (u8 | int4 | int8 | int16 | bf16)\n";
+            return 1;
+        }
+    }
+    if (argc >= 7)
+    {
+        zero_gating = gating_from_name(argv[6]);
+        if (zero_gating < 0)
+        {
+            cerr << "Unknown zero gating " << argv[6] << " (none | clock | skip)\n";
+            return 1;
+        }
+    }
+    if (argc >= 8)
+    {
+        psum_reduction = reduction_from_name(argv[7]);
+        if (psum_reduction < 0)
+        {
+            cerr << "Unknown psum reduction " << argv[7] << " (chain | tree)\n";
+            return 1;
+        }
+    }
+    if (argc >= 9)
+        double_buffer = atoi(argv[8]) != 0;
+    if (argc >= 11)
+    {
+        glb_banks = atoi(argv[9]);
+        glb_ports = atoi(argv[10]);
+    }
+    if (argc >= 12)
+    {
+        glb_interleave = glb_interleave_from_name(argv[11]);
+        if (glb_interleave < 0)
+        {
+            cerr << "Unknown GLB interleave " << argv[11] << " (word | block | xor)\n";
+            return 1;
+        }
+    }
+    if (argc >= 13)
+        glb_outstanding = atoi(argv[12]);
+    if (argc >= 14)
+        dram_model = atoi(argv[13]) != 0;
+    if (argc >= 15)
+        dma = atoi(argv[14]) != 0;
+    if (argc >= 16)
+        trace_path = string(argv[15]) == "-" ? "" : argv[15];
+    if (argc >= 17)
+    {
+        loop_order = argv[16];
+        if (!controller::valid_order(loop_order))
+        {
+            cerr << "Unknown loop order " << loop_order << " (permutation of o / i / b, e.g. oib)\n";
+            return 1;
+        }
+    }
+    if (argc >= 18)
+        pipeline = atoi(argv[17]) != 0;
+    if (argc >= 19)
+        threads = atoi(argv[18]);
+    TileBasedSimulator simulator(pe_rows, pe_cols, ifmap_size, weight_h);
+    simulator.hardware.zero_gating = zero_gating;
+    simulator.hardware.psum_reduction = psum_reduction;
+    simulator.hardware.double_buffer = double_buffer;
+    simulator.hardware.glb_banks = glb_banks;
+    simulator.hardware.glb_ports = glb_ports;
+    simulator.hardware.glb_interleave = glb_interleave;
+    simulator.hardware.glb_outstanding = glb_outstanding;
+    simulator.hardware.dram_model = dram_model;
+    simulator.hardware.dma = dma;
+    simulator.trace_path = trace_path;
+    simulator.hardware.pipeline = pipeline;
+    simulator.loop_order = loop_order;
+    simulator.threads = threads;
+    simulator.fast = fast;
+    simulator.fast_check_tiles = fast_check_tiles;
+    simulator.sample_tiles = sample_tiles;
+    simulator.sample_validate = sample_validate;
+    simulator.sample_seed = sample_seed;
+    simulator.checkpoint_path = checkpoint_path;
+    simulator.checkpoint_every = checkpoint_every;
+    simulator.stop_after = stop_after;
+    simulator.restore_path = restore_path;
     LinearShapeParam linear;
     linear.B = 64;
     linear.in_features = 128 * 8 * 8;
     linear.out_features = 256;
-    simulator.run(linear, "Pattern3");
-    return 0;
+    linear.datapath = datapath;
+    return simulator.run(linear, pattern) ? 0 : 1;
 }
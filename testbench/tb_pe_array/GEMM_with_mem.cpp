@@ -1,16 +1,30 @@
 #include <iostream>
 #include <vector>
-#include <sstream>
 #include <string>
 #include <array>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <unordered_set>
+#include <unordered_map>
+#include <sstream>
 
 #include "../../src/PE/pe_array.cpp"
+#include "../../src/MEM/glb.cpp"
+#include "../../src/MEM/dram.cpp"
+#include "../../src/MEM/dma.cpp"
+#include "../../src/controller.cpp"
+#include "../../src/scoreboard.cpp"
+#include "../../src/tile_plan.cpp"
+#include "../../src/sampling.cpp"
+#include "../../src/checkpoint.cpp"
 #include "../../analayzer/mapper.cpp"
+#include "../Pattern/tensor_file.cpp"
+#include "../Pattern/hex_loader.cpp"
 
 using namespace std;
 using DataType = int32_t;
 
-void load_data(vector<DataType> &mem, const string &filename);
 
 class TileBasedSimulator 
 {
@@ -19,246 +33,1061 @@ class TileBasedSimulator
         LinearShapeParam shape;
         PE_Array pe_array;
 
-        // latency 模型 (可微調)
-        static constexpr int IF_LOAD_LAT     = 3;
-        static constexpr int W_LOAD_LAT      = 12;
-        static constexpr int COMPUTE_LAT     = 48;  
-        static constexpr int PSUM_ACC_LAT    = 6;
-        static constexpr int PSUM_STORE_LAT  = 4;
+        // latency 模型 (可微調)，跟 spad 大小有關的在 run_simulation() 依 PESpec 設定
+        int IF_LOAD_LAT     = 3;
+        int W_LOAD_LAT      = 12;
+        int COMPUTE_LAT     = 48;  
+        int PSUM_ACC_LAT    = 6;  // reduction network 的 latency (PE_Array::reduction_cycles())
+        int PSUM_STORE_LAT  = 4;
 
-        static constexpr int GLB_ACCESS  = 2;
-        static constexpr int DRAM_ACCESS  = 5;
+        static constexpr int GLB_ACCESS  = 2;  // 一個 GLB bank access 的 cycle
+        static constexpr int DRAM_ACCESS  = 5;  // 沒有 dram_model 時每個 word 的 cycle (dma 時 DMA engine 也用這個)
 
         long long int total_cycles = 0;
-        array<int, 6> w_base = {0};
-        array<int, 6> r_base = {0};
+        long long int gated_cycles_saved = 0;  // GATE_SKIP 省下的 compute cycle
+        long long int pending_compute = 0;     // double_buffer: 還沒算進 total_cycles 的上一個 tile compute
+        long long int overlap_saved = 0;       // double_buffer: load 藏在 compute 後面省下的 cycle
+
+        // GLB: ifmap / weight / psum 各一段 region，tensor index 取 region 大小的餘數當 address
+        GLB glb;
+        int ifmap_region = 0;
+        int weight_region = 0;
+        int psum_region = 0;
+        vector<int> glb_batch;  // 一起發出的 GLB request address
+
+        // DRAM (hardware.dram_model): A [B][in_div4]、B [in_div4][out_features]、C [B][out_features] 依序 row-major 放
+        DRAM dram;
+        long long int weight_dram_base = 0;
+        long long int psum_dram_base = 0;
+
+        // DMA (hardware.dma): weight / ifmap tile 由 DMA engine 搬，提早一個 tile 發出 (GLB 裡 ping-pong)，
+        // 結果寫回不等；沒有 dma 但有 dram_model 時發出後馬上等 (= 原本 inline 的 DRAM latency)
+        DMAEngine dma;
+        int dma_slot[controller::NUM_SLOTS];  // micro-op 的 transfer slot -> DMA transfer id
+
+        // tile loop 由 controller 編成 micro-op 執行
+        controller ctrl;
+        TilePlan plan;           // 每個 tile 搬資料的 index (mapping 固定，compile 一次)
+        int in_div4 = 0;
+        long long int load_lat = 0;  // 這個 k tile 目前的 load cycle (COMPUTE 時結算)
+
+        // hardware.pipeline: cycle 由 scoreboard 排 (stage 之間照 dependency 重疊)，否則 stage 依序加進 total_cycles
+        Scoreboard sb;
+
+        shared_ptr<TraceRecorder> trace = make_shared<TraceRecorder>();  // trace_path 不是空的時候記 GLB / DRAM traffic
+
+        // fast mode: GLB access 的 cost 依 bank pattern 的相位記下來 (fast_glb[FAST_*][phase])
+        // 開始時 GLB 不是空的 (pipeline 時前一個 stage 還佔著 port) 再加上 port 的狀態 (GLB::relative_state) 當 key，
+        // 重疊的方式有限，每個 kind 最多記 FAST_GLB_STATES 種
+        enum { FAST_IFMAP = 0, FAST_WEIGHT, FAST_PSUM_IN, FAST_PSUM_OUT, FAST_KINDS };
+        static constexpr size_t FAST_GLB_STATES = 1 << 14;
+        vector<GLBAccessCost> fast_glb[FAST_KINDS];
+        unordered_map<vector<long long>, GLBAccessCost, GLBStateHash> fast_glb_busy[FAST_KINDS];
+        vector<long long> fast_glb_key;
+        int fast_period = 0;           // GLB::bank_period()
+        vector<int> fast_group;        // PE -> ifmap multicast 組 (-1 = 沒用到的 PE)
+        vector<int> fast_zero_lanes;   // 上一個 LOAD_IF 每組的 0 lane 數 (zero gating 用)
+        long long int fast_macs_executed = 0;
+        long long int fast_macs_gated = 0;
+
+        // sampled simulation: total_cycles / GLB traffic / MAC counter 是外插的估計值
+        enum
+        {
+            SAMPLE_CYCLES = 0, SAMPLE_GLB_READS, SAMPLE_GLB_WRITES, SAMPLE_GLB_CONFLICTS, SAMPLE_GLB_STALL,
+            SAMPLE_MACS_EXECUTED, SAMPLE_MACS_GATED, SAMPLE_GATED_SAVED, SAMPLE_OVERLAP_SAVED, SAMPLE_METRICS
+        };
+        bool sampled = false;
+        StratifiedEstimate sample_est[SAMPLE_METRICS];
+
+        // checkpoint / restore: 背景 thread 寫檔 (複製 simulator 時共用，只有主要的 run 會寫)
+        shared_ptr<CheckpointWriter> checkpoints = make_shared<CheckpointWriter>();
+        bool stopped = false;  // 跑到 stop_after 停下來 (結果還沒算完)
+        bool self_check_ok = true;  // fast mode 抽樣和 detailed model 比對的結果 (不合算 verification FAILED)
 
     public:
-        TileBasedSimulator()
+        EyerissHardwareParam hardware;
+        string trace_path;  // memory trace 的輸出檔 (analayzer/trace_report.cpp 分析)
+        string loop_order = "oib";  // 外三層 tiling 的順序 (見 controller.cpp)
+        int threads = 1;  // 平行模擬的 worker 數 (0 = hardware_concurrency)，output tile (outf x batch) 切給 worker
+        // fast mode: final_psums 用 packed GEMM 直接算，cycle 照同一個 micro-op program 算 (不經過 PE_Array)
+        // Pattern3 上 packed GEMM 約 3.5 ms，analytic cycle (20 萬個 micro-op，GLB 的 port 狀態每次要寫回) 約 4.3 ms，合起來 ~51x，還沒到 100x；
+        // GEMM kernel 是 compute bound (column block 調小反而變慢)，要再快得兩邊都減半
+        bool fast = false;
+        int fast_check_tiles = 2;  // fast mode 抽幾個 output tile 和 detailed model 比對 (0 = 不比)
+        // sampled simulation: (output tile, in_feature tile) 分類後每類隨機抽 sample_tiles 個跑 (至少 2 個，0 = 全部跑)
+        int sample_tiles = 0;
+        bool sample_validate = false;  // 另外跑一次完整的 simulation，印估計值和實際值的對照
+        unsigned sample_seed = 1;
+        // checkpoint: checkpoint_path 不是空的時候每 checkpoint_every 個 micro-op 存一次 (同一個檔案，最新的蓋掉舊的)
+        // restore_path: 從 checkpoint 接著跑 (shape / mapping / GLB / DRAM / DMA / pipeline 的設定都要一樣，
+        // 只有 zero gating / psum reduction 這種只影響之後 compute cycle 的可以不一樣，用來從同一個點分出幾個 what-if)
+        // stop_after: 跑到第 stop_after 個 micro-op 就存 checkpoint 停下來 (0 = 跑完)
+        string checkpoint_path;
+        long long checkpoint_every = 100000;
+        string restore_path;
+        long long stop_after = 0;
+
+        TileBasedSimulator(int pe_array_h = PE_Array::DEFAULT_PE_V, int pe_array_w = PE_Array::DEFAULT_PE_H,
+                           int ifmap_size = PE::IFMAP_SIZE, int weight_h = PE::WEIGHT_H)
         {
-            
+            hardware = EyerissMapper::default_hardware(pe_array_h, pe_array_w, ifmap_size, weight_h);
         }
 
-        void run_simulation(const vector<DataType>& all_in_features,
-                            const vector<DataType>& all_weights,
+        void run_simulation(TensorView all_in_features,
+                            TensorView all_weights,
                             vector<DataType>& final_psums)
         {
             total_cycles = 0;
-            switch (map.mode)
+            gated_cycles_saved = 0;
+            pending_compute = 0;
+            overlap_saved = 0;
+            load_lat = 0;
+            IF_LOAD_LAT = pe_array.ifmap_size;
+            W_LOAD_LAT = pe_array.weight_size;
+            COMPUTE_LAT = pe_array.spec.macs();
+            PSUM_STORE_LAT = pe_array.psum_size;
+            PSUM_ACC_LAT = pe_array.reduction_cycles();
+            glb = GLB(hardware.glb_size / DATA_SIZE, hardware.glb_banks, hardware.glb_ports, GLB_ACCESS, hardware.glb_interleave,
+                      hardware.glb_outstanding);
+            ifmap_region = glb.size / 4;
+            weight_region = glb.size / 2;
+            psum_region = glb.size - ifmap_region - weight_region;
+            dram = DRAM(hardware.dram);
+            if (trace->is_open())
             {
-                case 1:
-                {
-                    w_base[0] = 40;
+                glb.trace = trace.get();
+                dram.trace = trace.get();
+            }
+            dma = DMAEngine(hardware.dram_model ? &dram : nullptr, DRAM_ACCESS);
+            sb.reset();
+            sb.set_capacity(UNIT_GLB, hardware.glb_banks * hardware.glb_ports);  // glb 的 utilization 和每個 bank 的平均一樣
+            fast_macs_executed = 0;
+            fast_macs_gated = 0;
+            cout << "\n=== Start GEMM Tile Simulation ===" << endl;
+
+            // 外層 tiling 順序依據 PDF：K → N → M → B → in_feature → out_feature (loop_order 可以換外三層)
+            in_div4 = ceil(double(shape.in_features) / double(pe_array.lanes)); // packed words per row
+            // tensor 之間對齊到 DRAM row
+            int row_words = dram.timing.row_words;
+            weight_dram_base = ((long long int)shape.B * in_div4 + row_words - 1) / row_words * row_words;
+            psum_dram_base = weight_dram_base + ((long long int)in_div4 * shape.out_features + row_words - 1) / row_words * row_words;
 
-                    r_base[0] = 0;
+            // DRAM 以 tile 為單位搬 (dram_model / dma) 時每個 tile 一個 DMA transfer，否則照原本每層 loop 固定的 cycle
+            ControllerConfig config;
+            config.loop_order = loop_order;
+            config.dram = (hardware.dram_model || hardware.dma) ? CTRL_DRAM_TILE : CTRL_DRAM_FLAT;
+            config.prefetch = hardware.dma;
+            config.dram_word_cycles = DRAM_ACCESS;
+            if (!plan.compile(map, shape, in_div4, pe_array))
+                exit(1);
+            sampled = sample_tiles > 0 && sampling_supported();
+            stopped = false;
+            self_check_ok = true;
+            if ((fast || sampled) && checkpointing())
+                cout << "   checkpoint / restore needs the detailed model: not used in fast / sampled mode" << endl;
+            if (sampled)
+            {
+                // 功能結果用 packed GEMM，cycle 由抽到的 tile 外插
+                plan.print_stats(cout);
+                fast_gemm(all_in_features, all_weights, final_psums);
+                run_sampled(config, all_in_features, all_weights);
+                cout << "=== Simulation Finished ===" << endl << endl;
+                return;
+            }
+            if (fast)
+            {
+                // controller 邊產生 op 邊執行 (不存 program)
+                fast_prepare();
+                fast_gemm(all_in_features, all_weights, final_psums);
+                ctrl.sink = [&](const MicroOp& op) { run_op(op, all_in_features, all_weights, final_psums); };
+            }
+            bool compiled = ctrl.compile(map, shape, in_div4, pe_array.ifmap_size, pe_array.weight_h, config);
+            ctrl.sink = nullptr;
+            if (!compiled)
+                exit(1);
+            ctrl.print_stats(cout);
+            plan.print_stats(cout);
+            
+            cout << "in_div4: " << in_div4 << ", out_features: " << shape.out_features << endl;
+            if (fast)
+            {
+                cout << "Fast mode: packed GEMM (" << pe_kernel_name(PEKernelDispatch::kernel) << ") + analytic cycle accounting" << endl;
+            }
+            else
+            {
+                int workers = parallel_workers();
+                if (workers > 1)
+                    run_parallel(workers, config, all_in_features, all_weights, final_psums);
+                else if (checkpointing())
+                    run_checkpointed(all_in_features, all_weights, final_psums);
+                else
+                    run_program(all_in_features, all_weights, final_psums);
+            }
+            if (hardware.pipeline)
+                total_cycles = sb.finish();
+            if (fast && fast_check_tiles > 0)
+                self_check_ok = fast_self_check(config, all_in_features, all_weights, final_psums);
+
+            cout << "=== Simulation Finished ===" << endl << endl;
+            //cout << "Total cycles: " << total_cycles << endl;
+        }
+
+        // 依序執行 ctrl.program
+        void run_program(TensorView all_in_features, TensorView all_weights, vector<DataType>& final_psums)
+        {
+            for (const MicroOp& op : ctrl.program)
+                run_op(op, all_in_features, all_weights, final_psums);
+        }
+
+        void run_op(const MicroOp& op, TensorView all_in_features, TensorView all_weights, vector<DataType>& final_psums)
+        {
+            if (hardware.pipeline)
+            {
+                pipeline_op(op, all_in_features, all_weights, final_psums);
+                return;
+            }
+            switch (op.op)
+            {
+                case UOP_LOAD_PSUM:
+                    total_cycles += load_psum(op, final_psums, total_cycles);
+                    break;
+                case UOP_LOAD_IF:
+                    load_lat += load_ifmap(op, all_in_features, total_cycles + load_lat);
+                    break;
+                case UOP_LOAD_W:
+                    load_lat += load_weight(op, all_weights, total_cycles + load_lat);
+                    break;
+                case UOP_COMPUTE:
+                {
+                    // load 和 compute (double_buffer 時和上一個 tile 的 compute 重疊，見 schedule_tile())
+                    // zero gating 時 latency 會比 COMPUTE_LAT 短
+                    int compute_lat = compute_tile();
+                    total_cycles += schedule_tile(load_lat, compute_lat);
+                    gated_cycles_saved += COMPUTE_LAT - compute_lat;
+                    load_lat = 0;
                     break;
                 }
-                case 2:
+                case UOP_ACC_PSUM:
+                    total_cycles += flush_compute(); // psum 要等最後一個 tile 算完
+                    total_cycles += PSUM_ACC_LAT;
+                    accumulate_psum();
+                    break;
+                case UOP_STORE_PSUM:
+                    total_cycles += store_psum(op, final_psums, total_cycles);
+                    break;
+                case UOP_DMA_W:
+                    dma_slot[op.slot] = dma.submit(weight_desc(op.a, op.b), total_cycles);
+                    break;
+                case UOP_DMA_IF:
+                    dma_slot[op.slot] = dma.submit(ifmap_desc(op.b, op.c), total_cycles);
+                    break;
+                case UOP_DMA_STORE:
+                    dma_slot[op.slot] = dma.submit(psum_desc(op.a, op.c, op.d), total_cycles);
+                    break;
+                case UOP_DMA_WAIT:
+                    total_cycles += dma.wait(dma_slot[op.slot], total_cycles);
+                    break;
+                case UOP_DRAM:
+                    total_cycles += op.a;
+                    break;
+                case UOP_BARRIER:
+                    total_cycles += dma.wait_all(total_cycles); // 最後的 write back
+                    break;
+            }
+        }
+
+        bool checkpointing() const
+        {
+            return !checkpoint_path.empty() || !restore_path.empty() || stop_after > 0;
+        }
+
+        // ctrl.program 從頭 (或 restore_path 的位置) 執行，每 checkpoint_every 個 op 存一次 checkpoint
+        void run_checkpointed(TensorView all_in_features, TensorView all_weights, vector<DataType>& final_psums)
+        {
+            uint64_t pc = 0;
+            if (!restore_path.empty() && !restore_checkpoint(pc, final_psums))
+                exit(1);
+            uint64_t first = pc;
+            for (; pc < ctrl.program.size(); pc++)
+            {
+                bool stop = stop_after > 0 && pc == uint64_t(stop_after);
+                bool every = checkpoint_every > 0 && pc % uint64_t(checkpoint_every) == 0;
+                if (pc != first && !checkpoint_path.empty() && (stop || every))
+                    save_checkpoint(pc, final_psums);
+                if (stop)
+                {
+                    stopped = true;
+                    cout << "Stopped before micro-op " << pc << " of " << ctrl.program.size() << " (cycle "
+                         << (hardware.pipeline ? sb.now() : total_cycles) << ")" << endl;
+                    return;
+                }
+                run_op(ctrl.program[pc], all_in_features, all_weights, final_psums);
+            }
+        }
+
+        // micro-op 之間的完整狀態: 執行到哪 (pc)、cycle / counter、final_psums、PE array、GLB / DRAM / DMA / scoreboard
+        // controller 的 program 由設定決定 (restore 時重新 compile)，input tensor 是唯讀的
+        template <typename Archive>
+        void checkpoint(Archive& ar, uint64_t& pc, vector<DataType>& final_psums)
+        {
+            ar.io(pc);
+            ar.io(total_cycles);
+            ar.io(gated_cycles_saved);
+            ar.io(pending_compute);
+            ar.io(overlap_saved);
+            ar.io(load_lat);
+            ar.io(dma_slot);
+            ar.io(final_psums);
+            pe_array.checkpoint(ar);
+            glb.checkpoint(ar);
+            dram.checkpoint(ar);
+            dma.checkpoint(ar);
+            sb.checkpoint(ar);
+        }
+
+        // state 的大小、micro-op program 和 GLB / DRAM 的 timing 由這些決定，不一樣的 checkpoint 不能接
+        uint64_t checkpoint_fingerprint() const
+        {
+            ostringstream s;
+            const DRAMTimingParam& t = dram.timing;
+            s << shape.B << " " << shape.in_features << " " << shape.out_features << " " << shape.datapath << " | " << map.tk << " "
+              << map.tn << " " << map.mode << " " << map.M << " " << map.K << " " << map.N << " | " << pe_array.pe_v << " "
+              << pe_array.pe_h << " " << pe_array.ifmap_size << " " << pe_array.weight_h << " " << pe_array.double_buffer << " | "
+              << glb.size << " " << glb.num_banks << " " << glb.ports << " " << glb.access_cycles << " " << glb.interleave << " "
+              << glb.block_words << " " << glb.max_outstanding << " | " << hardware.dram_model << " " << hardware.dma << " "
+              << hardware.pipeline << " " << DRAM_ACCESS << " | " << t.channels << " " << t.banks << " " << t.row_words << " "
+              << t.burst_words << " " << t.tRCD << " " << t.tCAS << " " << t.tRP << " " << t.tBURST << " " << t.tREFI << " "
+              << t.tRFC << " " << t.open_page << " | " << loop_order;
+            return checkpoint_hash(s.str());
+        }
+
+        void save_checkpoint(uint64_t pc, vector<DataType>& final_psums)
+        {
+            auto start = chrono::steady_clock::now();
+            SnapshotWriter w;
+            checkpoint(w, pc, final_psums);
+            checkpoints->serialize_seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            checkpoints->submit(checkpoint_path, checkpoint_fingerprint(), move(w.bytes));
+        }
+
+        bool restore_checkpoint(uint64_t& pc, vector<DataType>& final_psums)
+        {
+            auto start = chrono::steady_clock::now();
+            vector<uint8_t> payload;
+            if (!CheckpointWriter::read(restore_path, checkpoint_fingerprint(), payload))
+                return false;
+            size_t psums = final_psums.size();
+            SnapshotReader r(payload);
+            checkpoint(r, pc, final_psums);
+            if (!r.done() || final_psums.size() != psums || pc > ctrl.program.size())
+            {
+                cerr << "Checkpoint Error: " << restore_path << " does not match this simulator state" << endl;
+                return false;
+            }
+            cout << "Restored " << restore_path << ": micro-op " << pc << " of " << ctrl.program.size() << ", cycle "
+                 << (hardware.pipeline ? sb.now() : total_cycles)
+                 << " (" << payload.size() / 1024 << " KB, " << fixed << setprecision(3)
+                 << chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e3 << " ms)" << defaultfloat << setprecision(6) << endl;
+            return true;
+        }
+
+        // 平行模擬的 worker 數: output tile (out_feature tile x batch tile) 互相獨立 (final_psums 的區塊不重疊，
+        // STORE_PSUM 之後 PE array 的 psum 都清掉)，只有 cycle 是全部加起來的時候才能切；
+        // DRAM / DMA / scoreboard 有跨 tile 的時間狀態，trace 要照順序
+        int parallel_workers() const
+        {
+            if (threads == 1)
+                return 1;
+            if (hardware.dram_model || hardware.dma || hardware.pipeline || trace->is_open() || checkpointing())
+            {
+                cout << "   parallel simulation needs flat DRAM, no DMA / pipeline / trace / checkpoint: running on 1 thread" << endl;
+                return 1;
+            }
+            int n = threads > 0 ? threads : max(1, int(thread::hardware_concurrency()));
+            return min(n, ctrl.output_tiles());
+        }
+
+        // 每個 worker 一段連續的 output tile: 自己的 PE_Array / GLB 和只有那一段的 micro-op program，
+        // 做完照 worker 順序把 counter 加回來，結果和 total_cycles 跟單 thread 一樣
+        void run_parallel(int workers, const ControllerConfig& config, TensorView all_in_features, TensorView all_weights,
+                          vector<DataType>& final_psums)
+        {
+            int tiles = ctrl.output_tiles();
+            PEThreadPool pool(workers);
+            vector<TileBasedSimulator> parts(workers, *this);
+            for (int t = 0; t < workers; t++)
+            {
+                pair<int, int> range = pool.band(t, tiles);
+                ControllerConfig part_config = config;
+                part_config.tile_begin = range.first;
+                part_config.tile_end = range.second;
+                parts[t].ctrl.compile(map, shape, in_div4, pe_array.ifmap_size, pe_array.weight_h, part_config);
+            }
+            cout << "Parallel simulation: " << workers << " workers, " << tiles << " output tiles" << endl;
+            pool.run([&](int t) { parts[t].run_program(all_in_features, all_weights, final_psums); });
+            for (const TileBasedSimulator& part : parts)
+            {
+                total_cycles += part.total_cycles;
+                gated_cycles_saved += part.gated_cycles_saved;
+                overlap_saved += part.overlap_saved;
+                glb.merge_stats(part.glb);
+                pe_array.merge_counters(part.pe_array);
+            }
+        }
+
+        // sampled simulation 要每個 tile 的 cycle 只看自己的 op (和 parallel_workers() 一樣的條件)
+        bool sampling_supported() const
+        {
+            if (hardware.dram_model || hardware.dma || hardware.pipeline || trace->is_open())
+            {
+                cout << "   sampled simulation needs flat DRAM, no DMA / pipeline / trace: running the full simulation" << endl;
+                return false;
+            }
+            return true;
+        }
+
+        // unit = 一個 (out_feature tile, in_feature tile, batch tile)，controller 的 tile 範圍只取這一個時
+        // 所有 unit 的 op 合起來剛好是完整的 program，serial 的 total_cycles / GLB counter 就是各個 unit 的和
+        // 每一維分成 first (第一個 tile) / body / edge (最後一個 tile):
+        //   in_feature first 沒有 LOAD_PSUM，out_feature / batch first 多了外層 loop 的 DRAM cycle，
+        //   edge 可能不滿或讀到 tensor 外面 (邊界檢查後搬的 element 少)
+        // 3 x 3 x 3 類各自隨機抽 sample_tiles 個 (不放回) 跑，用 StratifiedEstimate 外插
+        void run_sampled(const ControllerConfig& config, TensorView all_in_features, TensorView all_weights)
+        {
+            int extent[3] = {shape.out_features, in_div4, shape.B};
+            int step[3] = {map.N * pe_array.weight_h, map.K * pe_array.ifmap_size, map.M};
+            int tiles[3];
+            int lo[3][3];
+            int hi[3][3];
+            for (int d = 0; d < 3; d++)
+            {
+                tiles[d] = (extent[d] + step[d] - 1) / step[d];
+                int body_end = max(1, tiles[d] - 1);
+                lo[d][0] = 0;
+                hi[d][0] = 1;
+                lo[d][1] = 1;
+                hi[d][1] = body_end;
+                lo[d][2] = body_end;
+                hi[d][2] = tiles[d];
+            }
+            if (fast)
+                fast_prepare();
+            TileBasedSimulator proto(*this);
+            proto.sample_tiles = 0;
+            proto.glb.reset();
+
+            auto sim_start = chrono::steady_clock::now();
+            static const char* part_name[3] = {"first", "body", "edge"};
+            int per_class = max(2, sample_tiles);
+            mt19937_64 rng(sample_seed);
+            vector<DataType> scratch((size_t)shape.B * shape.out_features, 0);  // 抽樣 tile 的 psum (不用)
+            for (StratifiedEstimate& e : sample_est)
+                e = StratifiedEstimate();
+            long long units = 0;
+            long long simulated = 0;
+            cout << "Sampled simulation: " << tiles[0] << " x " << tiles[1] << " x " << tiles[2]
+                 << " (out_feature x in_feature x batch) tiles, " << per_class << " per class, seed " << sample_seed << endl;
+            cout << "   " << left << setw(8) << "outf" << setw(8) << "inf" << setw(8) << "batch" << right << setw(12) << "tiles"
+                 << setw(10) << "sampled" << setw(14) << "mean cycles" << setw(12) << "stddev" << endl;
+            for (int co = 0; co < 3; co++)
+            {
+                for (int ci = 0; ci < 3; ci++)
                 {
-                    w_base[0] = 16;
-                    w_base[1] = 40;
+                    for (int cb = 0; cb < 3; cb++)
+                    {
+                        long long size[3] = {hi[0][co] - lo[0][co], hi[1][ci] - lo[1][ci], hi[2][cb] - lo[2][cb]};
+                        long long population = size[0] * size[1] * size[2];
+                        if (population <= 0)
+                            continue;
+                        // 不大的類別整類都跑
+                        vector<long long> picks;
+                        if (population <= per_class)
+                        {
+                            for (long long k = 0; k < population; k++)
+                                picks.push_back(k);
+                        }
+                        else
+                        {
+                            unordered_set<long long> seen;
+                            while ((int)picks.size() < per_class)
+                            {
+                                long long k = (long long)(rng() % (unsigned long long)population);
+                                if (seen.insert(k).second)
+                                    picks.push_back(k);
+                            }
+                        }
+                        SampleStat stat[SAMPLE_METRICS];
+                        for (long long k : picks)
+                        {
+                            int o = lo[0][co] + int(k / (size[1] * size[2]));
+                            int i = lo[1][ci] + int(k / size[2] % size[1]);
+                            int b = lo[2][cb] + int(k % size[2]);
+                            ControllerConfig unit_config = config;
+                            unit_config.tile_begin = o * tiles[2] + b;
+                            unit_config.tile_end = unit_config.tile_begin + 1;
+                            unit_config.inf_begin = i;
+                            unit_config.inf_end = i + 1;
+                            TileBasedSimulator u = proto;
+                            u.ctrl.compile(map, shape, in_div4, pe_array.ifmap_size, pe_array.weight_h, unit_config);
+                            u.run_program(all_in_features, all_weights, scratch);
+                            long long value[SAMPLE_METRICS];
+                            u.sample_metrics(value);
+                            for (int m = 0; m < SAMPLE_METRICS; m++)
+                                stat[m].add(double(value[m]));
+                        }
+                        for (int m = 0; m < SAMPLE_METRICS; m++)
+                            sample_est[m].add(population, stat[m]);
+                        units += population;
+                        simulated += (long long)picks.size();
+                        cout << "   " << left << setw(8) << part_name[co] << setw(8) << part_name[ci] << setw(8) << part_name[cb] << right
+                             << setw(12) << population << setw(10) << picks.size() << setw(14) << fixed << setprecision(1)
+                             << stat[SAMPLE_CYCLES].mean << setw(12) << sqrt(stat[SAMPLE_CYCLES].variance()) << defaultfloat << endl;
+                    }
+                }
+            }
+            double sample_seconds = chrono::duration<double>(chrono::steady_clock::now() - sim_start).count();
+            total_cycles = llround(sample_est[SAMPLE_CYCLES].total);
+            gated_cycles_saved = llround(sample_est[SAMPLE_GATED_SAVED].total);
+            overlap_saved = llround(sample_est[SAMPLE_OVERLAP_SAVED].total);
 
-                    r_base[0] = 0;
-                    r_base[1] = 24;
+            static const char* metric_name[SAMPLE_METRICS] = {"cycles", "GLB reads", "GLB writes", "GLB conflicts", "GLB stall",
+                                                              "MACs executed", "MACs gated", "gated saved", "overlap saved"};
+            cout << "Sampled " << simulated << " of " << units << " tiles (" << fixed << setprecision(2)
+                 << 100.0 * simulated / max(1LL, units) << "%) in " << sample_seconds * 1e3 << " ms, estimates (95% CI):" << endl;
+            for (int m = 0; m < SAMPLE_METRICS; m++)
+            {
+                const StratifiedEstimate& e = sample_est[m];
+                cout << "   " << left << setw(14) << metric_name[m] << right << setw(16) << setprecision(0) << e.total << " +- "
+                     << e.half_width() << " (" << setprecision(3) << 100.0 * e.half_width() / max(1.0, e.total) << "%)" << endl;
+            }
+            cout << defaultfloat << setprecision(6);
+            if (!sample_validate)
+                return;
+
+            // validation: 同樣的 model 整個 program 跑一次
+            auto full_start = chrono::steady_clock::now();
+            TileBasedSimulator full = proto;
+            full.ctrl.compile(map, shape, in_div4, pe_array.ifmap_size, pe_array.weight_h, config);
+            full.run_program(all_in_features, all_weights, scratch);
+            double full_seconds = chrono::duration<double>(chrono::steady_clock::now() - full_start).count();
+            long long actual[SAMPLE_METRICS];
+            full.sample_metrics(actual);
+            bool all_in = true;
+            bool exact = simulated == units;  // 每個 tile 都跑了: 估計值要和完整的一模一樣
+            cout << "Sampled vs full simulation:" << endl;
+            cout << "   " << left << setw(14) << "metric" << right << setw(16) << "estimate" << setw(14) << "95% CI" << setw(16)
+                 << "full" << setw(10) << "error" << setw(8) << "in CI" << endl;
+            for (int m = 0; m < SAMPLE_METRICS; m++)
+            {
+                const StratifiedEstimate& e = sample_est[m];
+                bool in = exact ? llround(e.total) == actual[m] : e.contains(double(actual[m]));
+                all_in = all_in && in;
+                cout << "   " << left << setw(14) << metric_name[m] << right << fixed << setprecision(0) << setw(16) << e.total
+                     << setw(14) << e.half_width() << setw(16) << actual[m] << setw(9) << setprecision(3)
+                     << 100.0 * (e.total - double(actual[m])) / max(1.0, double(actual[m])) << "%" << setw(8) << (in ? "yes" : "NO")
+                     << defaultfloat << endl;
+            }
+            cout << "   sampled " << sample_seconds * 1e3 << " ms, full " << full_seconds * 1e3 << " ms ("
+                 << full_seconds / max(1e-9, sample_seconds) << "x)" << endl;
+            const char* verdict = exact ? (all_in ? "every tile sampled, exact" : "every tile sampled, MISMATCH")
+                                        : (all_in ? "all within CI" : "OUTSIDE CI");
+            cout << "Sampling validation: " << verdict << setprecision(6) << endl;
+        }
+
+        void sample_metrics(long long value[SAMPLE_METRICS]) const
+        {
+            value[SAMPLE_CYCLES] = total_cycles;
+            value[SAMPLE_GLB_READS] = glb.total_reads();
+            value[SAMPLE_GLB_WRITES] = glb.total_writes();
+            value[SAMPLE_GLB_CONFLICTS] = glb.total_conflicts();
+            value[SAMPLE_GLB_STALL] = glb.total_stall_cycles();
+            value[SAMPLE_MACS_EXECUTED] = fast ? fast_macs_executed : pe_array.total_macs_executed();
+            value[SAMPLE_MACS_GATED] = fast ? fast_macs_gated : pe_array.total_macs_gated();
+            value[SAMPLE_GATED_SAVED] = gated_cycles_saved;
+            value[SAMPLE_OVERLAP_SAVED] = overlap_saved;
+        }
+
+        // hardware.pipeline: 功能上照 program 順序做，每個 stage 何時開始由 scoreboard 依 unit / register 決定
+        void pipeline_op(const MicroOp& op, TensorView all_in_features, TensorView all_weights, vector<DataType>& final_psums)
+        {
+            const unsigned spads = pipe_reg(REG_IF_FILL) | pipe_reg(REG_W_FILL);
+            const unsigned psum = pipe_reg(REG_PSUM);
+            switch (op.op)
+            {
+                case UOP_LOAD_PSUM:
+                {
+                    long long int start = sb.begin(PIPE_LOAD_PSUM, pipe_reg(REG_GLB_PSUM), psum);
+                    long long int busy = glb.total_busy_cycles();
+                    long long int latency = load_psum(op, final_psums, start);
+                    sb.end(latency, 0, glb.total_busy_cycles() - busy);
                     break;
                 }
-                case 3:
+                case UOP_LOAD_IF:
                 {
-                    w_base[0] = 8;
-                    w_base[1] = 24;
-                    w_base[2] = 40;
-
-                    r_base[0] = 0;
-                    r_base[1] = 16;
-                    r_base[2] = 32;
+                    long long int start = sb.begin(PIPE_LOAD_IF, pipe_reg(REG_GLB_TILE), pipe_reg(REG_IF_FILL));
+                    long long int busy = glb.total_busy_cycles();
+                    long long int latency = load_ifmap(op, all_in_features, start);
+                    sb.end(latency, 0, glb.total_busy_cycles() - busy);
                     break;
                 }
-                case 6:
+                case UOP_LOAD_W:
+                {
+                    long long int start = sb.begin(PIPE_LOAD_W, pipe_reg(REG_GLB_TILE), pipe_reg(REG_W_FILL));
+                    long long int busy = glb.total_busy_cycles();
+                    long long int latency = load_weight(op, all_weights, start);
+                    sb.end(latency, 0, glb.total_busy_cycles() - busy);
+                    break;
+                }
+                case UOP_COMPUTE:
+                {
+                    // double_buffer 時 compute 一開始就 swap，fill spad 馬上可以給下一個 tile 的 load
+                    sb.begin(PIPE_COMPUTE, spads | psum, psum);
+                    int compute_lat = compute_tile();
+                    gated_cycles_saved += COMPUTE_LAT - compute_lat;
+                    sb.end(compute_lat, pe_array.double_buffer ? spads : 0);
+                    break;
+                }
+                case UOP_ACC_PSUM:
+                    sb.begin(PIPE_ACC_PSUM, psum, psum);
+                    accumulate_psum();
+                    sb.end(PSUM_ACC_LAT);
+                    break;
+                case UOP_STORE_PSUM:
+                {
+                    // 讀完 PE 的 psum 就 reset，下一個 tile 的 LOAD_PSUM / COMPUTE 要等它
+                    long long int start = sb.begin(PIPE_STORE_PSUM, psum, psum | pipe_reg(REG_GLB_PSUM));
+                    long long int busy = glb.total_busy_cycles();
+                    long long int latency = store_psum(op, final_psums, start);
+                    sb.end(latency, 0, glb.total_busy_cycles() - busy);
+                    break;
+                }
+                // DMA: prefetch 時 GLB 裡 ping-pong 直接發，否則要等還在讀這塊 GLB 的 load 做完
+                case UOP_DMA_W:
+                    dma_slot[op.slot] = dma.submit(weight_desc(op.a, op.b), tile_submit_cycle());
+                    break;
+                case UOP_DMA_IF:
+                    dma_slot[op.slot] = dma.submit(ifmap_desc(op.b, op.c), tile_submit_cycle());
+                    break;
+                case UOP_DMA_STORE:
+                    dma_slot[op.slot] = dma.submit(psum_desc(op.a, op.c, op.d), max(sb.now(), sb.ready(REG_GLB_PSUM)));
+                    break;
+                case UOP_DMA_WAIT:
                 {
-                    r_base[0] = w_base[0] = 0;
-                    r_base[1] = w_base[1] = 8;
-                    r_base[2] = w_base[2] = 16;
-                    r_base[3] = w_base[3] = 24;
-                    r_base[4] = w_base[4] = 32;
-                    r_base[5] = w_base[5] = 40;
+                    long long int now = sb.now();
+                    long long int ready = now + dma.wait(dma_slot[op.slot], now);
+                    if (op.slot == controller::SLOT_STORE)
+                        sb.extend(ready);
+                    else
+                        sb.produce(REG_GLB_TILE, ready);
                     break;
                 }
+                case UOP_DRAM:
+                    sb.begin(PIPE_DRAM, 0, pipe_reg(REG_GLB_TILE));
+                    sb.end(op.a);
+                    break;
+                case UOP_BARRIER:
+                    sb.extend(sb.finish() + dma.wait_all(sb.finish()));
+                    break;
             }
-            cout << "\n=== Start GEMM Tile Simulation ===" << endl;
+        }
 
-            // 外層 tiling 順序依據 PDF：K → N → M → B → in_feature → out_feature
-            int in_div4 = ceil(double(shape.in_features) / double(PE::WEIGHT_H));
-            
-            cout << "in_div4: " << in_div4 << ", out_features: " << shape.out_features << endl;
-            for (int outf = 0; outf < shape.out_features; outf += map.N * PE::WEIGHT_H) 
+        // COMPUTE: PE array 做一個 k tile，回傳 latency (GATE_SKIP 時最慢的 PE 決定)
+        int compute_tile()
+        {
+            if (fast)
+                return fast_compute();
+            pe_array.swap_spads();
+            return pe_array.compute_full_all();
+        }
+
+        // ACC_PSUM: reduction network 把每組的 psum 加起來
+        void accumulate_psum()
+        {
+            if (fast)
+                return;
+            pe_array.out_valid_all();
+            pe_array.add_ipsum_all();
+        }
+
+        long long int tile_submit_cycle() const
+        {
+            return hardware.dma ? sb.now() : max(sb.now(), sb.free_at(REG_GLB_TILE));
+        }
+
+        // 上一個 in_feature tile 的 psum 從 GLB 讀回 PE (每組第一個 row)
+        long long int load_psum(const MicroOp& op, const vector<DataType>& final_psums, long long int start)
+        {
+            if (fast)
+                return fast_glb_access(FAST_PSUM_IN, plan.psum_in, op, final_psums.size(), ifmap_region + weight_region, psum_region, false, start);
+            const TileGather& g = plan.psum_in;
+            bool interior = g.interior(op.a, final_psums.size(), op.b, shape.out_features);
+            int32_t* psum = pe_array.psum_plane.data();
+            glb_batch.clear();
+            for (size_t e = 0; e < g.size(); e++)
+            {
+                int32_t pe_input = 0;
+                if (interior || g.valid(e, op.a, final_psums.size(), op.b, shape.out_features))
+                {
+                    int in_idx = op.a + g.offset[e];
+                    pe_input = final_psums[in_idx];
+                    glb_batch.push_back(psum_addr(in_idx));
+                }
+                psum[g.plane[e]] = pe_psum_add(psum[g.plane[e]], pe_input, pe_array.datapath);
+            }
+            return glb.access(glb_batch, false, start, TRACE_REQ_PSUM);
+        }
+
+        // ifmap: 每組 tk 個 row，同一個 word multicast 到 tn 個 PE，GLB 只讀一次
+        long long int load_ifmap(const MicroOp& op, TensorView all_in_features, long long int start)
+        {
+            if (fast)
+            {
+                if (pe_array.gating != GATE_NONE)
+                    fast_count_zero_lanes(op, all_in_features);
+                return fast_glb_access(FAST_IFMAP, plan.ifmap, op, all_in_features.size(), 0, ifmap_region, false, start);
+            }
+            const TileGather& g = plan.ifmap;
+            bool interior = g.interior(op.a, all_in_features.size(), op.b, shape.out_features);
+            int32_t* fill = pe_array.ifmap_fill().data();
+            glb_batch.clear();
+            for (size_t e = 0; e < g.size(); e++)
+            {
+                int32_t in_data = 0;
+                if (interior || g.valid(e, op.a, all_in_features.size(), op.b, shape.out_features))
+                {
+                    int inf_index = op.a + g.offset[e];
+                    in_data = all_in_features[inf_index];
+                    glb_batch.push_back(ifmap_addr(inf_index));
+                }
+                fill_n(fill + g.plane[e], g.multicast, in_data);
+            }
+            return glb.access(glb_batch, false, start, TRACE_REQ_IFMAP);
+        }
+
+        // weight: 每個 PE 一塊 weight_h x ifmap_size，最後一個 out_feature tile 超出的 column 補 0，不要讀到下一個 row
+        long long int load_weight(const MicroOp& op, TensorView all_weights, long long int start)
+        {
+            if (fast)
+                return fast_glb_access(FAST_WEIGHT, plan.weight, op, all_weights.size(), ifmap_region, weight_region, false, start);
+            const TileGather& g = plan.weight;
+            bool interior = g.interior(op.a, all_weights.size(), op.b, shape.out_features);
+            int32_t* fill = pe_array.weight_fill().data();
+            glb_batch.clear();
+            for (size_t e = 0; e < g.size(); e++)
             {
-                //cout << "\n--- Processing out_feature tile starting at " << outf << " ---\n";
-                total_cycles += DRAM_ACCESS * shape.B * map.N * PE::WEIGHT_H; // DRAM access for weight
-                total_cycles += DRAM_ACCESS * map.K * PE::IFMAP_SIZE * map.M; // DRAM access for input feature
-                for (int inf = 0; inf < in_div4; inf += map.K * PE::IFMAP_SIZE) 
+                int32_t weight_data = 0;
+                if (interior || g.valid(e, op.a, all_weights.size(), op.b, shape.out_features))
                 {
-                    for (int b = 0; b < shape.B; b += map.M) 
+                    int weight_index = op.a + g.offset[e];
+                    weight_data = all_weights[weight_index];
+                    glb_batch.push_back(weight_addr(weight_index));
+                }
+                fill[g.plane[e]] = weight_data;
+            }
+            return glb.access(glb_batch, false, start, TRACE_REQ_WEIGHT);
+        }
+
+        // 每組最後一個 row 的 psum 寫回 final_psums (經過 GLB)，讀完的 PE reset
+        long long int store_psum(const MicroOp& op, vector<DataType>& final_psums, long long int start)
+        {
+            if (fast)
+                return fast_glb_access(FAST_PSUM_OUT, plan.psum_out, op, final_psums.size(), ifmap_region + weight_region, psum_region, true, start);
+            const TileGather& g = plan.psum_out;
+            bool interior = g.interior(op.a, final_psums.size(), op.b, shape.out_features);
+            const int32_t* psum = pe_array.psum_plane.data();
+            glb_batch.clear();
+            for (size_t e = 0; e < g.size(); e++)
+            {
+                if (interior || g.valid(e, op.a, final_psums.size(), op.b, shape.out_features))
+                {
+                    int out_idx = op.a + g.offset[e];
+                    final_psums[out_idx] = psum[g.plane[e]];
+                    glb_batch.push_back(psum_addr(out_idx));
+                }
+            }
+            for (int num : plan.out_pes)
+            {
+                pe_array.out_valid[num] = false; // reset out_valid after reading
+                pe_array.reset_psum(num);
+            }
+            return glb.access(glb_batch, true, start, TRACE_REQ_PSUM);
+        }
+
+        // ===== fast mode =====
+
+        // ifmap multicast 組 (plan.ifmap 的 PE 位置) 和每組 0 lane 的 counter
+        void fast_prepare()
+        {
+            fast_group.assign(pe_array.num_pe, -1);
+            int groups = 0;
+            for (int32_t pos : plan.ifmap.plane)
+            {
+                int pe = pos % pe_array.num_pe;
+                if (fast_group[pe] < 0)
+                {
+                    for (int j = 0; j < plan.ifmap.multicast; j++)
+                        fast_group[pe + j] = groups;
+                    groups++;
+                }
+            }
+            fast_zero_lanes.assign(groups, 0);
+            fast_period = glb.bank_period();
+            for (vector<GLBAccessCost>& memo : fast_glb)
+                memo.assign(fast_period, GLBAccessCost());
+            for (auto& memo : fast_glb_busy)
+                memo.clear();
+        }
+
+        // final_psums = A x B，tensor 比 B x in_div4 / in_div4 x out_features 小的部分補 0 (和 load 時超出的一樣)
+        // load_ifmap / load_weight 是照 tensor 的 flat index 搬的: in_div4 不是 inf tile 的倍數時最後一個 tile 會讀到下一個 row
+        // (超出 tensor 的補 0)，所以 K 方向取到 tile 的邊界，A / W 照同樣的 index 攤開再做 GEMM (結果和 PE model 一樣)
+        void fast_gemm(TensorView all_in_features, TensorView all_weights, vector<DataType>& final_psums)
+        {
+            int step = map.K * pe_array.ifmap_size;
+            int k_span = (in_div4 + step - 1) / step * step;
+            size_t a_words = (size_t)shape.B * k_span;
+            size_t w_words = (size_t)k_span * shape.out_features;
+            vector<int32_t> a_pad, w_pad;
+            const int32_t* a = all_in_features.begin();
+            const int32_t* w = all_weights.begin();
+            if (k_span != in_div4 || all_in_features.size() < a_words)
+            {
+                a_pad.assign(a_words, 0);
+                for (int r = 0; r < shape.B; r++)
+                {
+                    size_t from = (size_t)r * in_div4;
+                    size_t to = min(all_in_features.size(), from + k_span);
+                    if (from < to)
+                        copy(all_in_features.begin() + from, all_in_features.begin() + to, a_pad.begin() + (size_t)r * k_span);
+                }
+                a = a_pad.data();
+            }
+            if (all_weights.size() < w_words)
+            {
+                w_pad.assign(w_words, 0);
+                copy(all_weights.begin(), all_weights.end(), w_pad.begin());
+                w = w_pad.data();
+            }
+            final_psums.assign((size_t)shape.B * shape.out_features, 0);
+            pe_gemm_packed(a, w, final_psums.data(), shape.B, k_span, shape.out_features, pe_array.datapath);
+        }
+
+        // GLB 的 cost 只看 address 對到的 bank 順序: tile 整個在 tensor 裡的時候同一個 kind 只差 address 的相位
+        // (GLB::bank_period)，每個相位 access 一次就記下來；region 裡 wrap 的話 region 大小要是 period 的倍數 (相位不變)
+        long long int fast_glb_access(int kind, const TileGather& g, const MicroOp& op, size_t tensor_size, int region_base,
+                                      int region_size, bool is_write, long long int start)
+        {
+            bool interior = g.interior(op.a, tensor_size, op.b, shape.out_features);
+            GLBAccessCost* cost = nullptr;
+            if (interior && fast_period > 0)
+            {
+                int local = op.a % region_size;
+                if (local + g.max_offset < region_size || region_size % fast_period == 0)
+                {
+                    int phase = (region_base + local) % fast_period;
+                    if (glb.idle_at(start))
+                        cost = &fast_glb[kind][phase];
+                    else
                     {
-                        for (int m = 0; m < map.M; m += map.mode) 
-                        {
-                            for (int n = 0; n < map.N * PE::WEIGHT_H; n += map.tn * PE::WEIGHT_H) 
-                            {
-                                //load pusm
-                                if(inf != 0)
-                                {
-                                    total_cycles += GLB_ACCESS * PSUM_STORE_LAT * map.mode * map.tn;
-                                    //cout << "load psum to PE array\n";
-                                    for(int i = 0; i < map.tn * map.mode; i++)
-                                    {
-                                        int num = r_base[i / PE_Array::PE_H] + i % PE_Array::PE_H;
-                                        //cout << "\n=== PE[" << num << "] add psum ";
-                                        for (int j = 0; j < PE::WEIGHT_H; j++)
-                                        {
-                                            //in_idx need to be checked
-                                            int in_idx = (b * shape.out_features + outf) 
-                                                            + (n) + m * shape.out_features + i / map.tn * shape.out_features + (i % map.tn) * PE::WEIGHT_H + j;
-                                            int32_t pe_input;
-                                            if (in_idx < 0 || in_idx >= final_psums.size()) 
-                                            {
-                                                pe_input = 0;
-                                                //cout << "ERROR: in_idx out of range: " << in_idx << endl;
-                                                //cerr << "b: " << b << ", outf: " << outf << ", n: " << n << ", m: " << m << ", i: " << i << ", j: " << j << endl;
-                                                //exit(1);
-                                            }
-                                            else
-                                            {
-                                                pe_input = final_psums[in_idx];
-                                            }
-                                            //cout <<"at index["<< in_idx << "], " ;
-                                            pe_array.pe[num].add_ipsum(pe_input, j);
-                                        }
-                                        //cout << endl;
-                                    } 
-                                }
-                                //cout << "read input feature\n";
-                                // read input feature & weight & compute
-                                for (int k = 0; k < map.K * PE::IFMAP_SIZE; k += map.tk * PE::IFMAP_SIZE) 
-                                {
-                                    // 模擬 tile loading
-                                    total_cycles += GLB_ACCESS * map.mode * map.tk * IF_LOAD_LAT;//read in_feature
-                                    total_cycles += GLB_ACCESS * PE_Array::NUM_PE * W_LOAD_LAT;//read weight
-
-                                    // 模擬 tile compute (乘加)
-                                    total_cycles += COMPUTE_LAT;
-
-                                    //呼叫 PE 模型做實際運算
-                                    //set input feature
-                                    //cout << "read in_feature\n";
-                                    for(int l = 0; l < PE::IFMAP_SIZE * map.tk * map.mode; l++)
-                                    {
-                                        int idx_f = (b * in_div4 + m * in_div4 + inf) + k;
-                                        for(int i = 0; i < map.tn; i++)
-                                        {
-                                            int pe_index = i + (l / PE::IFMAP_SIZE) * PE_Array::PE_H;
-                                            int inf_index = idx_f + (l / map.tk / PE::IFMAP_SIZE * in_div4) + l % (map.tk * PE::IFMAP_SIZE);
-                                            int in_data;
-                                            if (pe_index >= PE_Array::NUM_PE) 
-                                            {
-                                                cerr << "pe_index out of range: " << pe_index << endl;
-                                                exit(1);
-                                            }
-                                            if (inf_index >= all_in_features.size()) 
-                                            {
-                                                in_data = 0;
-                                                //cout << "inf_index out of range: " << inf_index << endl;
-                                                //cerr << "b: " << b << ", m: " << m << ", inf: " << inf << ", k: " << k << ", l: " << l << ", i: " << i << endl;
-                                                //exit(1);
-                                            }
-                                            else
-                                            {
-                                                in_data = all_in_features[inf_index];
-                                            }
-                                            
-                                            //cout << "PE[" << pe_index << "]" <<".[" << l % PE::IFMAP_SIZE << "] " << "load in_feature from index[" << inf_index << "]\n";
-                                            pe_array.pe[pe_index].in_feature_spad[l % PE::IFMAP_SIZE] = in_data;                                            
-                                        }
-
-                                    }
-                                    //cout << "read weight\n";
-                                    //set weight
-                                    for(int l = 0; l < PE::WEIGHT_SIZE * map.tn * map.tk * map.mode; l++)
-                                    {
-                                        int pe_index = (l / PE::WEIGHT_SIZE) % PE_Array::PE_V * PE_Array::PE_H 
-                                                        + (l / PE::WEIGHT_SIZE / PE_Array::PE_V);
-                                        int idx_w = (inf * shape.out_features + outf) + k * shape.out_features + n;
-                                        int weight_index = idx_w + l % PE::WEIGHT_H 
-                                                            + ((l / PE::WEIGHT_H) % (map.tk * PE::IFMAP_SIZE)) * shape.out_features 
-                                                            + (l / PE::WEIGHT_SIZE / PE_Array::PE_V) * PE::WEIGHT_H;
-                                        int weight_data;
-                                        if (pe_index >= PE_Array::NUM_PE) 
-                                        {
-                                            cerr << "pe_index out of range: " << pe_index << endl;
-                                            exit(1);
-                                        }
-                                        if (weight_index >= all_weights.size()) 
-                                        {
-                                            weight_data = 0;
-                                            //cout << "weight_index out of range: " << weight_index << endl;
-                                            //cerr << "inf: " << inf << ", outf: " << outf << ", k: " << k << ", n: " << n << ", l: " << l << endl;
-                                            //exit(1);
-                                        }
-                                        else
-                                        {
-                                            weight_data = all_weights[weight_index];
-                                        }
-                                        //cout << "PE[" << pe_index << "] load weight from index[" << weight_index << "]\n";
-                                        pe_array.pe[pe_index].weight_spad[l % PE::WEIGHT_SIZE] = weight_data;
-                                    }
-
-                                    //compute
-                                    //cout << "start compute\n";
-                                    pe_array.compute_full_all();
-
-                                }
-                                //cout << "write back psum\n";
-                                // write psum(acc and store)
-                                total_cycles += PSUM_ACC_LAT;
-                                //write back psum to GLB
-                                total_cycles += GLB_ACCESS * PSUM_STORE_LAT * map.mode * map.tn;
-                                // accumulate psum
-                                pe_array.out_valid_all();
-                                pe_array.add_ipsum_all();
-                                // read psum from PE and write back to final_psums
-                                for(int i = 0; i < map.tn * map.mode; i++)
-                                {
-                                    int num = w_base[i / PE_Array::PE_H] + i % PE_Array::PE_H;
-                                    //cout << "\n=== PE[" << num << "] Output ===\n";
-                                    for (int j = 0; j < PE::WEIGHT_H; j++)
-                                    {
-                                        int32_t pe_output = pe_array.pe[num].output_psum(j);
-                                        //out_idx need to be checked
-                                        int out_idx = (b * shape.out_features + outf) + (n) + m * shape.out_features + i / map.tn * shape.out_features + (i % map.tn) * PE::WEIGHT_H + j;
-    
-                                        if (out_idx < final_psums.size()) 
-                                        {
-                                            final_psums[out_idx] = pe_output;
-                                        }
-                                        else
-                                        {
-                                            //cout << "ERROR: out_idx out of range: " << out_idx << endl;
-                                            //exit(1);
-                                        }
-                                        
-                                    }
-                                    pe_array.pe[num].out_valid = false; // reset out_valid after reading
-                                    pe_array.pe[num].reset_psum();
-                                }
-                            }
-                        }
-                        total_cycles += DRAM_ACCESS * map.K * PE::IFMAP_SIZE * map.M; // DRAM access for input feature
+                        glb.relative_state(start, fast_glb_key);
+                        fast_glb_key.push_back(phase);
+                        auto found = fast_glb_busy[kind].find(fast_glb_key);
+                        if (found != fast_glb_busy[kind].end())
+                            cost = &found->second;
+                        else if (fast_glb_busy[kind].size() < FAST_GLB_STATES)
+                            cost = &fast_glb_busy[kind][fast_glb_key];
+                    }
+                    if (cost != nullptr && cost->valid)
+                        return glb.apply(*cost, start);
+                }
+            }
+            glb_batch.clear();
+            for (size_t e = 0; e < g.size(); e++)
+            {
+                if (interior || g.valid(e, op.a, tensor_size, op.b, shape.out_features))
+                    glb_batch.push_back(region_base + (op.a + g.offset[e]) % region_size);
+            }
+            if (cost == nullptr)
+                return glb.access(glb_batch, is_write, start);
+            *cost = glb.measure(glb_batch, is_write, start);
+            return cost->latency;
+        }
+
+        // LOAD_IF 的 ifmap 每組有幾個 0 lane (同一組的 PE 拿到一樣的 ifmap)
+        void fast_count_zero_lanes(const MicroOp& op, TensorView all_in_features)
+        {
+            const TileGather& g = plan.ifmap;
+            fill(fast_zero_lanes.begin(), fast_zero_lanes.end(), 0);
+            for (size_t e = 0; e < g.size(); e++)
+            {
+                long long int index = op.a + g.offset[e];
+                int32_t word = index >= 0 && index < (long long int)all_in_features.size() ? all_in_features[index] : 0;
+                fast_zero_lanes[fast_group[g.plane[e] % pe_array.num_pe]] += pe_zero_lanes(&word, 1, pe_array.datapath);
+            }
+        }
+
+        // 和 PE_Array::compute_full_all() 一樣的 latency / MAC counter，沒用到的 PE ifmap 一直是 0 (全部 gate 掉)
+        int fast_compute()
+        {
+            int macs = pe_array.spec.macs();
+            int num_pe = pe_array.num_pe;
+            if (pe_array.gating == GATE_NONE)
+            {
+                fast_macs_executed += (long long int)num_pe * macs;
+                return macs;
+            }
+            int latency = pe_array.gating == GATE_SKIP ? 0 : macs;
+            long long int gated = 0;
+            int used = 0;
+            for (int zeros : fast_zero_lanes)
+            {
+                int pe_gated = zeros * pe_array.psum_size;
+                gated += (long long int)pe_gated * plan.ifmap.multicast;
+                used += plan.ifmap.multicast;
+                if (pe_array.gating == GATE_SKIP)
+                    latency = max(latency, macs - pe_gated);
+            }
+            gated += (long long int)(num_pe - used) * macs;
+            fast_macs_gated += gated;
+            fast_macs_executed += (long long int)num_pe * macs - gated;
+            return latency;
+        }
+
+        // 抽樣檢查: 幾個 output tile 各自用 detailed model (PE_Array) 和 fast mode 跑同一段 program，
+        // cycle、gated MAC、GLB counter 和 psum 都要一樣；DRAM / DMA / scoreboard 兩種 mode 共用，只比 flat DRAM 的 serial 加總
+        bool fast_self_check(const ControllerConfig& config, TensorView all_in_features, TensorView all_weights,
+                             const vector<DataType>& final_psums)
+        {
+            int tiles = ctrl.output_tiles();
+            int samples = min(fast_check_tiles, tiles);
+            int b_tiles = (shape.B + map.M - 1) / map.M;
+            int n_cols = map.N * pe_array.weight_h;
+            bool all_ok = true;
+            cout << "Fast mode self-check against the PE model: " << samples << " of " << tiles << " output tiles" << endl;
+            for (int s = 0; s < samples; s++)
+            {
+                // 頭尾都抽 (最後一個通常是邊緣 tile)
+                int t = samples == 1 ? tiles - 1 : int((long long int)s * (tiles - 1) / (samples - 1));
+                ControllerConfig part_config = config;
+                part_config.dram = CTRL_DRAM_FLAT;
+                part_config.prefetch = false;
+                part_config.tile_begin = t;
+                part_config.tile_end = t + 1;
+                vector<DataType> detailed_psums(final_psums.size(), 0);  // fast mode 不會寫
+                vector<TileBasedSimulator> parts(2, *this);
+                for (int f = 0; f < 2; f++)
+                {
+                    TileBasedSimulator& p = parts[f];
+                    p.fast = f == 1;
+                    p.hardware.pipeline = false;
+                    p.trace = make_shared<TraceRecorder>();
+                    p.glb.trace = nullptr;
+                    p.glb.reset();
+                    p.total_cycles = p.gated_cycles_saved = p.pending_compute = p.overlap_saved = p.load_lat = 0;
+                    p.fast_macs_executed = p.fast_macs_gated = 0;
+                    p.ctrl.compile(map, shape, in_div4, pe_array.ifmap_size, pe_array.weight_h, part_config);
+                    p.run_program(all_in_features, all_weights, detailed_psums);
+                }
+                const TileBasedSimulator& d = parts[0];
+                const TileBasedSimulator& f = parts[1];
+                bool cycles_ok = d.total_cycles == f.total_cycles && d.gated_cycles_saved == f.gated_cycles_saved
+                                 && d.pe_array.total_macs_gated() == f.fast_macs_gated
+                                 && d.glb.reads == f.glb.reads && d.glb.writes == f.glb.writes
+                                 && d.glb.conflicts == f.glb.conflicts && d.glb.stall_cycles == f.glb.stall_cycles;
+                int outf = t / b_tiles * n_cols;
+                int b = t % b_tiles * map.M;
+                bool psums_ok = true;
+                for (int r = b; r < min(shape.B, b + map.M); r++)
+                {
+                    for (int c = outf; c < min(shape.out_features, outf + n_cols); c++)
+                    {
+                        size_t i = (size_t)r * shape.out_features + c;
+                        psums_ok = psums_ok && pe_psum_equal(final_psums[i], detailed_psums[i], pe_array.datapath);
                     }
-                    total_cycles += DRAM_ACCESS * map.K * PE::IFMAP_SIZE * map.M; // DRAM access for input feature
-                    total_cycles += DRAM_ACCESS * map.K * PE::IFMAP_SIZE * map.N * PE::WEIGHT_H; // DRAM access for weight
                 }
+                cout << "   tile " << t << " (out_feature " << outf << ", batch " << b << "): cycles " << d.total_cycles << " / "
+                     << f.total_cycles << (cycles_ok ? "" : " MISMATCH") << ", psums " << (psums_ok ? "match" : "MISMATCH") << endl;
+                all_ok = all_ok && cycles_ok && psums_ok;
             }
+            cout << "Fast mode self-check: " << (all_ok ? "PASSED" : "FAILED") << endl;
+            return all_ok;
+        }
 
-            cout << "=== Simulation Finished ===" << endl << endl;
-            //cout << "Total cycles: " << total_cycles << endl;
+        // weight tile: k_rows 個 in word x n_cols 個 out column
+        DMADescriptor weight_desc(int outf, int inf) const
+        {
+            DMADescriptor d;
+            d.dram_address = weight_dram_base + (long long int)inf * shape.out_features + outf;
+            d.glb_address = ifmap_region;
+            d.requester = TRACE_REQ_WEIGHT;
+            d.size[0] = min(map.N * pe_array.weight_h, shape.out_features - outf);
+            d.size[1] = min(map.K * pe_array.ifmap_size, in_div4 - inf);
+            d.dram_stride[0] = shape.out_features;
+            d.glb_stride[0] = d.size[0];
+            return d;
+        }
+
+        // ifmap tile: M 個 batch x k_rows 個 word
+        DMADescriptor ifmap_desc(int inf, int b) const
+        {
+            DMADescriptor d;
+            d.dram_address = (long long int)b * in_div4 + inf;
+            d.glb_address = 0;
+            d.requester = TRACE_REQ_IFMAP;
+            d.size[0] = min(map.K * pe_array.ifmap_size, in_div4 - inf);
+            d.size[1] = min(map.M, shape.B - b);
+            d.dram_stride[0] = in_div4;
+            d.glb_stride[0] = d.size[0];
+            return d;
+        }
+
+        // 一個 out_feature tile 的結果: rows 個 batch x n_cols 個 out column
+        DMADescriptor psum_desc(int outf, int b, int rows) const
+        {
+            DMADescriptor d;
+            d.dram_address = psum_dram_base + (long long int)b * shape.out_features + outf;
+            d.glb_address = ifmap_region + weight_region;
+            d.size[0] = min(map.N * pe_array.weight_h, shape.out_features - outf);
+            d.size[1] = rows;
+            d.dram_stride[0] = shape.out_features;
+            d.glb_stride[0] = d.size[0];
+            d.to_dram = true;
+            d.requester = TRACE_REQ_PSUM;
+            return d;
+        }
+
+        // 一個 k tile 的 cycle: 沒有 double buffer 時 load + compute 依序做，
+        // 有的話這個 tile 的 load 和上一個 tile 的 compute 同時做，stage = max(load, compute)
+        long long int schedule_tile(long long int load_lat, long long int compute_lat)
+        {
+            if (!pe_array.double_buffer)
+                return load_lat + compute_lat;
+            long long int stage = max(load_lat, pending_compute);
+            overlap_saved += load_lat + pending_compute - stage;
+            pending_compute = compute_lat;
+            return stage;
+        }
+
+        long long int flush_compute()
+        {
+            long long int c = pending_compute;
+            pending_compute = 0;
+            return c;
+        }
+
+        int ifmap_addr(int index) const
+        {
+            return index % ifmap_region;
+        }
+
+        int weight_addr(int index) const
+        {
+            return ifmap_region + index % weight_region;
+        }
+
+        int psum_addr(int index) const
+        {
+            return ifmap_region + weight_region + index % psum_region;
         }
 
         long long get_total_cycles() 
@@ -267,7 +1096,8 @@ class TileBasedSimulator
         }
 
 
-        void run(const LinearShapeParam& linear, const string& pattern) 
+        // 回傳 verification 有沒有過 (fast mode 的 self-check 也算)
+        bool run(const LinearShapeParam& linear, const string& pattern) 
         {
             EyerissMapper mapper;
             //linear.B = 256;
@@ -275,6 +1105,7 @@ class TileBasedSimulator
             //linear.out_features = 256;
             shape = linear;
 
+            mapper.set_hardware(hardware);
             mapper.run(linear, 1);
 
             map = {mapper.best_result.tk, mapper.best_result.tn, mapper.best_result.mode, 
@@ -282,24 +1113,44 @@ class TileBasedSimulator
 
             // 2. 初始化 DUT
             cout << "\n[Testbench] Initializing DUT (PE_Array)..." << endl;
-            PE_Array dut_pe_array;
+            PE_Array dut_pe_array(hardware.pe_array_h, hardware.pe_array_w);
+            if (!dut_pe_array.configure_spad(hardware.ifmap_spad_size / DATA_SIZE, hardware.psum_spad_size / PSUM_DATA_SIZE, linear.datapath))
+                exit(1);
             dut_pe_array.reset();
-            dut_pe_array.mode = mapper.best_result.mode;
-            dut_pe_array.set_tag();
+            // mode 組，每組 tk 個 row (tk * mode 可以小於 row 數)
+            dut_pe_array.reduction = hardware.psum_reduction;
+            dut_pe_array.double_buffer = hardware.double_buffer;
+            if (!dut_pe_array.set_groups(vector<int>(map.mode, map.tk)))
+                exit(1);
+            dut_pe_array.gating = hardware.zero_gating;
             
             pe_array = dut_pe_array;
             // 3. 準備測試資料
-            vector<DataType> in_features;
-            vector<DataType> weights;
+            // 有 .bin 就直接 mmap，沒有才讀 .txt
+            TensorFile in_features_bin, weights_bin, golden_bin;
+            vector<DataType> in_features_txt, weights_txt, golden_txt;
             vector<DataType> psum_dut(linear.B * linear.out_features, 0);
-            vector<DataType> golden;
 
             cout << "[Testbench] Loading Test Data..." << endl;
             
             string base_path = "Pattern/" + pattern + "/";
-            load_data(in_features, base_path + "A.txt");
-            load_data(weights, base_path + "B.txt");
-            load_data(golden, base_path + "C_golden.txt");
+            auto load_pattern = [&](TensorFile& bin, vector<DataType>& txt, const string& name)
+            {
+                if (bin.open(base_path + name + ".bin"))
+                {
+                    cout << "   Mapped tensor file: " << base_path + name + ".bin" << endl;
+                    return bin.view();
+                }
+                string path = base_path + name + ".txt";
+                if (load_hex_file(txt, path))
+                    cout << "   Successfully open file: " << path << endl;
+                else
+                    cerr << "   Error opening file: " << path << endl;
+                return TensorView(txt);
+            };
+            TensorView in_features = load_pattern(in_features_bin, in_features_txt, "A");
+            TensorView weights = load_pattern(weights_bin, weights_txt, "B");
+            TensorView golden = load_pattern(golden_bin, golden_txt, "C_golden");
 
             /*
             int padded_in_size = ((linear.in_features / 4 + 17 * mapper.best_result.mode) / 18) * 18;
@@ -330,6 +1181,13 @@ class TileBasedSimulator
             // 4. 執行 DUT 模擬 (Cycle-Accurate)
             cout << "\n[Testbench] Starting DUT (PE_Array) Simulation..." << endl;
 
+            cout << "   PE array: " << pe_array.pe_v << " x " << pe_array.pe_h 
+                 << ", spad: ifmap " << pe_array.ifmap_size << " / weight " << pe_array.weight_size 
+                 << " / psum " << pe_array.psum_size << ", datapath " << dp_name(pe_array.datapath)
+                 << ", zero gating " << gating_name(pe_array.gating)
+                 << ", psum reduction " << reduction_name(pe_array.reduction) << " (" << pe_array.reduction_cycles() << " cycles)"
+                 << ", double buffer " << (pe_array.double_buffer ? "on" : "off")
+                 << ", pipeline " << (hardware.pipeline ? "scoreboard" : "serial") << endl;
             cout << "   Mapping Parameters: " << endl;
             cout << "    mode: " << map.mode << endl;
             cout << "    tk: " << map.tk << endl;
@@ -338,7 +1196,25 @@ class TileBasedSimulator
             cout << "    K: " << map.K << endl;
             cout << "    N: " << map.N << endl;
 
+            if (!trace_path.empty() && fast)
+                cout << "[Testbench] Fast mode: memory trace not recorded" << endl;
+            else if (!trace_path.empty() && trace->open(trace_path))
+                cout << "[Testbench] Recording memory trace to " << trace_path << endl;
+            auto sim_start = chrono::steady_clock::now();
             run_simulation(in_features, weights, psum_dut);
+            double sim_seconds = chrono::duration<double>(chrono::steady_clock::now() - sim_start).count();
+            cout << "[Testbench] Simulation time: " << sim_seconds * 1e3 << " ms" << (sampled ? " (sampled)" : fast ? " (fast mode)" : "") << endl;
+            if (trace->is_open())
+            {
+                trace->close();
+                cout << "[Testbench] Memory trace: " << trace->records_written() << " records (producer waited "
+                     << trace->full_waits << " times)" << endl;
+            }
+            if (stopped)
+            {
+                checkpoints->print_stats(cout);
+                return true;
+            }
 
 
             // 5. 報告與驗證
@@ -348,11 +1224,16 @@ class TileBasedSimulator
             
             long long final_cycles = get_total_cycles();
             cout << "Total cycles simulated: " << final_cycles << endl;
+            if (sampled)
+                cout << "   (sampled estimate, 95% CI +- " << llround(sample_est[SAMPLE_CYCLES].half_width()) << ")" << endl;
             
             bool pass;
-            pass = equal(psum_dut.begin(), psum_dut.end(), golden.begin());
+            // bf16 的 fp32 累加順序和 golden 不同，用相對誤差比較
+            auto match = [&](DataType dut, DataType gold) { return pe_psum_equal(dut, gold, pe_array.datapath); };
+            pass = psum_dut.size() <= golden.size() && equal(psum_dut.begin(), psum_dut.end(), golden.begin(), match);
             
-            cout << "Result Verification: " << (pass ? "PASSED" : "FAILED") << endl;
+            cout << "Result Verification: " << (pass && self_check_ok ? "PASSED" : "FAILED")
+                 << (pass && !self_check_ok ? " (fast mode self-check)" : "") << endl;
             
             /*for(size_t i=0; i < 100; i++) 
             {
@@ -362,7 +1243,7 @@ class TileBasedSimulator
             {
                 for(size_t i=0; i < 200; i++) 
                 {
-                    if (psum_dut[i] != golden[i]) 
+                    if (i < psum_dut.size() && i < golden.size() && !match(psum_dut[i], golden[i])) 
                     {
                         cout << "Mismatch at index " << i << ": DUT=" << psum_dut[i] << ", Golden=" << golden[i] << endl;
                     }
@@ -370,37 +1251,55 @@ class TileBasedSimulator
             }
             cout << "=======================================\n" << endl;
 
+            // zero gating 的實測結果 (和 analyzer 用 ifmap_density 估的對照)
+            long long macs_executed = sampled ? llround(sample_est[SAMPLE_MACS_EXECUTED].total)
+                                      : fast ? fast_macs_executed : pe_array.total_macs_executed();
+            long long macs_gated = sampled ? llround(sample_est[SAMPLE_MACS_GATED].total) : fast ? fast_macs_gated : pe_array.total_macs_gated();
+            if (pe_array.gating != GATE_NONE)
+            {
+                double gated_ratio = double(macs_gated) / double(max(1LL, macs_executed + macs_gated));
+                cout << "Zero gating (" << gating_name(pe_array.gating) << "): executed MACs " << macs_executed
+                     << ", gated MACs " << macs_gated << " (" << gated_ratio * 100 << "%)" << endl;
+                cout << "Compute cycles saved: " << gated_cycles_saved << endl;
+            }
+
+            if (pe_array.double_buffer && !hardware.pipeline)
+                cout << "Load/compute overlap saved: " << overlap_saved << " cycles" << endl;
+            if (hardware.pipeline)
+                sb.print_stats(cout, final_cycles);
+            if (!sampled)
+                glb.print_stats(cout, final_cycles);
+            if (hardware.dram_model)
+                dram.print_stats(cout);
+            if (hardware.dma)
+            {
+                dma.print_stats(cout);
+                cout << "DRAM latency hidden by DMA: " << dma.hidden_cycles() << " of " << dma.waited_cycles << " cycles" << endl;
+            }
+            checkpoints->print_stats(cout);
+            // sampled mode 只有抽到的 tile 的 bank counter，不動上一次完整 run 的 CSV (開檔就會清掉)
+            if (!sampled)
+            {
+                ofstream bank_csv("../log/GEMM_with_mem_glb_banks.csv");
+                if (bank_csv.is_open())
+                    glb.stats_to_csv(bank_csv, final_cycles);
+            }
+
             mapper.best_result.cycles = final_cycles;
+            mapper.best_result.macs_executed = macs_executed;
+            mapper.best_result.macs_gated = macs_gated;
+            mapper.best_result.compute_cycles_saved = gated_cycles_saved;
+            if (hardware.dram_model)
+            {
+                mapper.best_result.dram_cycles = dram.busy_cycles;
+                mapper.best_result.dram_bandwidth = dram.bandwidth();
+                mapper.best_result.dram_row_hit_rate = dram.row_hit_rate();
+            }
+            mapper.best_result.dma_hidden_cycles = hardware.dma ? dma.hidden_cycles() : 0;
+            mapper.best_result.glb_conflicts = sampled ? llround(sample_est[SAMPLE_GLB_CONFLICTS].total) : glb.total_conflicts();
+            mapper.best_result.glb_stall_cycles = sampled ? llround(sample_est[SAMPLE_GLB_STALL].total) : glb.total_stall_cycles();
+            mapper.best_result.energy_saved = double(macs_gated) * (ENERGY_PER_MAC * dp_mac_energy_scale(pe_array.datapath) - ENERGY_PER_GATED_MAC);
             mapper.mapping_to_csv_with_cycle("../log/GEMM_with_mem_results.csv");
-
+            return pass && self_check_ok;
         }
 };
-
-void load_data(vector<DataType> &mem, const string &filename)
-{
-    ifstream file(filename);
-    if (!file.is_open()) 
-    {
-        cerr << "   Error opening file: " << filename << endl;
-        return;
-    }
-    else
-        cout << "   Successfully open file: " << filename << endl;
-    string line;
-    while (getline(file, line)) 
-    {
-        if (line.empty()) continue;
-        int32_t val;
-        stringstream ss(line);
-        ss >> hex >> val;
-        if (ss.fail()) 
-        {
-            cerr << "⚠️  Invalid line in " << filename << ": " << line << endl;
-            continue;
-        }
-        //cout << "load value: " << val << endl;
-        mem.push_back(val);
-    }
-
-    file.close();
-}
\ No newline at end of file